@@ -0,0 +1,276 @@
+//
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Microbenchmarks of the decoding kernels on synthetic scrambled sectors,
+// so kernel changes can be compared and regressions caught without a drive.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/cypher.h"
+#include "dvdcc/ecma_267.h"
+#include "dvdcc/keys.h"
+#include "dvdcc/layout.h"
+
+// keeps results alive so the compiler cannot drop the measured work
+volatile unsigned int sink = 0;
+
+// Result of one benchmark.
+struct Result {
+  std::string name;
+  unsigned long long iterations; // calls of the kernel
+  double seconds;                // time spent in the calls
+  double bytes;                  // bytes processed per call (0 = not a byte kernel)
+  double seeds;                  // seeds tried per call (0 = not a seed search)
+};
+
+Result Measure(std::string name, double bytes, double seeds, double min_time, std::function<void(void)> kernel) {
+  // Call a kernel until at least min_time seconds have passed, doubling the
+  // batch size between clock reads to keep timing overhead out of the result.
+  //
+  // Args:
+  //     name (std::string): benchmark name
+  //     bytes (double): bytes processed per call
+  //     seeds (double): seeds tried per call
+  //     min_time (double): minimum measured time in seconds
+  //     kernel (std::function<void(void)>): work to measure
+  //
+  // Returns:
+  //     (Result): measured result
+
+  kernel(); // warm up caches and tables
+
+  Result result = {name, 0, 0.0, bytes, seeds};
+  unsigned long long batch = 1;
+
+  while (result.seconds < min_time) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned long long i = 0; i < batch; i++) kernel();
+    result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    result.iterations += batch;
+    batch *= 2;
+  }
+
+  return result;
+
+}; // END Measure()
+
+void Scramble(unsigned char *raw_sector, unsigned int sector, Cypher &cypher, unsigned int *state) {
+  // Build a synthetic raw sector with an ID, pseudo random user data and a
+  // valid EDC, then scramble it like the drive cache holds it.
+  //
+  // Args:
+  //     raw_sector (unsigned char *): buffer for RAW_SECTOR_SIZE bytes
+  //     sector (unsigned int): sector number stored in the ID
+  //     cypher (Cypher &): cypher of the sector's block
+  //     state (unsigned int *): pseudo random generator state, updated
+
+  memset(raw_sector, 0, constants::RAW_SECTOR_SIZE);
+
+  raw_sector[1] = (sector >> 16) & 0xFF;
+  raw_sector[2] = (sector >> 8) & 0xFF;
+  raw_sector[3] = sector & 0xFF;
+
+  for (unsigned int i = 12; i < constants::RAW_SECTOR_SIZE - 4; i++) {
+    *state = *state * 1103515245 + 12345;
+    raw_sector[i] = *state >> 24;
+  }
+
+  unsigned int edc = ecma_267::calculate(raw_sector, constants::RAW_SECTOR_SIZE - 4);
+  for (unsigned int i = 0; i < 4; i++)
+    raw_sector[constants::RAW_SECTOR_SIZE - 4 + i] = edc >> (24 - 8 * i);
+
+  // scrambling and descrambling are the same XOR
+  cypher.Decode64(raw_sector, 12);
+
+}; // END Scramble()
+
+void Print(std::vector<Result> &results, bool json) {
+  // Print the results as a table or as JSON.
+  //
+  // Args:
+  //     results (std::vector<Result> &): measured results
+  //     json (bool): print JSON when true
+
+  if (json) printf("{\n  \"benchmarks\": [\n");
+  else printf("%-24s %12s %12s %10s %14s\n", "benchmark", "calls", "ns/call", "ns/byte", "rate");
+
+  for (unsigned int i = 0; i < results.size(); i++) {
+
+    Result &r = results[i];
+    double ns_per_call = r.seconds * 1e9 / r.iterations;
+    double ns_per_byte = r.bytes ? ns_per_call / r.bytes : 0;
+    double gb_per_s = r.bytes ? r.bytes * r.iterations / r.seconds / 1e9 : 0;
+    double seeds_per_s = r.seeds ? r.seeds * r.iterations / r.seconds : 0;
+
+    if (json) {
+      printf("    {\"name\": \"%s\", \"iterations\": %llu, \"seconds\": %.6f, \"ns_per_call\": %.3f",
+             r.name.c_str(), r.iterations, r.seconds, ns_per_call);
+      if (r.bytes) printf(", \"bytes_per_call\": %.0f, \"ns_per_byte\": %.4f, \"gb_per_s\": %.4f", r.bytes, ns_per_byte, gb_per_s);
+      if (r.seeds) printf(", \"seeds_per_call\": %.0f, \"seeds_per_s\": %.1f", r.seeds, seeds_per_s);
+      printf("}%s\n", i + 1 < results.size() ? "," : "");
+    } else if (r.seeds) {
+      printf("%-24s %12llu %12.1f %10s %9.0f seeds/s\n", r.name.c_str(), r.iterations, ns_per_call, "-", seeds_per_s);
+    } else {
+      printf("%-24s %12llu %12.1f %10.4f %9.3f GB/s\n", r.name.c_str(), r.iterations, ns_per_call, ns_per_byte, gb_per_s);
+    }
+
+  } // END for (i)
+
+  if (json) printf("  ]\n}\n");
+
+}; // END Print()
+
+int main(int argc, char **argv) {
+
+  bool json = false;
+  double min_time = 0.5;
+  unsigned int search_seed = 0x1000;
+
+  while (1) {
+
+    static struct option long_options[] = {
+      {"help",     no_argument,       0, 'h'},
+      {"json",     no_argument,       0, 'j'},
+      {"min-time", required_argument, 0, 'm'},
+      {"seed",     required_argument, 0, 's'},
+      {0, 0, 0, 0}
+    };
+
+    int c = getopt_long(argc, argv, "h", long_options, NULL);
+    if (c == -1) break;
+
+    switch (c) {
+      case 'j':
+        json = true;
+        break;
+      case 'm':
+        min_time = atof(optarg);
+        break;
+      case 's':
+        search_seed = strtoul(optarg, NULL, 0) % keys::MAX_SEED;
+        break;
+      case 'h':
+        printf("Usage: dvdcc-bench [--json] [--min-time SECONDS] [--seed SEED]\n"
+               "Benchmark the dvdcc decoding kernels on synthetic scrambled sectors.\n\n"
+               "      --json        print results as JSON\n"
+               "      --min-time    seconds spent measuring each kernel (default: 0.5)\n"
+               "      --seed        seed the FindKeys search has to reach, the search\n"
+               "                    tries every seed below it first (default: 0x1000)\n"
+               "      --help        display this help and exit\n");
+        return 0;
+      default:
+        return 1;
+    } // END switch (c)
+
+  } // END while (1)
+
+  const unsigned int payload = constants::SECTOR_SIZE;
+  const unsigned int cache_bytes = constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE;
+  const unsigned int cache_blocks = constants::SECTORS_PER_CACHE / constants::SECTORS_PER_BLOCK;
+
+  // one cypher per block of the cache, as Dvd::FindKeys() finds them
+  std::vector<Cypher *> cyphers;
+  for (unsigned int i = 0; i < cache_blocks; i++) cyphers.push_back(new Cypher(0x0100 + 0x0321 * i, payload));
+
+  unsigned int state = 1;
+  std::vector<unsigned char> cache(cache_bytes);
+  for (unsigned int n = 0; n < constants::SECTORS_PER_CACHE; n++)
+    Scramble(cache.data() + n * constants::RAW_SECTOR_SIZE, 0x30000 + n, *cyphers[n / constants::SECTORS_PER_BLOCK], &state);
+
+  std::vector<unsigned char> scrambled = cache;
+  std::vector<unsigned char> sector(constants::RAW_SECTOR_SIZE);
+
+  Cypher search_cypher(search_seed, payload);
+  std::vector<unsigned char> search_sector(constants::RAW_SECTOR_SIZE);
+  Scramble(search_sector.data(), 0x30000, search_cypher, &state);
+
+  std::vector<Result> results;
+
+  results.push_back(Measure("cypher_generate", payload, 0, min_time, [&]() {
+    Cypher cypher(0x1234, payload);
+    sink += cypher.bytes[payload - 1];
+  }));
+
+  // decoding twice restores the sector, so each call keeps working on the same bytes
+  results.push_back(Measure("decode", payload, 0, min_time, [&]() {
+    cyphers[0]->Decode(sector.data(), 12);
+    sink += sector[12];
+  }));
+
+  results.push_back(Measure("decode32", payload, 0, min_time, [&]() {
+    cyphers[0]->Decode32(sector.data(), 12);
+    sink += sector[12];
+  }));
+
+  results.push_back(Measure("decode64", payload, 0, min_time, [&]() {
+    cyphers[0]->Decode64(sector.data(), 12);
+    sink += sector[12];
+  }));
+
+  results.push_back(Measure("ecma_267_calculate", constants::RAW_SECTOR_SIZE - 4, 0, min_time, [&]() {
+    sink += ecma_267::calculate(sector.data(), constants::RAW_SECTOR_SIZE - 4);
+  }));
+
+  // the decode and EDC check of Dvd::ReadCacheBlock() on a fresh copy of the drive cache
+  unsigned int failures = 0;
+  results.push_back(Measure("cache_verify", cache_bytes, 0, min_time, [&]() {
+    memcpy(cache.data(), scrambled.data(), cache_bytes);
+    for (unsigned int n = 0; n < constants::SECTORS_PER_CACHE; n++) {
+      unsigned char *raw_sector = cache.data() + n * constants::RAW_SECTOR_SIZE;
+      cyphers[n / constants::SECTORS_PER_BLOCK]->Decode64(raw_sector, 12);
+      if (!keys::Verify(raw_sector)) failures++;
+    }
+  }));
+
+  // the same loop with the sector layout fixed at compile time, see Dvd::DecodeSectors()
+  results.push_back(Measure("cache_verify_layout", cache_bytes, 0, min_time, [&]() {
+    memcpy(cache.data(), scrambled.data(), cache_bytes);
+    for (unsigned int n = 0; n < constants::SECTORS_PER_CACHE; n++) {
+      unsigned char *raw_sector = cache.data() + n * constants::RAW_SECTOR_SIZE;
+      layout::Descramble<layout::GameDisc>(cyphers[n / constants::SECTORS_PER_BLOCK], raw_sector);
+      if (!layout::Verify<layout::GameDisc>(raw_sector)) failures++;
+    }
+  }));
+
+  // the seed search of Dvd::FindKeys() for one block
+  results.push_back(Measure("find_keys_seed_search", 0, search_seed + 1, min_time, [&]() {
+    Cypher *cypher = keys::FindCypher(search_sector.data());
+    if (cypher == NULL || cypher->seed != search_seed) failures++;
+    delete cypher;
+  }));
+
+  for (unsigned int i = 0; i < cyphers.size(); i++) delete cyphers[i];
+
+  if (failures) {
+    printf("dvdcc-bench:main() %u synthetic sectors failed to decode.\n", failures);
+    return 1;
+  }
+
+  Print(results, json);
+
+  return 0;
+
+}
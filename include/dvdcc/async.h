@@ -0,0 +1,298 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_ASYNC_H_
+#define DVDCC_ASYNC_H_
+
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/commands.h"
+#include "dvdcc/devices.h"
+
+// Class for sending commands to one drive from a dedicated I/O thread.
+// Commands are queued in order and their status is returned through
+// futures, so callers can overlap drive I/O with CPU work. Queued
+// commands can be cancelled or given a deadline. A command that already
+// reached the drive always runs to completion.
+//
+// Every command for the drive must go through the same AsyncDvd while it
+// exists, since the drive serves one command at a time.
+class AsyncDvd {
+
+ public:
+  static constexpr int CANCELLED = -2; // status of a command cancelled before it started
+  static constexpr int EXPIRED = -3;   // status of a command whose deadline passed before it started
+
+  typedef std::chrono::steady_clock::time_point Deadline;
+
+  // Handle of a queued command.
+  struct Operation {
+    std::shared_future<int> status;                // command status once finished
+    std::shared_ptr<std::atomic<bool>> cancelled;  // set to skip the command if not started
+
+    void Cancel(void) { cancelled->store(true); }; // skip the command if it has not started
+    bool Ready(void) {                             // true once the status is available
+      return status.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    };
+    int Wait(void) { return status.get(); };       // wait for the status
+  };
+
+  AsyncDvd(Dvd *dvd, bool verbose);
+  ~AsyncDvd();
+
+  Operation Submit(std::function<int(void)> command, Deadline deadline);   // queue any drive work
+  Operation ReadSectors(int sector, int sectors, unsigned char *buffer, bool streaming,
+                        Deadline deadline);                                 // read 2048 byte sectors
+  Operation ReadRawBytes(int offset, int nbyte, unsigned char *buffer,
+                         Deadline deadline);                                // read raw bytes of the drive cache
+  Operation ReadRawSectorCache(int sector, unsigned char *buffer,
+                               Deadline deadline);                          // fill and read the raw sector cache
+  Operation GetEventStatus(constants::EventType event_type, unsigned char *buffer, unsigned int allocation,
+                           Deadline deadline);                              // poll an event status
+  Operation StartStop(bool start, bool load_eject, Deadline deadline);     // start, stop, load or eject
+  void CancelAll(void);                                                     // cancel every queued command
+
+  static Deadline Never(void) { return Deadline::max(); };                 // no deadline
+  static Deadline In(unsigned int milliseconds) {                          // deadline from now
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+  };
+
+  // queued command
+  struct Request {
+    std::function<int(void)> command;
+    std::promise<int> status;
+    std::shared_ptr<std::atomic<bool>> cancelled;
+    Deadline deadline;
+  };
+
+  Dvd *dvd;                      // drive served by the I/O thread
+  bool verbose;                  // print command details when true
+  bool stopping;                 // set when the facade is destroyed
+
+  std::deque<Request> queue;     // commands waiting for the drive
+  std::thread io;                // I/O thread
+  std::mutex mutex;
+  std::condition_variable cond;
+
+  void Run(void);                // I/O thread loop
+
+}; // END class AsyncDvd()
+
+AsyncDvd::AsyncDvd(Dvd *dvd, bool verbose = false) : dvd(dvd), verbose(verbose), stopping(false) {
+  // Constructor that starts the I/O thread.
+  //
+  // Args:
+  //     dvd (Dvd *): drive to send commands to
+  //     verbose (bool): when true print command details (default: false)
+
+  io = std::thread(&AsyncDvd::Run, this);
+
+}; // END AsyncDvd::AsyncDvd()
+
+AsyncDvd::~AsyncDvd() {
+  // Destructor that cancels queued commands, waits for the command at the
+  // drive and joins the I/O thread.
+
+  CancelAll();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cond.notify_all();
+
+  io.join();
+
+}; // END AsyncDvd::~AsyncDvd()
+
+void AsyncDvd::Run(void) {
+  // I/O thread loop that sends queued commands to the drive in order.
+
+  while (true) {
+
+    Request request;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] { return stopping || !queue.empty(); });
+      if (queue.empty()) return;
+      request = std::move(queue.front());
+      queue.pop_front();
+    }
+
+    if (request.cancelled->load())
+      request.status.set_value(CANCELLED);
+    else if (std::chrono::steady_clock::now() > request.deadline)
+      request.status.set_value(EXPIRED);
+    else
+      request.status.set_value(request.command());
+
+  } // END while (true)
+
+}; // END AsyncDvd::Run()
+
+AsyncDvd::Operation AsyncDvd::Submit(std::function<int(void)> command, Deadline deadline = Deadline::max()) {
+  // Queue work that talks to the drive, such as a Dvd method.
+  //
+  // Args:
+  //     command (std::function<int(void)>): work returning a command status
+  //     deadline (Deadline): skip the work when it has not started by then (default: none)
+  //
+  // Returns:
+  //     (Operation): handle with the status future
+
+  Request request;
+  request.command = command;
+  request.cancelled = std::make_shared<std::atomic<bool>>(false);
+  request.deadline = deadline;
+
+  Operation operation;
+  operation.status = request.status.get_future().share();
+  operation.cancelled = request.cancelled;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(std::move(request));
+  }
+  cond.notify_one();
+
+  return operation;
+
+}; // END AsyncDvd::Submit()
+
+AsyncDvd::Operation AsyncDvd::ReadSectors(int sector, int sectors, unsigned char *buffer, bool streaming,
+                                          Deadline deadline = Deadline::max()) {
+  // Queue a read of 2048 byte data sectors, see commands::ReadSectors().
+  //
+  // Args:
+  //     sector (int): starting sector
+  //     sectors (int): number of sectors
+  //     buffer (unsigned char *): buffer for sectors * SECTOR_SIZE bytes, kept until finished
+  //     streaming (bool): use cache streaming mode when true
+  //     deadline (Deadline): skip the read when it has not started by then (default: none)
+  //
+  // Returns:
+  //     (Operation): handle with the status future
+
+  Dvd *drive = dvd;
+  bool print = verbose;
+
+  return Submit([=]() { return commands::ReadSectors(drive->fd, buffer, sector, sectors, streaming,
+                                                     drive->timeout, print, NULL); }, deadline);
+
+}; // END AsyncDvd::ReadSectors()
+
+AsyncDvd::Operation AsyncDvd::ReadRawBytes(int offset, int nbyte, unsigned char *buffer,
+                                           Deadline deadline = Deadline::max()) {
+  // Queue a read of raw drive cache bytes, see commands::ReadRawBytes().
+  //
+  // Args:
+  //     offset (int): starting memory offset within the cache
+  //     nbyte (int): number of bytes (1 - 65535)
+  //     buffer (unsigned char *): buffer for nbyte bytes, kept until finished
+  //     deadline (Deadline): skip the read when it has not started by then (default: none)
+  //
+  // Returns:
+  //     (Operation): handle with the status future
+
+  Dvd *drive = dvd;
+  bool print = verbose;
+
+  return Submit([=]() { return commands::ReadRawBytes(drive->fd, buffer, offset, nbyte, drive->timeout,
+                                                      print, NULL); }, deadline);
+
+}; // END AsyncDvd::ReadRawBytes()
+
+AsyncDvd::Operation AsyncDvd::ReadRawSectorCache(int sector, unsigned char *buffer,
+                                                 Deadline deadline = Deadline::max()) {
+  // Queue a fill and read of the raw sector cache as one command, so no
+  // other command can reach the drive between the two steps.
+  //
+  // Args:
+  //     sector (int): starting sector
+  //     buffer (unsigned char *): buffer for SECTORS_PER_CACHE raw sectors, kept until finished
+  //     deadline (Deadline): skip the read when it has not started by then (default: none)
+  //
+  // Returns:
+  //     (Operation): handle with the status future
+
+  Dvd *drive = dvd;
+  bool print = verbose;
+
+  return Submit([=]() { return drive->ReadRawSectorCache(sector, buffer, print); }, deadline);
+
+}; // END AsyncDvd::ReadRawSectorCache()
+
+AsyncDvd::Operation AsyncDvd::GetEventStatus(constants::EventType event_type, unsigned char *buffer,
+                                             unsigned int allocation, Deadline deadline = Deadline::max()) {
+  // Queue a polled event status notification, see commands::GetEventStatus().
+  //
+  // Args:
+  //     event_type (constants::EventType): event class to poll
+  //     buffer (unsigned char *): buffer for allocation bytes, kept until finished
+  //     allocation (unsigned int): number of bytes returned
+  //     deadline (Deadline): skip the poll when it has not started by then (default: none)
+  //
+  // Returns:
+  //     (Operation): handle with the status future
+
+  Dvd *drive = dvd;
+  bool print = verbose;
+
+  return Submit([=]() { return commands::GetEventStatus(drive->fd, buffer, event_type, true, allocation,
+                                                        drive->timeout, print, NULL); }, deadline);
+
+}; // END AsyncDvd::GetEventStatus()
+
+AsyncDvd::Operation AsyncDvd::StartStop(bool start, bool load_eject, Deadline deadline = Deadline::max()) {
+  // Queue a START STOP UNIT command, see commands::StartStop().
+  //
+  // Args:
+  //     start (bool): start the disc (or load it with load_eject) when true
+  //     load_eject (bool): load or eject the disc instead of spinning it
+  //     deadline (Deadline): skip the command when it has not started by then (default: none)
+  //
+  // Returns:
+  //     (Operation): handle with the status future
+
+  Dvd *drive = dvd;
+  bool print = verbose;
+
+  return Submit([=]() { return commands::StartStop(drive->fd, start, load_eject, 0, drive->timeout,
+                                                   print, NULL); }, deadline);
+
+}; // END AsyncDvd::StartStop()
+
+void AsyncDvd::CancelAll(void) {
+  // Cancel every command that has not reached the drive yet.
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (unsigned int i = 0; i < queue.size(); i++)
+    queue[i].cancelled->store(true);
+
+}; // END AsyncDvd::CancelAll()
+
+#endif // DVDCC_ASYNC_H_
@@ -0,0 +1,936 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_BACKUP_H_
+#define DVDCC_BACKUP_H_
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "dvdcc/options.h"
+#include "dvdcc/constants.h"
+#include "dvdcc/progress.h"
+#include "dvdcc/devices.h"
+#include "dvdcc/keys.h"
+#include "dvdcc/speed.h"
+#include "dvdcc/sinks.h"
+#include "dvdcc/chunks.h"
+#include "dvdcc/threads.h"
+#include "dvdcc/junk.h"
+#include "dvdcc/sidecar.h"
+#include "dvdcc/hashes.h"
+#include "dvdcc/verify.h"
+#include "dvdcc/dedup.h"
+
+FILE *OpenAndResume(char *path, int resume,
+                    unsigned int *start_sector, unsigned int sector_size) {
+  // Method to open and resume from an existing file or create new file.
+  //
+  // Args:
+  //     path (char *): path to the file
+  //     resume (int): set to 1 when resuming, otherwise 0
+  //     start_sector (unsigned int *): pointer to the starting sector used
+  //                                    in the backup loop.
+  //     sector_size (unsigned int): size of the file sectors in bytes
+
+  // resume from last file sector
+  if (resume) {
+
+    // open for update rather than append so skipped sectors can be left as holes
+    FILE *fp = fopen(path, "r+b");
+    if (fp == NULL) {
+      printf("dvdcc:backup:OpenAndResume() Cannot resume. Unable to open %s.\n", path);
+      printf("dvdcc:backup:OpenAndResume() Exiting...\n");
+      exit(0);
+    }
+
+    // get file size
+    fseeko(fp, 0, SEEK_END);
+    off_t fsize = ftello(fp);
+
+    // ensure it is a multiple of sector size
+    if (fsize % sector_size != 0) {
+      printf("dvdcc:backup:OpenAndResume() Cannot resume from incomplete sector. Trim file to nearest %u bytes before resuming.\n", sector_size);
+      printf("dvdcc:backup:OpenAndResume() Exiting...\n");
+      exit(0);
+    }
+
+    *start_sector = fsize / sector_size;
+
+    return fp;
+  } // END if (resume)
+
+  // otherwise ensure we don't overwrite
+  if (access(path, F_OK) == 0) {
+    printf("dvdcc:backup:OpenAndResume() File %s already exists. Delete or use --resume.\n", path);
+    printf("dvdcc:backup:OpenAndResume() Exiting...\n");
+    exit(0);
+  } // END if (access...)
+
+  // new file starting from 0
+  FILE *fp = fopen(path, "wb");
+  *start_sector = 0;
+
+  return fp;
+
+}; // END OpenAndResume()
+
+Sink *OpenSink(char *path, int resume, int stream_fd, ThreadPool *pool,
+               unsigned int *start_sector, unsigned int sector_size) {
+  // Method to open the output for a backup. A path of "-" streams to
+  // stdout and a named pipe streams to the pipe, otherwise the path is
+  // opened as a regular file with OpenAndResume(), or as a new chunked
+  // compressed image when a compression thread pool is given.
+  //
+  // Args:
+  //     path (char *): path to the output or "-" for stdout
+  //     resume (int): set to 1 when resuming, otherwise 0
+  //     stream_fd (int): file descriptor of the original stdout
+  //     pool (ThreadPool *): compression workers (NULL = no compression)
+  //     start_sector (unsigned int *): pointer to the starting sector used
+  //                                    in the backup loop.
+  //     sector_size (unsigned int): size of the output sectors in bytes
+
+  // streams hold 4 cache blocks so the backup loop rarely waits on the consumer
+  const unsigned int capacity = 4 * constants::SECTORS_PER_CACHE;
+
+  struct stat st;
+  bool stdout_stream = strcmp(path, "-") == 0;
+  bool pipe_stream = !stdout_stream && stat(path, &st) == 0 && S_ISFIFO(st.st_mode);
+
+  if ((stdout_stream || pipe_stream) && resume) {
+    printf("dvdcc:backup:OpenSink() Cannot resume when streaming to %s.\n", path);
+    printf("dvdcc:backup:OpenSink() Exiting...\n");
+    exit(0);
+  }
+
+  if (pool && (stdout_stream || pipe_stream || resume)) {
+    printf("dvdcc:backup:OpenSink() Compressed images cannot be streamed or resumed.\n");
+    printf("dvdcc:backup:OpenSink() Exiting...\n");
+    exit(0);
+  }
+
+  *start_sector = 0;
+
+  if (stdout_stream)
+    return new StreamSink(stream_fd, sector_size, capacity);
+
+  if (pipe_stream) {
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+      printf("dvdcc:backup:OpenSink() Cannot open pipe %s.\n", path);
+      printf("dvdcc:backup:OpenSink() Exiting...\n");
+      exit(0);
+    }
+    return new StreamSink(fd, sector_size, capacity);
+  }
+
+  // chunks of one cache block keep chunk boundaries aligned with cache reads
+  if (pool)
+    return new ChunkSink(OpenAndResume(path, 0, start_sector, sector_size), sector_size,
+                         constants::SECTORS_PER_CACHE, pool);
+
+  return new FileSink(OpenAndResume(path, resume, start_sector, sector_size), sector_size);
+
+}; // END OpenSink()
+
+// Class holding the outputs of one backup.
+class Outputs {
+
+ public:
+  Outputs() : iso(NULL), raw(NULL), sidecar(NULL), start_sector(0), end_sector(0) {};
+
+  int Open(Options &options, Dvd &dvd, char *iso_path, char *raw_path,
+           int stream_fd, ThreadPool *pool);                            // open the requested outputs
+  int Limit(unsigned int first, unsigned int end);                      // restrict the backup to a sector range
+  int Close(void);                                                      // close and delete the outputs
+  unsigned int SectorBytes(void) {                                      // bytes written per sector
+    return (iso ? iso->sector_size : 0) + (raw ? raw->sector_size : 0) + (sidecar ? sidecar->sector_size : 0);
+  };
+
+  Sink *iso;                  // ISO output (NULL = none)
+  Sink *raw;                  // RAW output (NULL = none)
+  Sink *sidecar;              // RAW sidecar output (NULL = none)
+  unsigned int start_sector;  // first sector to back up
+  unsigned int end_sector;    // sector after the last to back up
+
+}; // END class Outputs()
+
+int Outputs::Open(Options &options, Dvd &dvd, char *iso_path, char *raw_path,
+                  int stream_fd, ThreadPool *pool) {
+  // Open the ISO, RAW and sidecar outputs requested by the options and
+  // wrap them for junk elision, block indexing and hashing.
+  //
+  // Args:
+  //     options (Options &): parsed command line options
+  //     dvd (Dvd &): drive with keys found
+  //     iso_path (char *): ISO output path (NULL = none)
+  //     raw_path (char *): RAW output path (NULL = none)
+  //     stream_fd (int): file descriptor of the original stdout
+  //     pool (ThreadPool *): compression workers (NULL = no compression)
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = invalid combination of outputs)
+
+  unsigned int iso_start_sector = 0, raw_start_sector = 0;
+
+  // compressed images store elided junk as zeros, so nothing is saved and
+  // the image no longer matches the disc
+  if (options.elide_junk && pool && !options.dedup) {
+    printf("dvdcc:backup:Outputs:Open() Cannot elide junk from a compressed image.\n");
+    return -1;
+  }
+
+  // open output for iso backup
+  if (iso_path) {
+    printf(" ISO path: %s\n", iso_path);
+    // keep a manifest of clusters written once to a shared store instead of the ISO
+    if (options.dedup)
+      iso = new DedupSink(options.dedup, iso_path, options.resume, pool != NULL, dvd.sector_number);
+    else
+      iso = OpenSink(iso_path, options.resume, stream_fd, pool, &iso_start_sector, constants::SECTOR_SIZE);
+    // replace junk padding with holes listed in the junk map, which only
+    // regular files (or the dedup store) can hold
+    struct stat st;
+    bool regular = options.dedup || (stat(iso_path, &st) == 0 && S_ISREG(st.st_mode));
+    if (options.elide_junk && !dvd.disc_id.empty() && regular) {
+      std::string map_path = std::string(iso_path) + ".junk";
+      printf(" Junk map: %s\n", map_path.c_str());
+      iso = new JunkSink(iso, map_path.c_str(), (unsigned char *)dvd.disc_id.data(), dvd.disc_number);
+    } else if (options.elide_junk) {
+      printf(" Junk elision needs a Gamecube/Wii disc and an ISO file. Storing junk.\n");
+    }
+    // index blocks of the full image for later verification
+    if (options.block_index && strcmp(iso_path, "-") != 0)
+      iso = new BlockIndexSink(iso, iso_path, options.resume, iso_start_sector, dvd.sector_number);
+    // hash the full image, including elided junk, as it is written
+    if (options.hash)
+      iso = new HashSink(iso, iso_path, options.resume, iso_start_sector);
+  } // END if (iso_path)
+
+  // open output for raw backup
+  if (raw_path) {
+    printf(" RAW path: %s\n", raw_path);
+    raw = OpenSink(raw_path, options.resume, stream_fd, pool, &raw_start_sector, constants::RAW_SECTOR_SIZE);
+    // confirm start sectors match when using ISO+RAW
+    if (iso_path && raw_start_sector != iso_start_sector) {
+      printf("dvdcc:backup:Outputs:Open() Cannot resume. RAW start sector %u differs from ISO start sector %u.\n",
+             raw_start_sector, iso_start_sector);
+      return -1;
+    }
+    if (options.hash)
+      raw = new HashSink(raw, raw_path, options.resume, raw_start_sector);
+  } // END if (raw_path)
+
+  // open the sidecar that stands in for a RAW backup
+  if (options.raw_sidecar && iso_path && strcmp(iso_path, "-") != 0) {
+    std::string sidecar_path = std::string(iso_path) + ".sidecar";
+    unsigned int sidecar_start_sector;
+    printf(" Sidecar path: %s\n", sidecar_path.c_str());
+    FILE *fp = OpenAndResume((char *)sidecar_path.c_str(), options.resume, &sidecar_start_sector, sidecar::ENTRY_SIZE);
+    // the header occupies the first entries of the file
+    if (options.resume) sidecar_start_sector -= sidecar::HEADER_SIZE / sidecar::ENTRY_SIZE;
+    if (options.resume && sidecar_start_sector != iso_start_sector) {
+      printf("dvdcc:backup:Outputs:Open() Cannot resume. Sidecar start sector %u differs from ISO start sector %u.\n",
+             sidecar_start_sector, iso_start_sector);
+      return -1;
+    }
+    // the sidecar keeps the raw sector bytes around the user data held by the ISO
+    unsigned int payload = layout::Select(dvd.dvd_rom, [](auto disc) { return decltype(disc)::PAYLOAD; });
+    sidecar = new SidecarSink(fp, options.resume, dvd.sector_number, payload, dvd.cypher_number, dvd.cyphers);
+  } else if (options.raw_sidecar) {
+    printf(" RAW sidecar needs an ISO file. Skipping sidecar.\n");
+  }
+
+  start_sector = iso_path ? iso_start_sector : raw_start_sector;
+  end_sector = dvd.sector_number;
+
+  return 0;
+
+}; // END Outputs::Open()
+
+int Outputs::Limit(unsigned int first, unsigned int end) {
+  // Restrict the backup to a range of sectors. Sectors before the range
+  // are left as holes so the outputs keep their disc offsets and ranges
+  // backed up separately can be combined in one image.
+  //
+  // Args:
+  //     first (unsigned int): first sector to back up
+  //     end (unsigned int): sector after the last to back up (0 = end of disc)
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (end != 0 && end < end_sector) end_sector = end;
+  if (first <= start_sector) return 0;
+  if (first > end_sector) first = end_sector;
+
+  unsigned int count = first - start_sector;
+
+  if (iso && iso->Skip(start_sector, count) != 0) return -1;
+  if (raw && raw->Skip(start_sector, count) != 0) return -1;
+  if (sidecar && sidecar->Skip(start_sector, count) != 0) return -1;
+
+  start_sector = first;
+
+  return 0;
+
+}; // END Outputs::Limit()
+
+int Outputs::Close(void) {
+  // Close and delete the open outputs.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  int status = 0;
+
+  if (iso && iso->Close() != 0) status = -1;
+  if (raw && raw->Close() != 0) status = -1;
+  if (sidecar && sidecar->Close() != 0) status = -1;
+
+  delete iso;
+  delete raw;
+  delete sidecar;
+  iso = raw = sidecar = NULL;
+
+  return status;
+
+}; // END Outputs::Close()
+
+int WaitForStandby(Dvd &dvd, Progress *progress, bool verbose) {
+  // Method to wait for drive activity to stop, otherwise background
+  // commands might overwrite the drive cache as we try to read it.
+  //
+  // Args:
+  //     dvd (Dvd &): drive to poll
+  //     progress (Progress *): progress updated while waiting (NULL = none)
+  //     verbose (bool): set to true to print more details to stdout
+  //
+  // Returns:
+  //     (int): number of polls spent waiting (-1 = activity did not stop)
+
+  int retry = 0, good = 0;
+  time_t t0 = time(NULL);
+  while (true) {
+
+    dvd.counters->standby_seconds.store(difftime(time(NULL), t0), std::memory_order_relaxed);
+
+    bool ready = (dvd.PollReady(verbose) == 0);
+    bool active = (dvd.PollPowerState(verbose) == (int)constants::PowerStates::kActive);
+
+    good += (ready && !active);
+    retry++;
+
+    // only break after verifying the drive is ready 3 consecutive times
+    // to avoid triggering on the transition between unready and active states
+    if (good == 3) break;
+
+    if (progress && retry != good) progress->Update();
+
+    if (retry == 1000) return -1;
+
+    trace::Sleep(1);
+
+  } // END while (true)
+
+  return retry - good;
+
+}; // END WaitForStandby()
+
+// Class for a fixed set of cache block buffers shared by all drives, so
+// memory stays bounded however many drives are running.
+class BufferPool {
+
+ public:
+  BufferPool(unsigned int count, size_t size);
+
+  unsigned char *Acquire(bool wait);          // take a buffer (NULL = none free and not waiting)
+  void Release(unsigned char *buffer);        // return a buffer
+
+  size_t size;                                // bytes per buffer
+  std::vector<unsigned char> storage;         // memory for all buffers
+  std::vector<unsigned char *> available;     // buffers not in use
+  std::mutex mutex;
+  std::condition_variable cond;
+
+}; // END class BufferPool()
+
+BufferPool::BufferPool(unsigned int count, size_t size) : size(size), storage((size_t)count * size) {
+  // Constructor that allocates the buffers.
+  //
+  // Args:
+  //     count (unsigned int): number of buffers
+  //     size (size_t): bytes per buffer
+
+  for (unsigned int i = 0; i < count; i++)
+    available.push_back(storage.data() + (size_t)i * size);
+
+}; // END BufferPool::BufferPool()
+
+unsigned char *BufferPool::Acquire(bool wait) {
+  // Take a free buffer.
+  //
+  // Args:
+  //     wait (bool): when true block until a buffer is free
+  //
+  // Returns:
+  //     (unsigned char *): buffer (NULL = none free and not waiting)
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (wait) cond.wait(lock, [&] { return !available.empty(); });
+  if (available.empty()) return NULL;
+
+  unsigned char *buffer = available.back();
+  available.pop_back();
+
+  return buffer;
+
+}; // END BufferPool::Acquire()
+
+void BufferPool::Release(unsigned char *buffer) {
+  // Return a buffer to the pool.
+  //
+  // Args:
+  //     buffer (unsigned char *): buffer from Acquire()
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    available.push_back(buffer);
+  }
+  cond.notify_one();
+
+}; // END BufferPool::Release()
+
+// Class for one progress line covering every drive.
+class ProgressBoard {
+
+ public:
+  ProgressBoard() : t0(time(NULL)), last(0), finished(false) {};
+
+  unsigned int Add(std::string label);                           // add a drive and return its index
+  void Update(unsigned int drive, unsigned int done, unsigned int total);  // report drive progress
+  void Print(void);                                              // print the progress line
+  void Finish(void);                                             // print the final line
+
+  time_t t0;                                                     // start time
+  time_t last;                                                   // time of the last printed line
+  bool finished;                                                 // set once the final line is printed
+
+  std::vector<std::string> labels;                               // drive labels
+  std::vector<unsigned int> done;                                // sectors backed up per drive
+  std::vector<unsigned int> totals;                              // sectors to back up per drive
+  std::mutex mutex;
+
+}; // END class ProgressBoard()
+
+unsigned int ProgressBoard::Add(std::string label) {
+  // Add a drive to the board. A drive already on the board is reset so
+  // each new disc starts from zero.
+  //
+  // Args:
+  //     label (std::string): short drive name (e.g. sr0)
+  //
+  // Returns:
+  //     (unsigned int): drive index for Update()
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (unsigned int i = 0; i < labels.size(); i++) {
+    if (labels[i] != label) continue;
+    done[i] = totals[i] = 0;
+    return i;
+  }
+
+  labels.push_back(label);
+  done.push_back(0);
+  totals.push_back(0);
+
+  return labels.size() - 1;
+
+}; // END ProgressBoard::Add()
+
+void ProgressBoard::Update(unsigned int drive, unsigned int n, unsigned int total) {
+  // Report the progress of a drive, printing at most once per second.
+  //
+  // Args:
+  //     drive (unsigned int): drive index from Add()
+  //     n (unsigned int): sectors backed up
+  //     total (unsigned int): sectors to back up
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  done[drive] = n;
+  totals[drive] = total;
+
+  if (time(NULL) == last) return;
+  last = time(NULL);
+
+  Print();
+
+}; // END ProgressBoard::Update()
+
+void ProgressBoard::Print(void) {
+  // Print the progress line. The caller holds the mutex.
+
+  unsigned long long all = 0, all_total = 0;
+  char elapsed[32];
+
+  printf("\r\x1b[K");
+  for (unsigned int i = 0; i < labels.size(); i++) {
+    printf("%s %5.1f%% | ", labels[i].c_str(), totals[i] ? 100.0 * done[i] / totals[i] : 0.0);
+    all += done[i];
+    all_total += totals[i];
+  }
+
+  double dt = difftime(time(NULL), t0);
+  Progress format("");
+  format.DeltaString(elapsed, dt);
+
+  printf("total %5.1f%% %.1f MB/s elapsed %s ", all_total ? 100.0 * all / all_total : 0.0,
+         dt > 0 ? all * 2048.0 / dt / 1e6 : 0.0, elapsed);
+  fflush(stdout);
+
+}; // END ProgressBoard::Print()
+
+void ProgressBoard::Finish(void) {
+  // Print the final progress line.
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (finished) return;
+  finished = true;
+
+  Print();
+  printf("\n");
+  fflush(stdout);
+
+}; // END ProgressBoard::Finish()
+
+// Class for backing up one drive through the raw cache path while
+// descrambling and EDC checks run on a worker pool shared by all drives.
+// The drive thread only issues cache reads and writes verified blocks in
+// order, so a slow or retrying drive never holds up the others.
+class DriveBackup {
+
+ public:
+  DriveBackup(Dvd *dvd, Outputs *outputs, SpeedController *speed, ThreadPool *workers,
+              BufferPool *buffers, ProgressBoard *board, unsigned int drive, bool verbose);
+
+  int Run(void);                                                   // back up the disc with its sector layout
+  template <class Layout>
+  int Backup(void);                                                // back up the disc with a known layout
+  template <class Layout>
+  unsigned int Decode(unsigned int cache_start, unsigned int count,
+                      unsigned char *buffer);                      // decode a block and count EDC failures
+  template <class Layout>
+  int Complete(void);                                              // finish the oldest pending block
+
+  // cache block waiting for its decode task
+  struct Pending {
+    unsigned int cache_start;
+    unsigned int count;
+    unsigned char *buffer;
+    std::future<unsigned int> failures;
+  };
+
+  Dvd *dvd;                      // drive to read
+  Outputs *outputs;              // outputs for this drive
+  SpeedController *speed;        // speed controller for this drive
+  ThreadPool *workers;           // shared decode workers
+  BufferPool *buffers;           // shared cache block buffers
+  ProgressBoard *board;          // shared progress line
+  unsigned int drive;            // index on the progress board
+  unsigned int depth;            // blocks in flight for this drive
+  bool verbose;                  // print command details when true
+
+  std::deque<Pending> pending;   // blocks in read order
+
+}; // END class DriveBackup()
+
+DriveBackup::DriveBackup(Dvd *dvd, Outputs *outputs, SpeedController *speed, ThreadPool *workers,
+                         BufferPool *buffers, ProgressBoard *board, unsigned int drive, bool verbose)
+    : dvd(dvd), outputs(outputs), speed(speed), workers(workers), buffers(buffers),
+      board(board), drive(drive), depth(2), verbose(verbose) {
+  // Constructor for the backup of one drive.
+  //
+  // Args:
+  //     dvd (Dvd *): drive with keys found
+  //     outputs (Outputs *): outputs opened for this drive
+  //     speed (SpeedController *): speed controller for this drive
+  //     workers (ThreadPool *): decode workers shared by all drives
+  //     buffers (BufferPool *): cache block buffers shared by all drives
+  //     board (ProgressBoard *): progress line shared by all drives
+  //     drive (unsigned int): index on the progress board
+  //     verbose (bool): set to true to print more details to stdout
+
+}; // END DriveBackup::DriveBackup()
+
+template <class Layout>
+unsigned int DriveBackup::Decode(unsigned int cache_start, unsigned int count, unsigned char *buffer) {
+  // Decode the raw sectors of a cache block in place and verify their EDC.
+  // Runs on a worker thread and only reads the shared drive keys.
+  //
+  // Args:
+  //     cache_start (unsigned int): first sector of the block
+  //     count (unsigned int): number of sectors in the block
+  //     buffer (unsigned char *): raw sectors of the block
+  //
+  // Returns:
+  //     (unsigned int): number of sectors that failed EDC
+
+  unsigned int failures = dvd->DecodeSectors<Layout>(cache_start, count, buffer);
+
+  if (failures) dvd->counters->edc_failures.fetch_add(failures, std::memory_order_relaxed);
+
+  return failures;
+
+}; // END DriveBackup::Decode()
+
+template <class Layout>
+int DriveBackup::Complete(void) {
+  // Wait for the oldest block, re-read it from the drive when sectors
+  // failed EDC and write it to the outputs.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  Pending block = std::move(pending.front());
+  pending.pop_front();
+
+  int status = 0;
+
+  if (block.failures.get() != 0) {
+    speed->Failure(block.cache_start);
+    if (dvd->ReadCacheBlock<Layout>(block.cache_start, block.buffer, 20, verbose) != 0) {
+      printf("\r\x1b[K%s: Cannot read block at sector %u\n", dvd->model, block.cache_start);
+      status = -1;
+    }
+  }
+
+  for (unsigned int n = 0; n < block.count && status == 0; n++) {
+
+    unsigned int sector = block.cache_start + n;
+    unsigned char *raw_sector = block.buffer + n * constants::RAW_SECTOR_SIZE;
+
+    // the first block of a resumed backup starts part way through
+    if (sector < outputs->start_sector) continue;
+
+    speed->Success(sector);
+    if (outputs->iso && outputs->iso->Write(sector, layout::Payload<Layout>(raw_sector)) != 0) status = -1;
+    if (outputs->raw && outputs->raw->Write(sector, raw_sector) != 0) status = -1;
+    if (outputs->sidecar && outputs->sidecar->Write(sector, raw_sector) != 0) status = -1;
+
+  } // END for (n)
+
+  unsigned int first = block.cache_start > outputs->start_sector ? block.cache_start : outputs->start_sector;
+  if (status == 0 && block.cache_start + block.count > first)
+    dvd->counters->Read(first, block.cache_start + block.count - first,
+                        (unsigned long long)(block.cache_start + block.count - first) * outputs->SectorBytes());
+
+  buffers->Release(block.buffer);
+
+  board->Update(drive, block.cache_start + block.count - outputs->start_sector,
+                outputs->end_sector - outputs->start_sector);
+
+  return status;
+
+}; // END DriveBackup::Complete()
+
+int DriveBackup::Run(void) {
+  // Back up the disc from the first sector of the outputs, selecting the
+  // sector layout of the disc once for the whole backup.
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = fail)
+
+  return layout::Select(dvd->dvd_rom, [this](auto disc) { return Backup<decltype(disc)>(); });
+
+}; // END DriveBackup::Run()
+
+template <class Layout>
+int DriveBackup::Backup(void) {
+  // Back up the disc from the first sector of the outputs.
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = fail)
+
+  unsigned int first = outputs->start_sector / constants::SECTORS_PER_CACHE * constants::SECTORS_PER_CACHE;
+  int status = 0;
+
+  for (unsigned int cache_start = first; cache_start < outputs->end_sector && status == 0;
+       cache_start += constants::SECTORS_PER_CACHE) {
+
+    unsigned int count = outputs->end_sector - cache_start < constants::SECTORS_PER_CACHE ?
+                         outputs->end_sector - cache_start : constants::SECTORS_PER_CACHE;
+
+    // finish our own blocks before waiting on other drives for a buffer
+    unsigned char *buffer = buffers->Acquire(false);
+    while (buffer == NULL && status == 0) {
+      if (pending.empty()) buffer = buffers->Acquire(true);
+      else if (Complete<Layout>() != 0) status = -1;
+      else buffer = buffers->Acquire(false);
+    }
+    if (status != 0) break;
+
+    // failed reads are caught by the EDC check and retried in Complete()
+    dvd->ReadRawSectorCache(cache_start, buffer, verbose);
+
+    Pending block;
+    block.cache_start = cache_start;
+    block.count = count;
+    block.buffer = buffer;
+    block.failures = workers->Submit([=]() { return Decode<Layout>(cache_start, count, buffer); });
+    pending.push_back(std::move(block));
+
+    if (pending.size() > depth && Complete<Layout>() != 0) status = -1;
+
+  } // END for (cache_start)
+
+  // drain the remaining blocks, releasing their buffers even after a failure
+  while (!pending.empty()) {
+    if (status == 0) {
+      if (Complete<Layout>() != 0) status = -1;
+    } else {
+      pending.front().failures.wait();
+      buffers->Release(pending.front().buffer);
+      pending.pop_front();
+    }
+  }
+
+  return status == 0 ? 0 : 1;
+
+}; // END DriveBackup::Backup()
+
+namespace backup {
+
+std::string DrivePath(const char *path, const char *device) {
+  // Name the output of one drive by inserting the device name before the
+  // file extension (e.g. game.iso and /dev/sr0 give game.sr0.iso).
+  //
+  // Args:
+  //     path (const char *): output path from the options
+  //     device (const char *): path to the drive
+  //
+  // Returns:
+  //     (std::string): output path for the drive
+
+  std::string name(device), out(path);
+  name = name.substr(name.find_last_of('/') + 1);
+
+  size_t slash = out.find_last_of('/');
+  size_t dot = out.find_last_of('.');
+
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return out + "." + name;
+
+  return out.substr(0, dot) + "." + name + out.substr(dot);
+
+}; // END backup::DrivePath()
+
+int Prepare(Options &options, Dvd &dvd, const char *device) {
+  // Wait for a drive to settle, find the disc type, set the read speed
+  // and find the disc keys.
+  //
+  // Args:
+  //     options (Options &): parsed command line options
+  //     dvd (Dvd &): open drive with a disc loaded
+  //     device (const char *): path to the drive, used in messages
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = fail)
+
+  if (WaitForStandby(dvd, NULL, options.verbose) < 0) {
+    printf("dvdcc:backup:Prepare() %s activity did not stop after 1000 seconds.\n", device);
+    return 1;
+  }
+
+  dvd.Start(options.verbose);
+  if (dvd.FindDiscType(options.verbose) != 0) {
+    printf("dvdcc:backup:Prepare() Cannot find the disc type on %s.\n", device);
+    return 1;
+  }
+
+  if (options.speed > 0 && dvd.SetSpeed(options.speed * constants::DVD_SPEED_1X, options.verbose) != 0)
+    printf("dvdcc:backup:Prepare() %s did not accept read speed %dx. Using drive default.\n", device, options.speed);
+
+  int retry = 0;
+  while (dvd.FindKeys(20, options.verbose) != 0) {
+    dvd.ClearSectorCache(32, options.verbose);
+    trace::Sleep(1);
+    if (retry++ == 5) {
+      printf("dvdcc:backup:Prepare() Reached maximum retry for FindKeys() on %s.\n", device);
+      return 1;
+    }
+  } // END while (dvd.FindKeys...)
+
+  return 0;
+
+}; // END backup::Prepare()
+
+int Dump(Options &options, Dvd &dvd, std::string label, const char *iso_path, const char *raw_path,
+         ThreadPool *workers, BufferPool *buffers, ProgressBoard *board, std::mutex *console) {
+  // Open the outputs for a prepared drive and back up its disc.
+  //
+  // Args:
+  //     options (Options &): parsed command line options
+  //     dvd (Dvd &): drive prepared with Prepare()
+  //     label (std::string): short drive name for the progress board
+  //     iso_path (const char *): ISO output path (NULL = none)
+  //     raw_path (const char *): RAW output path (NULL = none)
+  //     workers (ThreadPool *): decode and compression workers shared by all drives
+  //     buffers (BufferPool *): cache block buffers shared by all drives
+  //     board (ProgressBoard *): progress line shared by all drives
+  //     console (std::mutex *): serializes multi-line messages between drives
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = fail)
+
+  unsigned int max_speed = options.speed > 0 ? options.speed * constants::DVD_SPEED_1X : constants::MAX_SPEED;
+  SpeedController speed(&dvd, max_speed, options.adaptive_speed, options.verbose);
+
+  Outputs outputs;
+  unsigned int drive;
+
+  {
+    std::lock_guard<std::mutex> lock(*console);
+    int status = outputs.Open(options, dvd, (char *)iso_path, (char *)raw_path, STDOUT_FILENO,
+                              options.compress ? workers : NULL);
+    if (status == 0) status = outputs.Limit(options.start_sector, options.end_sector);
+    if (status != 0) {
+      outputs.Close();
+      return 1;
+    }
+    drive = board->Add(label);
+  }
+
+  DriveBackup backup(&dvd, &outputs, &speed, workers, buffers, board, drive, options.verbose);
+  int status = backup.Run();
+
+  if (outputs.Close() != 0) status = 1;
+
+  return status;
+
+}; // END backup::Dump()
+
+int Drive(Options &options, const char *device, ThreadPool *workers, BufferPool *buffers,
+          ProgressBoard *board, std::mutex *console) {
+  // Prepare one drive and back it up. Runs on its own thread.
+  //
+  // Args:
+  //     options (Options &): parsed command line options
+  //     device (const char *): path to the drive
+  //     workers (ThreadPool *): decode and compression workers shared by all drives
+  //     buffers (BufferPool *): cache block buffers shared by all drives
+  //     board (ProgressBoard *): progress line shared by all drives
+  //     console (std::mutex *): serializes multi-line messages between drives
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = fail)
+
+  std::string label(device);
+  label = label.substr(label.find_last_of('/') + 1);
+
+  Dvd dvd(device, options.timeout, options.verbose);
+
+  if (Prepare(options, dvd, device) != 0) return 1;
+
+  std::string iso_path = options.iso ? DrivePath(options.iso, device) : "";
+  std::string raw_path = options.raw ? DrivePath(options.raw, device) : "";
+
+  {
+    std::lock_guard<std::mutex> lock(*console);
+    printf("\n==== %s (%s) ====\n", label.c_str(), dvd.model);
+    dvd.DisplayMetaData();
+  }
+
+  int status = Dump(options, dvd, label, options.iso ? iso_path.c_str() : NULL,
+                    options.raw ? raw_path.c_str() : NULL, workers, buffers, board, console);
+
+  std::lock_guard<std::mutex> lock(*console);
+  printf("\r\x1b[K%s: %s\n", label.c_str(), status == 0 ? "Done." : "Failed.");
+
+  return status;
+
+}; // END backup::Drive()
+
+int MultiDrive(Options &options) {
+  // Back up the discs in several drives at once. Each drive is read by
+  // its own thread, while descrambling, EDC checks and compression run on
+  // one worker pool and cache blocks come from one bounded buffer pool.
+  //
+  // Args:
+  //     options (Options &): parsed command line options with several devices
+  //
+  // Returns:
+  //     (int): status (0 = every drive succeeded, 1 = fail)
+
+  if ((options.iso && strcmp(options.iso, "-") == 0) || (options.raw && strcmp(options.raw, "-") == 0)) {
+    printf("dvdcc:backup:MultiDrive() Cannot stream backups from several drives to stdout.\n");
+    return 1;
+  }
+
+  if (!options.iso && !options.raw) {
+    printf("dvdcc:backup:MultiDrive() Use --iso and/or --raw with several drives.\n");
+    return 1;
+  }
+
+  if (options.selective)
+    printf("Selective backups are not used with several drives. Backing up all sectors.\n\n");
+
+  ThreadPool workers;
+
+  // every drive can keep blocks in flight while workers are busy
+  unsigned int drives = options.devices.size();
+  BufferPool buffers(drives + 2 * workers.size, constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE);
+
+  ProgressBoard board;
+  std::mutex console;
+  std::vector<std::future<int>> results;
+
+  printf("Backing up %u drives on %u worker threads...\n", drives, workers.size);
+
+  for (unsigned int i = 0; i < drives; i++)
+    results.push_back(std::async(std::launch::async, Drive, std::ref(options), options.devices[i],
+                                 &workers, &buffers, &board, &console));
+
+  int status = 0;
+  for (unsigned int i = 0; i < results.size(); i++)
+    if (results[i].get() != 0) status = 1;
+
+  board.Finish();
+
+  return status;
+
+}; // END backup::MultiDrive()
+
+} // namespace backup
+
+#endif // DVDCC_BACKUP_H_
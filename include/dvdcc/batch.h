@@ -0,0 +1,309 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_BATCH_H_
+#define DVDCC_BATCH_H_
+
+#include <time.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <set>
+#include <string>
+#include <vector>
+#include <future>
+#include <mutex>
+
+#include "dvdcc/options.h"
+#include "dvdcc/constants.h"
+#include "dvdcc/devices.h"
+#include "dvdcc/threads.h"
+#include "dvdcc/backup.h"
+
+// Functions for a long running daemon that backs up every disc inserted
+// into a set of drives, one after another, without restarting dvdcc.
+namespace batch {
+
+// set by SIGINT so drives finish their current disc and stop watching
+volatile sig_atomic_t stopping = 0;
+
+void Stop(int signal_number) {
+  // SIGINT handler. A second SIGINT terminates straight away.
+  //
+  // Args:
+  //     signal_number (int): signal received
+
+  stopping = 1;
+  signal(signal_number, SIG_DFL);
+
+}; // END batch::Stop()
+
+// Class for the job log with one line per disc.
+class JobLog {
+
+ public:
+  JobLog() : fp(NULL) {};
+  ~JobLog() { if (fp) fclose(fp); };
+
+  int Open(const char *path);                            // open the log for appending
+  void Record(std::string label, std::string name, int status,
+              double seconds, unsigned int sectors);     // append one job
+
+  FILE *fp;                                              // log file
+  std::mutex mutex;
+
+}; // END class JobLog()
+
+int JobLog::Open(const char *path) {
+  // Open the job log, keeping the jobs of earlier runs.
+  //
+  // Args:
+  //     path (const char *): path to the log
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  fp = fopen(path, "a");
+  if (fp == NULL) return -1;
+
+  return 0;
+
+}; // END JobLog::Open()
+
+void JobLog::Record(std::string label, std::string name, int status, double seconds, unsigned int sectors) {
+  // Append a tab separated line with the time, drive, output name, result,
+  // duration and size of a job.
+  //
+  // Args:
+  //     label (std::string): short drive name
+  //     name (std::string): output name without extension (empty = not identified)
+  //     status (int): job status (0 = success)
+  //     seconds (double): job duration
+  //     sectors (unsigned int): number of disc sectors
+
+  char stamp[32];
+  time_t now = time(NULL);
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  fprintf(fp, "%s\t%s\t%s\t%s\t%.0f\t%u\n", stamp, label.c_str(), name.empty() ? "-" : name.c_str(),
+          status == 0 ? "ok" : "failed", seconds, sectors);
+  fflush(fp);
+
+}; // END JobLog::Record()
+
+std::string OutputName(Dvd &dvd, const char *dir, const char *extension, std::set<std::string> *taken) {
+  // Name the output of a disc from its Gamecube/Wii disc ID (e.g. GALE01
+  // or RSBE01-disc2), or from the time for discs without an ID. A counter
+  // is appended when a disc was already backed up.
+  //
+  // Args:
+  //     dvd (Dvd &): drive with metadata read by Dvd::DisplayMetaData()
+  //     dir (const char *): output directory
+  //     extension (const char *): output file extension (e.g. .iso)
+  //     taken (std::set<std::string> *): names handed out this run, updated
+  //
+  // Returns:
+  //     (std::string): output path without the extension
+
+  std::string base;
+
+  if (!dvd.disc_id.empty()) {
+    // keep only characters that are safe in file names
+    for (unsigned int i = 0; i < dvd.disc_id.size(); i++)
+      base += isalnum((unsigned char)dvd.disc_id[i]) ? dvd.disc_id[i] : '_';
+    if (dvd.disc_number)
+      base += "-disc" + std::to_string(dvd.disc_number + 1);
+  } else {
+    char stamp[32];
+    time_t now = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+    base = dvd.disc_type + "-" + stamp;
+  }
+
+  std::string path = std::string(dir) + "/" + base;
+  std::string candidate = path;
+
+  for (unsigned int n = 2; access((candidate + extension).c_str(), F_OK) == 0 || taken->count(candidate); n++)
+    candidate = path + "-" + std::to_string(n);
+
+  taken->insert(candidate);
+
+  return candidate;
+
+}; // END batch::OutputName()
+
+int Watch(Options &options, const char *device, JobLog *log, std::set<std::string> *taken, std::mutex *naming,
+          ThreadPool *workers, BufferPool *buffers, ProgressBoard *board, std::mutex *console) {
+  // Watch a drive for media events and back up each disc as soon as it is
+  // ready. The drive stays open between discs, so only the new disc is
+  // identified. Discs are ejected after a good backup, while a failed disc
+  // stays in the drive until it is removed. Runs on its own thread.
+  //
+  // Args:
+  //     options (Options &): parsed command line options
+  //     device (const char *): path to the drive
+  //     log (JobLog *): job log shared by all drives
+  //     taken (std::set<std::string> *): output names handed out this run
+  //     naming (std::mutex *): guards taken
+  //     workers (ThreadPool *): decode and compression workers shared by all drives
+  //     buffers (BufferPool *): cache block buffers shared by all drives
+  //     board (ProgressBoard *): progress line shared by all drives
+  //     console (std::mutex *): serializes multi-line messages between drives
+  //
+  // Returns:
+  //     (int): number of failed jobs
+
+  std::string label(device);
+  label = label.substr(label.find_last_of('/') + 1);
+
+  const char *extension = options.compress ? ".dcz" : ".iso";
+  bool handled = false; // the disc in the drive was already backed up
+  int failed = 0;
+
+  Dvd dvd(device, options.timeout, options.verbose);
+
+  {
+    std::lock_guard<std::mutex> lock(*console);
+    printf("\r\x1b[K%s: Watching %s (%s)\n", label.c_str(), device, dvd.model);
+  }
+
+  while (!stopping) {
+
+    // a removed disc or an open tray arms the drive for the next disc
+    if (dvd.PollMedia(options.verbose) != 1) {
+      handled = false;
+      sleep(1);
+      continue;
+    }
+
+    if (handled) {
+      sleep(1);
+      continue;
+    }
+
+    handled = true;
+    time_t t0 = time(NULL);
+
+    dvd.Reset();
+    int status = backup::Prepare(options, dvd, device);
+
+    std::string name, path;
+    if (status == 0) {
+      std::lock_guard<std::mutex> lock(*console);
+      printf("\r\x1b[K\n==== %s (%s) ====\n", label.c_str(), dvd.model);
+      dvd.DisplayMetaData();
+    }
+
+    if (status == 0) {
+      // names are reserved so two drives with the same title never share an output
+      {
+        std::lock_guard<std::mutex> lock(*naming);
+        path = OutputName(dvd, options.daemon_dir, extension, taken);
+      }
+      name = path.substr(path.find_last_of('/') + 1);
+      path += extension;
+      status = backup::Dump(options, dvd, label, path.c_str(), NULL, workers, buffers, board, console);
+    }
+
+    log->Record(label, name, status, difftime(time(NULL), t0), dvd.sector_number);
+
+    {
+      std::lock_guard<std::mutex> lock(*console);
+      if (status == 0)
+        printf("\r\x1b[K%s: Backed up %s. Ejecting.\n", label.c_str(), path.c_str());
+      else
+        printf("\r\x1b[K%s: Backup failed. Remove the disc to continue.\n", label.c_str());
+    }
+
+    if (status == 0) dvd.Eject(options.verbose);
+    else failed++;
+
+  } // END while (!stopping)
+
+  return failed;
+
+}; // END batch::Watch()
+
+int Run(Options &options) {
+  // Back up every disc inserted into the drives until interrupted. Each
+  // drive is watched by its own thread while descrambling, EDC checks and
+  // compression run on one worker pool shared by all drives.
+  //
+  // Args:
+  //     options (Options &): parsed command line options
+  //
+  // Returns:
+  //     (int): status (0 = every job succeeded, 1 = fail)
+
+  if (options.iso || options.raw || options.resume || options.selective || options.start_sector || options.end_sector)
+    printf("Daemon mode backs up whole discs to its own ISO outputs. Ignoring --iso, --raw, --resume,\n"
+           "--selective and sector ranges.\n\n");
+
+  options.resume = 0;
+  options.selective = 0;
+  options.start_sector = options.end_sector = 0;
+
+  if (mkdir(options.daemon_dir, 0755) != 0 && errno != EEXIST) {
+    printf("dvdcc:batch:Run() Cannot create %s\n", options.daemon_dir);
+    return 1;
+  }
+
+  JobLog log;
+  std::string log_path = std::string(options.daemon_dir) + "/dvdcc-jobs.log";
+  if (log.Open(log_path.c_str()) != 0) {
+    printf("dvdcc:batch:Run() Cannot open %s\n", log_path.c_str());
+    return 1;
+  }
+
+  ThreadPool workers;
+
+  unsigned int drives = options.devices.size();
+  BufferPool buffers(drives + 2 * workers.size, constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE);
+
+  ProgressBoard board;
+  std::set<std::string> taken;
+  std::mutex naming, console;
+  std::vector<std::future<int>> results;
+
+  signal(SIGINT, Stop);
+
+  printf("Watching %u drives. Backups go to %s and jobs to %s.\n", drives, options.daemon_dir, log_path.c_str());
+  printf("Press Ctrl+C to stop after the current discs.\n\n");
+
+  for (unsigned int i = 0; i < drives; i++)
+    results.push_back(std::async(std::launch::async, Watch, std::ref(options), options.devices[i], &log,
+                                 &taken, &naming, &workers, &buffers, &board, &console));
+
+  int failed = 0;
+  for (unsigned int i = 0; i < results.size(); i++)
+    failed += results[i].get();
+
+  printf("\r\x1b[K\nStopped.\n");
+
+  return failed ? 1 : 0;
+
+}; // END batch::Run()
+
+} // namespace batch
+
+#endif // DVDCC_BATCH_H_
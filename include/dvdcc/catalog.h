@@ -0,0 +1,418 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_CATALOG_H_
+#define DVDCC_CATALOG_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <future>
+#include <algorithm>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/cypher.h"
+#include "dvdcc/keys.h"
+#include "dvdcc/layout.h"
+#include "dvdcc/chunks.h"
+#include "dvdcc/threads.h"
+#include "dvdcc/metadata.h"
+
+// Functions for indexing a library of ISO, RAW and compressed images
+// without a drive. Only the header sectors of each image are read, so
+// indexing is bound by disk seeks and runs on a thread pool.
+namespace catalog {
+
+const unsigned int MIN_WORKERS = 8; // keep several reads queued on disks with few cores
+
+// Header of one image.
+struct Entry {
+  std::string path;            // image path
+  std::string format;          // ISO, RAW or DCZ
+  std::string type;            // GAMECUBE, WII or UNKNOWN
+  unsigned long long sectors;  // sectors in the image
+  metadata::Header header;     // decoded header (GAMECUBE and WII only)
+  std::string error;           // reason the image could not be read (empty = none)
+};
+
+bool IsImage(const char *name) {
+  // Check the extension of a file name for an image dvdcc can read.
+  //
+  // Args:
+  //     name (const char *): file name
+  //
+  // Returns:
+  //     (bool): true for .iso, .gcm, .raw and .dcz files
+
+  const char *extension = strrchr(name, '.');
+  if (extension == NULL) return false;
+
+  return strcasecmp(extension, ".iso") == 0 || strcasecmp(extension, ".gcm") == 0 ||
+         strcasecmp(extension, ".raw") == 0 || strcasecmp(extension, ".dcz") == 0;
+
+}; // END catalog::IsImage()
+
+void Walk(const std::string &dir, std::vector<std::string> *paths) {
+  // Collect the images of a directory tree. Symbolic links to
+  // directories are not followed so loops cannot occur.
+  //
+  // Args:
+  //     dir (const std::string &): directory to walk
+  //     paths (std::vector<std::string> *): returns the image paths found
+
+  DIR *dp = opendir(dir.c_str());
+  if (dp == NULL) return;
+
+  struct dirent *de;
+  while ((de = readdir(dp)) != NULL) {
+
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+
+    std::string path = dir + "/" + de->d_name;
+    unsigned char type = de->d_type;
+
+    // some file systems leave the type to stat
+    if (type == DT_UNKNOWN) {
+      struct stat st;
+      if (lstat(path.c_str(), &st) != 0) continue;
+      type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+    }
+
+    if (type == DT_DIR)
+      Walk(path, paths);
+    else if ((type == DT_REG || type == DT_LNK) && IsImage(de->d_name))
+      paths->push_back(path);
+
+  } // END while (readdir)
+
+  closedir(dp);
+
+}; // END catalog::Walk()
+
+int Payload(unsigned char *sector, unsigned int sector_size, const unsigned char **payload) {
+  // Find the payload of a header sector, descrambling raw sectors that
+  // were stored as read from the drive cache.
+  //
+  // Args:
+  //     sector (unsigned char *): sector bytes, descrambled in place
+  //     sector_size (unsigned int): SECTOR_SIZE or RAW_SECTOR_SIZE
+  //     payload (const unsigned char **): returns the SECTOR_SIZE payload
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = no seed decodes the sector)
+
+  if (sector_size == constants::SECTOR_SIZE) {
+    *payload = sector;
+    return 0;
+  }
+
+  // images written by dvdcc are stored descrambled
+  if (!keys::Verify(sector)) {
+    Cypher *cypher = keys::FindCypher(sector);
+    if (cypher == NULL) return -1;
+    layout::Descramble<layout::GameDisc>(cypher, sector);
+    delete cypher;
+  }
+
+  // Gamecube/Wii payloads follow the 6 sector ID/IED bytes
+  *payload = layout::Payload<layout::GameDisc>(sector);
+
+  return 0;
+
+}; // END catalog::Payload()
+
+int ReadHeaderSectors(const std::string &path, Entry *entry, unsigned char *first, unsigned char *update,
+                      unsigned int *sector_size) {
+  // Read sector 0 and the update sector of an image. Plain images are
+  // mapped only up to the update sector and only the two sectors are
+  // touched, compressed images decompress the chunks holding them.
+  //
+  // Args:
+  //     path (const std::string &): image path
+  //     entry (Entry *): returns the format and number of sectors
+  //     first (unsigned char *): buffer for sector 0 (RAW_SECTOR_SIZE bytes)
+  //     update (unsigned char *): buffer for the update sector (RAW_SECTOR_SIZE bytes)
+  //     sector_size (unsigned int *): returns the size of the image sectors
+  //
+  // Returns:
+  //     (int): status (0 = both sectors, 1 = sector 0 only, -1 = fail)
+
+  ChunkReader reader;
+  if (reader.Open(path.c_str()) == 0) {
+    entry->format = "DCZ";
+    entry->sectors = reader.sector_number;
+    *sector_size = reader.sector_size;
+    if (*sector_size != constants::SECTOR_SIZE && *sector_size != constants::RAW_SECTOR_SIZE) return -1;
+    if (entry->sectors == 0 || reader.Read(0, first) != 0) return -1;
+    if (entry->sectors <= metadata::UPDATE_SECTOR || reader.Read(metadata::UPDATE_SECTOR, update) != 0) return 1;
+    return 0;
+  }
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return -1;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+
+  // .raw images and images that only divide into raw sectors are RAW
+  const char *extension = strrchr(path.c_str(), '.');
+  bool raw = (extension && strcasecmp(extension, ".raw") == 0) ||
+             (st.st_size % constants::SECTOR_SIZE != 0 && st.st_size % constants::RAW_SECTOR_SIZE == 0);
+
+  entry->format = raw ? "RAW" : "ISO";
+  *sector_size = raw ? constants::RAW_SECTOR_SIZE : constants::SECTOR_SIZE;
+  entry->sectors = st.st_size / *sector_size;
+
+  size_t size = (size_t)(metadata::UPDATE_SECTOR + 1) * *sector_size;
+  if (size > (size_t)st.st_size) size = st.st_size;
+
+  void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapped == MAP_FAILED) return -1;
+
+  // no read ahead past the sectors touched
+  madvise(mapped, size, MADV_RANDOM);
+
+  int status = -1;
+  const unsigned char *data = (const unsigned char *)mapped;
+
+  if (entry->sectors > 0) {
+    memcpy(first, data, *sector_size);
+    status = 1;
+  }
+  if (entry->sectors > metadata::UPDATE_SECTOR) {
+    memcpy(update, data + (size_t)metadata::UPDATE_SECTOR * *sector_size, *sector_size);
+    status = 0;
+  }
+
+  munmap(mapped, size);
+
+  return status;
+
+}; // END catalog::ReadHeaderSectors()
+
+Entry Read(const std::string &path) {
+  // Read and decode the header of one image.
+  //
+  // Args:
+  //     path (const std::string &): image path
+  //
+  // Returns:
+  //     (Entry): decoded header, with error set when it could not be read
+
+  Entry entry;
+  entry.path = path;
+  entry.type = "UNKNOWN";
+  entry.sectors = 0;
+
+  unsigned char first[constants::RAW_SECTOR_SIZE], update[constants::RAW_SECTOR_SIZE];
+  unsigned int sector_size = 0;
+
+  int status = ReadHeaderSectors(path, &entry, first, update, &sector_size);
+  if (status < 0) {
+    entry.error = "cannot read header";
+    return entry;
+  }
+
+  const unsigned char *data, *update_data = NULL;
+  if (Payload(first, sector_size, &data) != 0) {
+    entry.error = "cannot descramble sector 0";
+    return entry;
+  }
+
+  std::string type = metadata::Type(data);
+  if (type.empty()) return entry;
+  entry.type = type;
+
+  if (status == 0 && Payload(update, sector_size, &update_data) != 0) {
+    entry.error = "cannot descramble update sector";
+    update_data = NULL;
+  }
+
+  metadata::Parse(data, update_data, type == "WII", &entry.header);
+
+  return entry;
+
+}; // END catalog::Read()
+
+std::string Csv(const std::string &field) {
+  // quote a CSV field holding separators or quotes
+  if (field.find_first_of(",\"\n") == std::string::npos) return field;
+  std::string quoted = "\"";
+  for (char c : field) quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+  return quoted + "\"";
+}
+
+std::string Json(const std::string &field) {
+  // quote a JSON string
+  std::string quoted = "\"";
+  for (unsigned char c : field) {
+    char escaped[8];
+    if (c == '"' || c == '\\') { quoted += '\\'; quoted += c; }
+    else if (c < 0x20) { snprintf(escaped, sizeof(escaped), "\\u%04x", c); quoted += escaped; }
+    else quoted += c;
+  }
+  return quoted + "\"";
+}
+
+int Write(const char *path, std::vector<Entry> &entries) {
+  // Write the index as JSON when the path ends in .json, or as CSV.
+  //
+  // Args:
+  //     path (const char *): output path
+  //     entries (std::vector<Entry> &): sorted entries
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) return -1;
+
+  size_t length = strlen(path);
+  bool json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+
+  if (json)
+    fprintf(fp, "{\n  \"images\": [\n");
+  else
+    fprintf(fp, "disc_id,disc_number,version,system,region,publisher,title,update,update_key,type,format,sectors,"
+                "path,error\n");
+
+  for (unsigned int i = 0; i < entries.size(); i++) {
+
+    Entry &e = entries[i];
+    metadata::Header &h = e.header;
+    bool known = e.type != "UNKNOWN";
+    char update_key[16] = "";
+    if (e.type == "WII" && h.update_key) snprintf(update_key, sizeof(update_key), "0x%08x", h.update_key);
+
+    if (json)
+      fprintf(fp, "    {\"disc_id\": %s, \"disc_number\": %u, \"version\": %u, \"system\": %s, \"region\": %s, "
+                  "\"publisher\": %s, \"title\": %s, \"update\": %s, \"update_key\": %s, \"type\": %s, "
+                  "\"format\": %s, \"sectors\": %llu, \"path\": %s, \"error\": %s}%s\n",
+              Json(h.disc_id).c_str(), known ? h.disc_number : 0, known ? h.version : 0, Json(h.system).c_str(),
+              Json(h.region).c_str(), Json(h.publisher).c_str(), Json(h.title).c_str(),
+              h.has_update ? "true" : "false", Json(update_key).c_str(), Json(e.type).c_str(),
+              Json(e.format).c_str(), e.sectors, Json(e.path).c_str(), Json(e.error).c_str(),
+              i + 1 < entries.size() ? "," : "");
+    else
+      fprintf(fp, "%s,%u,%u,%s,%s,%s,%s,%s,%s,%s,%s,%llu,%s,%s\n", Csv(h.disc_id).c_str(),
+              known ? h.disc_number : 0, known ? h.version : 0, Csv(h.system).c_str(), Csv(h.region).c_str(),
+              Csv(h.publisher).c_str(), Csv(h.title).c_str(), h.has_update ? "yes" : "no", update_key,
+              e.type.c_str(), e.format.c_str(), e.sectors, Csv(e.path).c_str(), Csv(e.error).c_str());
+
+  } // END for (i)
+
+  if (json) fprintf(fp, "  ]\n}\n");
+
+  bool good = fflush(fp) == 0 && ferror(fp) == 0;
+  if (fclose(fp) != 0) good = false;
+
+  return good ? 0 : -1;
+
+}; // END catalog::Write()
+
+int Run(const char *dir, const char *index_path, bool verbose) {
+  // Index every image below a directory and write the entries sorted by
+  // disc ID, then disc number and path.
+  //
+  // Args:
+  //     dir (const char *): library directory
+  //     index_path (const char *): CSV or JSON output path (NULL = DIR/dvdcc-catalog.csv)
+  //     verbose (bool): when true print every image indexed
+  //
+  // Returns:
+  //     (int): status (0 = every image read, -1 = fail or unreadable images)
+
+  std::string dir_path = dir;
+  while (dir_path.size() > 1 && dir_path.back() == '/') dir_path.pop_back();
+
+  std::string output = index_path ? index_path : dir_path + "/dvdcc-catalog.csv";
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::string> paths;
+  Walk(dir_path, &paths);
+
+  printf("Indexing %zu images in %s...\n\n", paths.size(), dir);
+
+  unsigned int workers = std::thread::hardware_concurrency();
+  ThreadPool pool(workers > MIN_WORKERS ? workers : MIN_WORKERS);
+
+  std::vector<std::future<Entry>> results;
+  for (unsigned int i = 0; i < paths.size(); i++) {
+    std::string path = paths[i];
+    results.push_back(pool.Submit([path]() { return Read(path); }));
+  }
+
+  std::vector<Entry> entries;
+  unsigned int gamecube = 0, wii = 0, updates = 0, failures = 0;
+
+  for (unsigned int i = 0; i < results.size(); i++) {
+
+    entries.push_back(results[i].get());
+    Entry &e = entries.back();
+
+    if (e.type == "GAMECUBE") gamecube++;
+    if (e.type == "WII") wii++;
+    if (e.header.has_update) updates++;
+
+    if (!e.error.empty()) {
+      if (failures++ < 10) printf("dvdcc:catalog:Run() %s: %s\n", e.path.c_str(), e.error.c_str());
+    } else if (verbose) {
+      printf(" %-6s %-8s %s\n", e.header.disc_id.c_str(), e.type.c_str(), e.path.c_str());
+    }
+
+  } // END for (i)
+
+  // images without an ID sort after the rest
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+    if (a.header.disc_id.empty() != b.header.disc_id.empty()) return b.header.disc_id.empty();
+    if (a.header.disc_id != b.header.disc_id) return a.header.disc_id < b.header.disc_id;
+    if (a.header.disc_number != b.header.disc_number) return a.header.disc_number < b.header.disc_number;
+    return a.path < b.path;
+  });
+
+  if (Write(output.c_str(), entries) != 0) {
+    printf("dvdcc:catalog:Run() Cannot write %s\n", output.c_str());
+    return -1;
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("\nIndexed %zu images (%u Gamecube, %u Wii, %u with updates, %u unreadable) in %.1f seconds\n",
+         entries.size(), gamecube, wii, updates, failures, seconds);
+  printf("Catalog: %s\n", output.c_str());
+
+  return failures ? -1 : 0;
+
+}; // END catalog::Run()
+
+} // namespace catalog
+
+#endif // DVDCC_CATALOG_H_
@@ -0,0 +1,398 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_CHUNKS_H_
+#define DVDCC_CHUNKS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <sys/stat.h>
+
+#include <deque>
+#include <vector>
+#include <future>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/sinks.h"
+#include "dvdcc/threads.h"
+
+// Chunked compressed image format
+//
+//   header   64 bytes
+//            0  8 bytes  magic "DVDCCZ01"
+//            8  4 bytes  sector size in bytes
+//           12  4 bytes  sectors per chunk
+//           16  8 bytes  number of sectors
+//           24  4 bytes  number of chunks
+//           28  4 bytes  codec (1 = zlib)
+//           32  8 bytes  index offset
+//   chunks   compressed chunks back to back
+//   index    16 bytes per chunk
+//            0  8 bytes  chunk offset
+//            8  4 bytes  stored chunk size
+//           12  4 bytes  flags (1 = stored without compression)
+//
+// All values are little endian. Every chunk except the last holds
+// sectors per chunk sectors, so sector n lives in chunk n / sectors per chunk.
+namespace chunks {
+
+const char MAGIC[8] = {'D', 'V', 'D', 'C', 'C', 'Z', '0', '1'};
+const unsigned int HEADER_SIZE = 64;
+const unsigned int INDEX_ENTRY_SIZE = 16;
+const unsigned int CODEC_ZLIB = 1;
+const unsigned int FLAG_STORED = 1;
+
+void Put32(unsigned char *p, unsigned int v) {
+  for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+void Put64(unsigned char *p, unsigned long long v) {
+  for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+unsigned int Get32(const unsigned char *p) {
+  unsigned int v = 0;
+  for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+  return v;
+}
+
+unsigned long long Get64(const unsigned char *p) {
+  unsigned long long v = 0;
+  for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+  return v;
+}
+
+// Compressed chunk returned by a worker thread.
+struct Chunk {
+  std::vector<unsigned char> bytes; // stored chunk bytes
+  unsigned int flags;               // FLAG_STORED when compression did not help
+};
+
+Chunk Compress(std::vector<unsigned char> data) {
+  // Compress one chunk with zlib, keeping the original bytes when
+  // compression does not reduce the size.
+  //
+  // Args:
+  //     data (std::vector<unsigned char>): uncompressed chunk
+  //
+  // Returns:
+  //     (Chunk): stored chunk bytes and flags
+
+  Chunk chunk;
+  uLongf length = compressBound(data.size());
+
+  chunk.bytes.resize(length);
+  int status = compress2(chunk.bytes.data(), &length, data.data(), data.size(), Z_DEFAULT_COMPRESSION);
+
+  if (status != Z_OK || length >= data.size()) {
+    chunk.bytes.swap(data);
+    chunk.flags = FLAG_STORED;
+  } else {
+    chunk.bytes.resize(length);
+    chunk.flags = 0;
+  }
+
+  return chunk;
+
+}; // END chunks::Compress()
+
+} // namespace chunks
+
+// Class for writing sectors into the chunked compressed image format.
+// Full chunks are compressed in parallel on a thread pool and written
+// in order as they complete, with at most two chunks per worker pending.
+class ChunkSink : public Sink {
+
+ public:
+  ChunkSink(FILE *fp, unsigned int sector_size, unsigned int sectors_per_chunk, ThreadPool *pool);
+
+  int Write(unsigned int sector, unsigned char *data);
+  int Close(void);
+  int Flush(bool wait);                                // write completed chunks in order
+
+  FILE *fp;                                            // output file
+  ThreadPool *pool;                                    // workers for compression
+  unsigned int sectors_per_chunk;                      // sectors in a full chunk
+  unsigned long long sector_number;                    // sectors received
+  unsigned long long offset;                           // file offset for the next chunk
+  bool failed;                                         // set after a write error
+
+  std::vector<unsigned char> current;                  // chunk being filled
+  std::deque<std::future<chunks::Chunk>> pending;      // chunks being compressed
+  std::vector<unsigned char> index;                    // index entries for written chunks
+
+}; // END class ChunkSink()
+
+ChunkSink::ChunkSink(FILE *fp, unsigned int sector_size, unsigned int sectors_per_chunk, ThreadPool *pool)
+    : Sink(sector_size), fp(fp), pool(pool), sectors_per_chunk(sectors_per_chunk),
+      sector_number(0), offset(chunks::HEADER_SIZE), failed(false) {
+  // Constructor that reserves space for the header.
+  //
+  // Args:
+  //     fp (FILE *): new output file opened for writing
+  //     sector_size (unsigned int): size of the sectors in bytes
+  //     sectors_per_chunk (unsigned int): sectors per chunk, usually a multiple of
+  //                                       constants::SECTORS_PER_CACHE
+  //     pool (ThreadPool *): workers for compression
+
+  unsigned char header[chunks::HEADER_SIZE];
+  memset(header, 0, chunks::HEADER_SIZE);
+  if (fwrite(header, 1, chunks::HEADER_SIZE, fp) != chunks::HEADER_SIZE) failed = true;
+
+  current.reserve((size_t)sector_size * sectors_per_chunk);
+
+}; // END ChunkSink::ChunkSink()
+
+int ChunkSink::Write(unsigned int sector, unsigned char *data) {
+  // Add a sector to the current chunk and queue the chunk for
+  // compression once it is full.
+  //
+  // Args:
+  //     sector (unsigned int): sector number (sectors arrive in order)
+  //     data (unsigned char *): sector bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (failed) return -1;
+
+  current.insert(current.end(), data, data + sector_size);
+  sector_number++;
+
+  if (current.size() < (size_t)sector_size * sectors_per_chunk)
+    return 0;
+
+  // the chunk is moved into the task, std::bind would copy it on every call
+  pending.push_back(pool->Submit([data = std::move(current)]() mutable {
+    return chunks::Compress(std::move(data));
+  }));
+  current.clear();
+  current.reserve((size_t)sector_size * sectors_per_chunk);
+
+  // bound the memory held by chunks waiting on the workers
+  while (pending.size() > 2 * pool->size)
+    if (Flush(true) != 0) return -1;
+
+  return Flush(false);
+
+}; // END ChunkSink::Write()
+
+int ChunkSink::Flush(bool wait) {
+  // Write compressed chunks to the file in order.
+  //
+  // Args:
+  //     wait (bool): wait for the oldest chunk when true, otherwise only
+  //                  write chunks that are already compressed
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  while (!pending.empty()) {
+
+    if (!wait && pending.front().wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      break;
+
+    chunks::Chunk chunk = pending.front().get();
+    pending.pop_front();
+
+    if (fwrite(chunk.bytes.data(), 1, chunk.bytes.size(), fp) != chunk.bytes.size()) {
+      printf("dvdcc:chunks:ChunkSink:Flush() Failed writing chunk\n");
+      failed = true;
+      return -1;
+    }
+
+    unsigned char entry[chunks::INDEX_ENTRY_SIZE];
+    chunks::Put64(entry, offset);
+    chunks::Put32(entry + 8, chunk.bytes.size());
+    chunks::Put32(entry + 12, chunk.flags);
+    index.insert(index.end(), entry, entry + chunks::INDEX_ENTRY_SIZE);
+
+    offset += chunk.bytes.size();
+
+    if (wait) break;
+
+  } // END while (!pending.empty())
+
+  return 0;
+
+}; // END ChunkSink::Flush()
+
+int ChunkSink::Close(void) {
+  // Compress the final partial chunk, then write the index and header.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (!current.empty()) {
+    pending.push_back(pool->Submit([data = std::move(current)]() mutable {
+      return chunks::Compress(std::move(data));
+    }));
+    current.clear();
+  }
+
+  while (!failed && !pending.empty())
+    Flush(true);
+
+  unsigned char header[chunks::HEADER_SIZE];
+  memset(header, 0, chunks::HEADER_SIZE);
+  memcpy(header, chunks::MAGIC, 8);
+  chunks::Put32(header + 8, sector_size);
+  chunks::Put32(header + 12, sectors_per_chunk);
+  chunks::Put64(header + 16, sector_number);
+  chunks::Put32(header + 24, index.size() / chunks::INDEX_ENTRY_SIZE);
+  chunks::Put32(header + 28, chunks::CODEC_ZLIB);
+  chunks::Put64(header + 32, offset);
+
+  if (!failed && fwrite(index.data(), 1, index.size(), fp) != index.size()) failed = true;
+  if (!failed && fseeko(fp, 0, SEEK_SET) != 0) failed = true;
+  if (!failed && fwrite(header, 1, chunks::HEADER_SIZE, fp) != chunks::HEADER_SIZE) failed = true;
+
+  if (fclose(fp) != 0) failed = true;
+
+  return failed ? -1 : 0;
+
+}; // END ChunkSink::Close()
+
+// Class for random access to sectors of a chunked compressed image.
+// Only the chunk holding the requested sector is decompressed and the
+// most recent chunk is kept for sequential reads.
+class ChunkReader {
+
+ public:
+  ChunkReader() : fp(NULL), sector_size(0), sectors_per_chunk(0), sector_number(0),
+                  cached_chunk(-1) {};
+  ~ChunkReader() { if (fp) fclose(fp); };
+
+  int Open(const char *path);                          // read the header and index
+  int Read(unsigned int sector, unsigned char *data);  // read one sector
+
+  FILE *fp;                                            // image file
+  unsigned int sector_size;                            // size of the sectors in bytes
+  unsigned int sectors_per_chunk;                      // sectors in a full chunk
+  unsigned long long sector_number;                    // number of sectors in the image
+  long long cached_chunk;                              // chunk held in cache (-1 = none)
+
+  std::vector<unsigned char> index;                    // index entries
+  std::vector<unsigned char> cache;                    // decompressed cached chunk
+
+}; // END class ChunkReader()
+
+int ChunkReader::Open(const char *path) {
+  // Open an image and read its header and chunk index.
+  //
+  // Args:
+  //     path (const char *): path to the image
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char header[chunks::HEADER_SIZE];
+
+  fp = fopen(path, "rb");
+  if (fp == NULL) return -1;
+
+  if (fread(header, 1, chunks::HEADER_SIZE, fp) != chunks::HEADER_SIZE ||
+      memcmp(header, chunks::MAGIC, 8) != 0 || chunks::Get32(header + 28) != chunks::CODEC_ZLIB)
+    return -1;
+
+  sector_size = chunks::Get32(header + 8);
+  sectors_per_chunk = chunks::Get32(header + 12);
+  sector_number = chunks::Get64(header + 16);
+
+  unsigned long long chunk_number = chunks::Get32(header + 24);
+  unsigned long long index_offset = chunks::Get64(header + 32);
+  struct stat st;
+
+  // every sector must have a chunk and the index must lie within the file
+  if (sector_size == 0 || sectors_per_chunk == 0 ||
+      chunk_number != (sector_number + sectors_per_chunk - 1) / sectors_per_chunk ||
+      fstat(fileno(fp), &st) != 0 || index_offset < chunks::HEADER_SIZE ||
+      index_offset + chunk_number * chunks::INDEX_ENTRY_SIZE > (unsigned long long)st.st_size) {
+    printf("dvdcc:chunks:ChunkReader:Open() Corrupt header in %s\n", path);
+    return -1;
+  }
+
+  index.resize(chunk_number * chunks::INDEX_ENTRY_SIZE);
+  if (fseeko(fp, index_offset, SEEK_SET) != 0 ||
+      fread(index.data(), 1, index.size(), fp) != index.size())
+    return -1;
+
+  // chunks are stored between the header and the index
+  for (unsigned long long chunk = 0; chunk < chunk_number; chunk++) {
+    const unsigned char *entry = index.data() + chunk * chunks::INDEX_ENTRY_SIZE;
+    unsigned long long offset = chunks::Get64(entry);
+    unsigned long long size = chunks::Get32(entry + 8);
+    if (offset < chunks::HEADER_SIZE || offset > index_offset || size > index_offset - offset) {
+      printf("dvdcc:chunks:ChunkReader:Open() Corrupt index entry %llu in %s\n", chunk, path);
+      return -1;
+    }
+  } // END for (chunk)
+
+  return 0;
+
+}; // END ChunkReader::Open()
+
+int ChunkReader::Read(unsigned int sector, unsigned char *data) {
+  // Read one sector, decompressing its chunk when it is not cached.
+  //
+  // Args:
+  //     sector (unsigned int): sector number
+  //     data (unsigned char *): buffer for sector_size bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (sector >= sector_number) return -1;
+
+  long long chunk = sector / sectors_per_chunk;
+
+  if (chunk != cached_chunk) {
+
+    const unsigned char *entry = index.data() + chunk * chunks::INDEX_ENTRY_SIZE;
+    unsigned long long offset = chunks::Get64(entry);
+    unsigned int size = chunks::Get32(entry + 8);
+    unsigned int flags = chunks::Get32(entry + 12);
+
+    std::vector<unsigned char> stored(size);
+    if (fseeko(fp, offset, SEEK_SET) != 0 || fread(stored.data(), 1, size, fp) != size)
+      return -1;
+
+    if (flags & chunks::FLAG_STORED) {
+      cache.swap(stored);
+    } else {
+      uLongf length = (uLongf)sector_size * sectors_per_chunk;
+      cache.resize(length);
+      if (uncompress(cache.data(), &length, stored.data(), size) != Z_OK)
+        return -1;
+      cache.resize(length);
+    }
+
+    cached_chunk = chunk;
+
+  } // END if (chunk != cached_chunk)
+
+  size_t start = (size_t)(sector % sectors_per_chunk) * sector_size;
+  if (start + sector_size > cache.size()) return -1;
+
+  memcpy(data, cache.data() + start, sector_size);
+
+  return 0;
+
+}; // END ChunkReader::Read()
+
+#endif // DVDCC_CHUNKS_H_
@@ -33,11 +33,12 @@
 
 #include "constants.h"
 #include "permissions.h"
+#include "trace.h"
 
 namespace commands {
 
-int Execute(int fd, unsigned char *cmd, unsigned char *buffer,
-            int buflen, int timeout, bool verbose, request_sense *scsi_sense) {
+int Execute(int fd, unsigned char *cmd, unsigned char *buffer, int buflen, int timeout,
+            bool verbose, request_sense *scsi_sense, int direction = CGC_DATA_READ) {
   // Sends a command to the DVD drive using Linux API
   //
   // Args:
@@ -49,6 +50,8 @@ int Execute(int fd, unsigned char *cmd, unsigned char *buffer,
   //     timeout (int): timeout duration in integer seconds
   //     verbose (bool): set to true to print more details to stdout
   //     scsi_sense (request_sense *): pointer to SCSI sense keys
+  //     direction (int): CGC_DATA_READ when the drive returns bytes or
+  //                      CGC_DATA_WRITE when buffer bytes are sent to the drive
   //
   // Returns:
   //     (int): command status (-1 means fail)
@@ -63,7 +66,7 @@ int Execute(int fd, unsigned char *cmd, unsigned char *buffer,
   cgc.buffer = buffer;
   cgc.buflen = buflen;
   cgc.sense = &sense;
-  cgc.data_direction = CGC_DATA_READ;
+  cgc.data_direction = direction;
   cgc.timeout = timeout;
 
   if (verbose) {
@@ -72,7 +75,18 @@ int Execute(int fd, unsigned char *cmd, unsigned char *buffer,
       printf("\n");
   }
 
-  int status = ioctl(fd, CDROM_SEND_PACKET, &cgc);
+  int status;
+
+  // a trace being replayed stands in for the drive
+  if (trace::mode == trace::REPLAY) {
+    status = trace::ReplayCommand(cgc.cmd, buffer, buflen, direction, &sense);
+  } else if (trace::mode == trace::RECORD) {
+    auto start = std::chrono::steady_clock::now();
+    status = ioctl(fd, CDROM_SEND_PACKET, &cgc);
+    trace::RecordCommand(cgc.cmd, buffer, buflen, direction, status, &sense, start, std::chrono::steady_clock::now());
+  } else {
+    status = ioctl(fd, CDROM_SEND_PACKET, &cgc);
+  }
 
   if (verbose)
     printf("dvdcc:commands:Execute() Sense data %02X/%02X/%02X (status %d)\n",
@@ -365,6 +379,157 @@ int TestUnitReady(int fd, int timeout, bool verbose, request_sense *scsi_sense)
 
 }; // END commands::TestUnitReady()
 
+int ReadCapacity(int fd, unsigned int *last_sector, unsigned int *block_size,
+                 int timeout, bool verbose, request_sense *scsi_sense) {
+  // Read the address of the last readable sector and the sector size.
+  //
+  // Args:
+  //     fd (int): the file descriptor of the drive
+  //     last_sector (unsigned int *): returns the last readable sector address
+  //     block_size (unsigned int *): returns the sector size in bytes
+  //     timeout (int): timeout duration in integer seconds
+  //     verbose (bool): set to true to print more details to stdout
+  //     scsi_sense (request_sense *): pointer to SCSI sense keys
+  //
+  // Returns:
+  //     (int): command status (-1 means fail)
+
+  const int buflen = 8;
+  unsigned char cmd[12];
+  unsigned char buffer[buflen];
+
+  memset(cmd, 0, 12);
+  memset(buffer, 0, buflen);
+
+  cmd[0] = constants::MMC_READ_CAPACITY;
+
+  int status = Execute(fd, cmd, buffer, buflen, timeout, verbose, scsi_sense);
+
+  *last_sector = (buffer[0] << 24) + (buffer[1] << 16) + (buffer[2] << 8) + buffer[3];
+  *block_size  = (buffer[4] << 24) + (buffer[5] << 16) + (buffer[6] << 8) + buffer[7];
+
+  return status;
+
+}; // END commands::ReadCapacity()
+
+int ReadDiscStructure(int fd, unsigned char *buffer, int buflen, unsigned char layer,
+                      unsigned char format, int timeout, bool verbose, request_sense *scsi_sense) {
+  // Read a disc structure from the lead-in, such as the physical
+  // format information (format 0x00).
+  //
+  // Args:
+  //     fd (int): the file descriptor of the drive
+  //     buffer (unsigned char *): pointer to the buffer where bytes
+  //                               returned by the command are placed
+  //     buflen (int): length of the buffer
+  //     layer (unsigned char): layer number
+  //     format (unsigned char): disc structure format code
+  //     timeout (int): timeout duration in integer seconds
+  //     verbose (bool): set to true to print more details to stdout
+  //     scsi_sense (request_sense *): pointer to SCSI sense keys
+  //
+  // Returns:
+  //     (int): command status (-1 means fail)
+
+  unsigned char cmd[12];
+
+  memset(cmd, 0, 12);
+
+  cmd[0] = constants::MMC_READ_DISC_STRUCTURE;          // read disc structure command
+  cmd[6] = layer;                                       // layer number
+  cmd[7] = format;                                      // format code
+  cmd[8] = (unsigned char)((buflen & 0xFF00) >> 8);     // allocation MSB
+  cmd[9] = (unsigned char) (buflen & 0x00FF);           // allocation LSB
+
+  return Execute(fd, cmd, buffer, buflen, timeout, verbose, scsi_sense);
+
+}; // END commands::ReadDiscStructure()
+
+int SetCdSpeed(int fd, unsigned int read_speed, int timeout, bool verbose, request_sense *scsi_sense) {
+  // Set the drive read speed using the legacy SET CD SPEED command.
+  //
+  // Args:
+  //     fd (int): the file descriptor of the drive
+  //     read_speed (unsigned int): read speed in kB/s (0xFFFF = maximum speed)
+  //     timeout (int): timeout duration in integer seconds
+  //     verbose (bool): set to true to print more details to stdout
+  //     scsi_sense (request_sense *): pointer to SCSI sense keys
+  //
+  // Returns:
+  //     (int): command status (-1 means fail)
+
+  unsigned char cmd[12];
+
+  memset(cmd, 0, 12);
+
+  if (read_speed > 0xFFFF) read_speed = 0xFFFF;
+
+  cmd[0] = constants::MMC_SET_CD_SPEED;                   // set cd speed command
+  cmd[2] = (unsigned char)((read_speed & 0xFF00) >> 8);   // read speed MSB
+  cmd[3] = (unsigned char) (read_speed & 0x00FF);         // read speed LSB
+  cmd[4] = 0xFF;                                          // write speed MSB (maximum)
+  cmd[5] = 0xFF;                                          // write speed LSB (maximum)
+
+  return Execute(fd, cmd, NULL, 0, timeout, verbose, scsi_sense);
+
+}; // END commands::SetCdSpeed()
+
+int SetStreaming(int fd, unsigned int start_sector, unsigned int end_sector, unsigned int read_speed,
+                 int timeout, bool verbose, request_sense *scsi_sense) {
+  // Set the drive read speed over a range of sectors using the SET STREAMING
+  // command with a 28 byte performance descriptor. The read speed is given as
+  // read_speed kB transferred every 1000 ms.
+  //
+  // Args:
+  //     fd (int): the file descriptor of the drive
+  //     start_sector (unsigned int): first sector of the range
+  //     end_sector (unsigned int): last sector of the range
+  //     read_speed (unsigned int): read speed in kB/s
+  //     timeout (int): timeout duration in integer seconds
+  //     verbose (bool): set to true to print more details to stdout
+  //     scsi_sense (request_sense *): pointer to SCSI sense keys
+  //
+  // Returns:
+  //     (int): command status (-1 means fail)
+
+  const int buflen = 28;
+  const unsigned int time_ms = 1000;
+  unsigned char cmd[12];
+  unsigned char buffer[buflen];
+
+  memset(cmd, 0, 12);
+  memset(buffer, 0, buflen);
+
+  cmd[ 0] = constants::MMC_SET_STREAMING;                         // set streaming command
+  cmd[ 9] = (unsigned char)((buflen & 0xFF00) >> 8);              // parameter length MSB
+  cmd[10] = (unsigned char) (buflen & 0x00FF);                    // parameter length LSB
+
+  buffer[ 0] = 0x00;                                              // no restore defaults / exact
+  buffer[ 4] = (unsigned char)((start_sector & 0xFF000000) >> 24); // start sector MSB
+  buffer[ 5] = (unsigned char)((start_sector & 0x00FF0000) >> 16); // start sector continued
+  buffer[ 6] = (unsigned char)((start_sector & 0x0000FF00) >> 8);  // start sector continued
+  buffer[ 7] = (unsigned char) (start_sector & 0x000000FF);        // start sector LSB
+  buffer[ 8] = (unsigned char)((end_sector & 0xFF000000) >> 24);   // end sector MSB
+  buffer[ 9] = (unsigned char)((end_sector & 0x00FF0000) >> 16);   // end sector continued
+  buffer[10] = (unsigned char)((end_sector & 0x0000FF00) >> 8);    // end sector continued
+  buffer[11] = (unsigned char) (end_sector & 0x000000FF);          // end sector LSB
+  buffer[12] = (unsigned char)((read_speed & 0xFF000000) >> 24);   // read size MSB
+  buffer[13] = (unsigned char)((read_speed & 0x00FF0000) >> 16);   // read size continued
+  buffer[14] = (unsigned char)((read_speed & 0x0000FF00) >> 8);    // read size continued
+  buffer[15] = (unsigned char) (read_speed & 0x000000FF);          // read size LSB
+  buffer[18] = (unsigned char)((time_ms & 0xFF00) >> 8);           // read time MSB
+  buffer[19] = (unsigned char) (time_ms & 0x00FF);                 // read time LSB
+  buffer[20] = buffer[12];                                         // write size (same as read)
+  buffer[21] = buffer[13];
+  buffer[22] = buffer[14];
+  buffer[23] = buffer[15];
+  buffer[26] = buffer[18];                                         // write time (same as read)
+  buffer[27] = buffer[19];
+
+  return Execute(fd, cmd, buffer, buflen, timeout, verbose, scsi_sense, CGC_DATA_WRITE);
+
+}; // END commands::SetStreaming()
+
 } // namespace commands
 
 #endif // DVDCC_COMMANDS_H_
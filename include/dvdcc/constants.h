@@ -26,19 +26,26 @@
 
 namespace constants {
 
-unsigned char SBC_START_STOP = 0x1B;
-unsigned char SPC_INQUIRY    = 0x12;
-unsigned char MMC_READ_12    = 0xA8;
+const unsigned char SBC_START_STOP          = 0x1B;
+const unsigned char SPC_INQUIRY             = 0x12;
+const unsigned char MMC_READ_CAPACITY       = 0x25;
+const unsigned char MMC_READ_12             = 0xA8;
+const unsigned char MMC_READ_DISC_STRUCTURE = 0xAD;
+const unsigned char MMC_SET_STREAMING       = 0xB6;
+const unsigned char MMC_SET_CD_SPEED        = 0xBB;
 
-unsigned int HITACHI_MEM_BASE = 0x80000000;
+const unsigned int HITACHI_MEM_BASE = 0x80000000;
 
-unsigned int BLOCKS_PER_CACHE = 5;
+const unsigned int BLOCKS_PER_CACHE = 5;
 
-unsigned int SECTOR_SIZE = 2048;
-unsigned int SECTORS_PER_BLOCK = 16;
-unsigned int SECTORS_PER_CACHE = BLOCKS_PER_CACHE * SECTORS_PER_BLOCK;
+const unsigned int SECTOR_SIZE = 2048;
+const unsigned int SECTORS_PER_BLOCK = 16;
+const unsigned int SECTORS_PER_CACHE = BLOCKS_PER_CACHE * SECTORS_PER_BLOCK;
 
-unsigned int RAW_SECTOR_SIZE = 2064;
+const unsigned int RAW_SECTOR_SIZE = 2064;
+
+const unsigned int DVD_SPEED_1X = 1385; // 1x DVD read speed in kB/s
+const unsigned int MAX_SPEED = 0xFFFF;  // speed value requesting the maximum drive speed
 
 enum class PowerStates {
   kActive  = 0x01,
@@ -55,18 +62,21 @@ enum class EventType {
   kDeviceBusy        = 0x40,
 };
 
-std::map<unsigned int, std::string> sector_numbers = {
+const unsigned int MAX_SECTOR_NUMBER = 0x500000; // beyond the end of any dual layer disc
+const unsigned int LEAD_OUT_MARGIN = 128;        // sectors past the end that may still read as in range
+
+const std::map<unsigned int, std::string> sector_numbers = {
   {712880, "GAMECUBE"}, {2294912, "WII_SINGLE_LAYER"}, {4155840, "WII_DUAL_LAYER"}};
 
-std::map<std::string, std::string> systems = {
+const std::map<std::string, std::string> systems = {
   {"G", "Gamecube"}, {"R", "Wii"}};
 
-std::map<std::string, std::string> regions = {
+const std::map<std::string, std::string> regions = {
   {"P", "PAL"}, {"E", "NTSC"}, {"J", "JAP"}, {"U", "AUS" }, {"F", "FRA" },
   {"D", "GER"}, {"I", "ITA" }, {"S", "SPA"}, {"X", "PALX"}, {"Y", "PALY"}};
 
 // The following list has been derived from http://wiitdb.com/Company/HomePage
-std::map<std::string, std::string> publishers = {
+const std::map<std::string, std::string> publishers = {
   {"01", "Nintendo"},                                      {"02", "Rocket Games / Ajinomoto"},
   {"03", "Imagineer-Zoom"},                                {"04", "Gray Matter"},
   {"05", "Zamuse"},                                        {"06", "Falcom"},
@@ -0,0 +1,289 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_CONVERT_H_
+#define DVDCC_CONVERT_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <future>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/cypher.h"
+#include "dvdcc/keys.h"
+#include "dvdcc/layout.h"
+#include "dvdcc/metadata.h"
+#include "dvdcc/progress.h"
+#include "dvdcc/threads.h"
+
+// Functions for converting and verifying RAW images without a drive.
+namespace convert {
+
+// Class for a read only memory mapping of an image file.
+class MappedImage {
+
+ public:
+  MappedImage() : data(NULL), size(0) {};
+  ~MappedImage() { if (data) munmap((void *)data, size); };
+
+  int Open(const char *path);  // map the whole file
+
+  const unsigned char *data;   // mapped file bytes
+  size_t size;                 // file size in bytes
+
+}; // END class MappedImage()
+
+int MappedImage::Open(const char *path) {
+  // Map a file read only for sequential access.
+  //
+  // Args:
+  //     path (const char *): path to the file
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  struct stat st;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+
+  void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapped == MAP_FAILED) return -1;
+
+  madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+  data = (const unsigned char *)mapped;
+  size = st.st_size;
+
+  return 0;
+
+}; // END MappedImage::Open()
+
+template <class Layout>
+std::vector<unsigned int> DecodeBlock(const unsigned char *image, unsigned int first, unsigned int count,
+                                      std::vector<Cypher *> *cyphers, int fd) {
+  // Decode and verify a run of raw sectors of the given layout and write
+  // their payload to the ISO. Sectors that fail their EDC are written as
+  // zeros.
+  //
+  // Args:
+  //     image (const unsigned char *): mapped RAW image
+  //     first (unsigned int): first sector of the run
+  //     count (unsigned int): number of sectors
+  //     cyphers (std::vector<Cypher *> *): cyphers for a scrambled image (empty = descrambled)
+  //     fd (int): ISO output (-1 = verify only)
+  //
+  // Returns:
+  //     (std::vector<unsigned int>): sectors that failed verification
+
+  std::vector<unsigned int> bad;
+  std::vector<unsigned char> iso((size_t)count * constants::SECTOR_SIZE, 0);
+  unsigned char raw_sector[constants::RAW_SECTOR_SIZE], zeros[constants::RAW_SECTOR_SIZE];
+
+  memset(zeros, 0, constants::RAW_SECTOR_SIZE);
+
+  for (unsigned int n = 0; n < count; n++) {
+
+    unsigned int sector = first + n;
+    memcpy(raw_sector, image + (size_t)sector * constants::RAW_SECTOR_SIZE, constants::RAW_SECTOR_SIZE);
+
+    // sectors skipped by a selective backup stay zero
+    if (memcmp(raw_sector, zeros, constants::RAW_SECTOR_SIZE) == 0) continue;
+
+    if (!cyphers->empty()) {
+      unsigned int i = keys::CypherIndex(sector / constants::SECTORS_PER_BLOCK, cyphers->size());
+      layout::Descramble<Layout>((*cyphers)[i], raw_sector);
+    }
+
+    if (layout::Verify<Layout>(raw_sector))
+      layout::Extract<Layout>(raw_sector, 1, iso.data() + (size_t)n * constants::SECTOR_SIZE);
+    else
+      bad.push_back(sector);
+
+  } // END for (n)
+
+  if (fd >= 0 && pwrite(fd, iso.data(), iso.size(), (off_t)first * constants::SECTOR_SIZE) != (ssize_t)iso.size())
+    bad.push_back(0xFFFFFFFF);
+
+  return bad;
+
+}; // END convert::DecodeBlock()
+
+int Scan(const unsigned char *image, unsigned int sector_number, std::vector<Cypher *> *cyphers,
+         bool dvd_rom, int fd, std::vector<unsigned int> *bad) {
+  // Decode and verify every sector of a mapped RAW image, one cache block
+  // per task on all cores, optionally writing the payload to an ISO.
+  //
+  // Args:
+  //     image (const unsigned char *): mapped RAW image
+  //     sector_number (unsigned int): number of sectors in the image
+  //     cyphers (std::vector<Cypher *> *): cyphers for a scrambled image (empty = descrambled)
+  //     dvd_rom (bool): true for standard DVD-ROM sectors, false for Gamecube/Wii
+  //     fd (int): ISO output (-1 = verify only)
+  //     bad (std::vector<unsigned int> *): returns the sectors that failed verification
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = failed writing the ISO)
+
+  ThreadPool pool;
+  std::deque<std::future<std::vector<unsigned int>>> pending;
+  bool failed = false;
+
+  Progress progress("Progress");
+  progress.Start();
+
+  // collect finished blocks in order with a bounded number in flight
+  auto collect = [&]() {
+    std::vector<unsigned int> result = pending.front().get();
+    pending.pop_front();
+    for (unsigned int n = 0; n < result.size(); n++) {
+      if (result[n] == 0xFFFFFFFF) failed = true;
+      else bad->push_back(result[n]);
+    }
+  };
+
+  layout::Select(dvd_rom, [&](auto disc) {
+    using Layout = decltype(disc);
+
+    for (unsigned int sector = 0; sector < sector_number; sector += constants::SECTORS_PER_CACHE) {
+
+      unsigned int count = sector_number - sector < constants::SECTORS_PER_CACHE ?
+                           sector_number - sector : constants::SECTORS_PER_CACHE;
+
+      if (pending.size() >= 2 * pool.size) collect();
+
+      pending.push_back(pool.Submit([=]() { return DecodeBlock<Layout>(image, sector, count, cyphers, fd); }));
+
+      progress.Update(sector + count - 1, sector_number);
+
+    } // END for (sector)
+
+  });
+
+  while (!pending.empty()) collect();
+  progress.Finish();
+
+  return failed ? -1 : 0;
+
+}; // END convert::Scan()
+
+int FromRaw(const char *raw_path, const char *iso_path, bool verbose) {
+  // Convert a RAW image to an ISO and report sectors that fail their EDC.
+  // The image is memory mapped and decoded one cache block per task on
+  // all cores. Both the descrambled RAW images written by dvdcc and
+  // scrambled images are accepted; the cyphers of scrambled images are
+  // recovered from the image with the same search used by Dvd::FindKeys().
+  //
+  // Args:
+  //     raw_path (const char *): path to the RAW image
+  //     iso_path (const char *): path of the new ISO (NULL = verify only)
+  //     verbose (bool): when true list every bad sector
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail or bad sectors found)
+
+  MappedImage image;
+  if (image.Open(raw_path) != 0) {
+    printf("dvdcc:convert:FromRaw() Cannot map %s\n", raw_path);
+    return -1;
+  }
+
+  unsigned int sector_number = image.size / constants::RAW_SECTOR_SIZE;
+  if (image.size % constants::RAW_SECTOR_SIZE != 0)
+    printf("dvdcc:convert:FromRaw() Ignoring %zu trailing bytes of an incomplete sector\n",
+           image.size % constants::RAW_SECTOR_SIZE);
+
+  // images written by dvdcc are stored descrambled
+  std::vector<Cypher *> cyphers;
+  unsigned char first[constants::RAW_SECTOR_SIZE];
+  memcpy(first, image.data, constants::RAW_SECTOR_SIZE);
+
+  if (!keys::Verify(first)) {
+    printf("Finding DVD keys...\n\n");
+    if (keys::FindSequence(image.data, sector_number, 20, &cyphers) != 0) {
+      printf("dvdcc:convert:FromRaw() Cannot find the keys for %s\n", raw_path);
+      for (unsigned int i = 0; i < cyphers.size(); i++) delete cyphers[i];
+      return -1;
+    }
+    printf("\nDone.\n\n");
+    layout::Descramble<layout::Sector>(cyphers[0], first);
+  } // END if (!keys::Verify(first))
+
+  // only Gamecube and Wii discs carry their header at the 6 byte payload offset
+  bool dvd_rom = metadata::Type(layout::Payload<layout::GameDisc>(first)).empty();
+
+  // never overwrite an existing ISO
+  int fd = -1;
+  if (iso_path) {
+    fd = open(iso_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)sector_number * constants::SECTOR_SIZE) != 0) {
+      printf("dvdcc:convert:FromRaw() Cannot create %s. Delete it if it already exists.\n", iso_path);
+      for (unsigned int i = 0; i < cyphers.size(); i++) delete cyphers[i];
+      if (fd >= 0) close(fd);
+      return -1;
+    }
+  } // END if (iso_path)
+
+  std::vector<unsigned int> bad;
+  bool failed = Scan(image.data, sector_number, &cyphers, dvd_rom, fd, &bad) != 0;
+
+  for (unsigned int i = 0; i < cyphers.size(); i++) delete cyphers[i];
+
+  if (fd >= 0 && close(fd) != 0) failed = true;
+
+  if (failed) {
+    printf("dvdcc:convert:FromRaw() Failed writing %s\n", iso_path);
+    return -1;
+  }
+
+  // bad sector report
+  printf("\nVerified %u sectors, %zu failed EDC.\n", sector_number, bad.size());
+  for (unsigned int n = 0; n < bad.size() && (verbose || n < 10); n++)
+    printf(" * Bad sector %u\n", bad[n]);
+
+  if (iso_path && !bad.empty()) {
+    std::string report_path = std::string(iso_path) + ".bad";
+    FILE *report = fopen(report_path.c_str(), "w");
+    if (report) {
+      fprintf(report, "# sectors of %s that failed EDC (written as zeros)\n", raw_path);
+      for (unsigned int n = 0; n < bad.size(); n++) fprintf(report, "%u\n", bad[n]);
+      fclose(report);
+      printf("Bad sector report: %s\n", report_path.c_str());
+    }
+  } // END if (iso_path && ...)
+
+  return bad.empty() ? 0 : -1;
+
+}; // END convert::FromRaw()
+
+} // namespace convert
+
+#endif // DVDCC_CONVERT_H_
@@ -35,6 +35,9 @@ class Cypher {
   void Decode32(unsigned char *data, unsigned int start);
   void Decode64(unsigned char *data, unsigned int start);
 
+  template <unsigned int START, unsigned int LENGTH>
+  void Decode64(unsigned char *data) const;  // decode a range fixed at compile time
+
   unsigned int seed;     // seed value used to create the cypher
   unsigned int length;   // cypher length in bytes
   unsigned int length32; // length used for 32 bit decode speedup
@@ -141,4 +144,22 @@ void Cypher::Decode64(unsigned char *data, unsigned int start) {
 
 }; // END Cypher::Decode64()
 
+template <unsigned int START, unsigned int LENGTH>
+void Cypher::Decode64(unsigned char *data) const {
+  // Uses the first LENGTH cypher bytes to decode data bytes beginning
+  // from START in steps of 64 bits. With both known at compile time the
+  // loop can be unrolled and vectorized.
+  //
+  // Args:
+  //     data (unsigned char *): pointer to data bytes for decoding
+
+  static_assert(LENGTH % 8 == 0, "Decode64() length must be a multiple of 8");
+
+  unsigned long int *data64 = (unsigned long int *)(data + START);
+  const unsigned long int *bytes64 = (const unsigned long int *)bytes;
+  for (unsigned int i = 0; i < LENGTH / 8; i++)
+    data64[i] = data64[i] ^ bytes64[i];
+
+}; // END Cypher::Decode64()
+
 #endif // DVDCC_CYPHER_H_
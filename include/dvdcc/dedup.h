@@ -0,0 +1,530 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_DEDUP_H_
+#define DVDCC_DEDUP_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/sinks.h"
+#include "dvdcc/chunks.h"
+#include "dvdcc/hashes.h"
+
+// Functions for a content addressed archive store. ISO backups are cut
+// into 32 KB clusters (one Wii cluster, one ECC block), each unique
+// cluster is written once to a pack shared by every disc, and each image
+// is saved as a manifest of cluster hashes. Update partitions and other
+// data repeated across discs then cost one manifest entry per cluster.
+//
+// Store directory
+//
+//   pack     clusters of CLUSTER_SIZE bytes in the order they were added
+//   index    20 byte SHA-1 of each pack cluster, in pack order. A slot
+//            is reserved with an all zero entry and its SHA-1 is only
+//            written once the pack cluster is synced to disk, so a crash
+//            never leaves an entry pointing at missing pack data.
+//
+// Manifest format (ISO path + .manifest)
+//
+//   header   16 bytes
+//             0  8 bytes  magic "DVDCCD01"
+//             8  4 bytes  sectors per cluster
+//            12  4 bytes  number of disc sectors
+//   entries  20 byte SHA-1 of each cluster of the image, in order
+//
+// All integers are little endian. An all zero entry is a cluster that
+// was never written, such as elided junk or sectors outside the backup
+// range, and is restored as a hole. The last cluster of a disc is padded
+// with zeros. Several processes can add to a store at once, the index is
+// locked while a cluster is appended.
+namespace dedup {
+
+const char MAGIC[8] = {'D', 'V', 'D', 'C', 'C', 'D', '0', '1'};
+const unsigned int HEADER_SIZE = 16;
+const unsigned int ENTRY_SIZE = 20;
+const unsigned int SECTORS_PER_CLUSTER = constants::SECTORS_PER_BLOCK;
+const unsigned int CLUSTER_SIZE = SECTORS_PER_CLUSTER * constants::SECTOR_SIZE;
+const unsigned int SYNC_CLUSTERS = 64;  // clusters added between pack syncs
+
+// Class for the pack and index of a store directory.
+class Store {
+
+ public:
+  Store() : pack(-1), index(-1), clusters(0), added(0), shared(0) {};
+  ~Store() { if (pack >= 0) close(pack); if (index >= 0) close(index); };
+
+  int Open(const char *path, bool create);                    // open the store, loading the index
+  int Refresh(void);                                          // load entries added by other writers
+  int Put(const unsigned char *digest, const unsigned char *data); // store a cluster unless present
+  int Get(const unsigned char *digest, unsigned char *data);  // read and check a cluster
+  int Commit(void);                                           // sync the pack, then index its new clusters
+  int Sync(void);                                             // flush the pack and index to disk
+
+  int pack;                                                   // pack file
+  int index;                                                  // index file
+  std::string dir;                                            // store directory
+  unsigned long long clusters;                                // clusters in the pack
+  unsigned long long added;                                   // clusters added by this writer
+  unsigned long long shared;                                  // clusters found already stored
+  std::unordered_map<std::string, unsigned long long> lookup; // digest to pack cluster
+  std::vector<std::pair<unsigned long long, std::string>> unsynced; // reserved slots awaiting a pack sync
+
+}; // END class Store()
+
+int Store::Open(const char *path, bool create) {
+  // Open the pack and index of a store directory and load the index.
+  //
+  // Args:
+  //     path (const char *): store directory
+  //     create (bool): create the directory and files when missing
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  dir = path;
+
+  if (create) mkdir(path, 0755);
+
+  int flags = create ? O_RDWR | O_CREAT : O_RDONLY;
+  pack = open((dir + "/pack").c_str(), flags, 0644);
+  index = open((dir + "/index").c_str(), flags, 0644);
+
+  if (pack < 0 || index < 0) {
+    printf("dvdcc:dedup:Store:Open() Cannot open the store in %s\n", path);
+    return -1;
+  }
+
+  return Refresh();
+
+}; // END Store::Open()
+
+int Store::Refresh(void) {
+  // Load the index entries added since the last refresh, by this or
+  // another process. A partial entry left by an interrupted writer is
+  // ignored and overwritten by the next cluster added. Reserved slots
+  // (all zero entries) are skipped until a later open.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  struct stat st;
+  if (fstat(index, &st) != 0) return -1;
+
+  unsigned long long entries = st.st_size / ENTRY_SIZE;
+  if (entries <= clusters) return 0;
+
+  std::vector<unsigned char> buffer((entries - clusters) * ENTRY_SIZE);
+  if (pread(index, buffer.data(), buffer.size(), clusters * ENTRY_SIZE) != (ssize_t)buffer.size()) return -1;
+
+  // the first copy of a cluster wins
+  const std::string reserved(ENTRY_SIZE, '\0');
+  for (unsigned long long i = 0; i < entries - clusters; i++) {
+    std::string key((char *)buffer.data() + i * ENTRY_SIZE, ENTRY_SIZE);
+    if (key != reserved) lookup.emplace(key, clusters + i);
+  }
+
+  clusters = entries;
+
+  return 0;
+
+}; // END Store::Refresh()
+
+int Store::Put(const unsigned char *digest, const unsigned char *data) {
+  // Add a cluster to the pack unless a cluster with the same digest is
+  // already stored. The cluster gets a reserved index slot and its
+  // digest is written by Commit() once the pack has been synced.
+  //
+  // Args:
+  //     digest (const unsigned char *): SHA-1 of the cluster
+  //     data (const unsigned char *): CLUSTER_SIZE bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  std::string key((char *)digest, ENTRY_SIZE);
+
+  if (lookup.count(key)) {
+    shared++;
+    return 0;
+  }
+
+  if (flock(index, LOCK_EX) != 0) return -1;
+
+  // another writer may have added it since the last refresh
+  int status = Refresh();
+  if (status == 0 && lookup.count(key)) {
+    shared++;
+    flock(index, LOCK_UN);
+    return 0;
+  }
+
+  unsigned char reserved[ENTRY_SIZE];
+  memset(reserved, 0, ENTRY_SIZE);
+
+  if (status == 0 && pwrite(pack, data, CLUSTER_SIZE, clusters * CLUSTER_SIZE) != CLUSTER_SIZE) status = -1;
+  if (status == 0 && pwrite(index, reserved, ENTRY_SIZE, clusters * ENTRY_SIZE) != ENTRY_SIZE) status = -1;
+
+  if (status == 0) {
+    lookup.emplace(key, clusters);
+    unsynced.push_back(std::make_pair(clusters, key));
+    clusters++;
+    added++;
+  }
+
+  flock(index, LOCK_UN);
+
+  if (status == 0 && unsynced.size() >= SYNC_CLUSTERS) status = Commit();
+
+  return status;
+
+}; // END Store::Put()
+
+int Store::Get(const unsigned char *digest, unsigned char *data) {
+  // Read a cluster from the pack and check it against its digest.
+  //
+  // Args:
+  //     digest (const unsigned char *): SHA-1 of the cluster
+  //     data (unsigned char *): buffer for CLUSTER_SIZE bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = not stored or damaged)
+
+  auto it = lookup.find(std::string((char *)digest, ENTRY_SIZE));
+  if (it == lookup.end()) return -1;
+
+  if (pread(pack, data, CLUSTER_SIZE, it->second * CLUSTER_SIZE) != CLUSTER_SIZE) return -1;
+
+  unsigned char check[ENTRY_SIZE];
+  Sha1 sha1;
+  sha1.Update(data, CLUSTER_SIZE);
+  sha1.Final(check);
+
+  return memcmp(check, digest, ENTRY_SIZE) == 0 ? 0 : -1;
+
+}; // END Store::Get()
+
+int Store::Commit(void) {
+  // Sync the pack, then write the digests of the clusters added since the
+  // last commit into their reserved index slots. The slots belong to this
+  // writer, so no lock is needed.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (unsynced.empty()) return 0;
+
+  if (fdatasync(pack) != 0) return -1;
+
+  for (unsigned int i = 0; i < unsynced.size(); i++)
+    if (pwrite(index, unsynced[i].second.data(), ENTRY_SIZE, unsynced[i].first * ENTRY_SIZE) != ENTRY_SIZE)
+      return -1;
+
+  unsynced.clear();
+
+  return 0;
+
+}; // END Store::Commit()
+
+int Store::Sync(void) {
+  // Commit the remaining clusters and flush the index so stored entries
+  // survive a crash.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (Commit() != 0 || fsync(index) != 0) return -1;
+
+  return 0;
+
+}; // END Store::Sync()
+
+int Restore(const char *manifest_path, const char *store_dir, const char *iso_path) {
+  // Rebuild an ISO backup from its manifest and the store holding its
+  // clusters. Every cluster is checked against its digest. Clusters never
+  // written to the manifest are left as holes.
+  //
+  // Args:
+  //     manifest_path (const char *): path to the manifest
+  //     store_dir (const char *): store directory
+  //     iso_path (const char *): path of the new ISO file
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char header[HEADER_SIZE], entry[ENTRY_SIZE], zeros[ENTRY_SIZE];
+
+  FILE *fp = fopen(manifest_path, "rb");
+  if (fp == NULL || fread(header, 1, HEADER_SIZE, fp) != HEADER_SIZE || memcmp(header, MAGIC, 8) != 0 ||
+      chunks::Get32(header + 8) != SECTORS_PER_CLUSTER) {
+    printf("dvdcc:dedup:Restore() Cannot read manifest %s\n", manifest_path);
+    if (fp) fclose(fp);
+    return -1;
+  }
+
+  unsigned int sector_number = chunks::Get32(header + 12);
+  unsigned int cluster_number = (sector_number + SECTORS_PER_CLUSTER - 1) / SECTORS_PER_CLUSTER;
+
+  Store store;
+  if (store.Open(store_dir, false) != 0) {
+    fclose(fp);
+    return -1;
+  }
+
+  // never overwrite an existing ISO file
+  FILE *out = access(iso_path, F_OK) == 0 ? NULL : fopen(iso_path, "wb");
+  if (out == NULL) {
+    printf("dvdcc:dedup:Restore() Cannot create %s. Delete it if it already exists.\n", iso_path);
+    fclose(fp);
+    return -1;
+  }
+
+  printf("Restoring %u sectors from %s...\n", sector_number, store_dir);
+
+  memset(zeros, 0, ENTRY_SIZE);
+
+  std::vector<unsigned char> cluster(CLUSTER_SIZE);
+  unsigned long long image_size = (unsigned long long)sector_number * constants::SECTOR_SIZE;
+  unsigned int holes = 0, cluster_index;
+  int status = 0;
+
+  for (cluster_index = 0; cluster_index < cluster_number && status == 0; cluster_index++) {
+
+    if (fread(entry, 1, ENTRY_SIZE, fp) != ENTRY_SIZE) {
+      printf("dvdcc:dedup:Restore() Manifest ends before cluster %u\n", cluster_index);
+      status = -1;
+      break;
+    }
+
+    off_t offset = (off_t)cluster_index * CLUSTER_SIZE;
+
+    if (memcmp(entry, zeros, ENTRY_SIZE) == 0) {
+      holes++;
+      continue;
+    }
+
+    if (store.Get(entry, cluster.data()) != 0) {
+      printf("dvdcc:dedup:Restore() Cluster %u is missing or damaged in the store\n", cluster_index);
+      status = -1;
+      break;
+    }
+
+    // the last cluster is padded past the end of the disc
+    size_t size = CLUSTER_SIZE;
+    if (offset + size > image_size) size = image_size - offset;
+
+    if (fseeko(out, offset, SEEK_SET) != 0 || fwrite(cluster.data(), 1, size, out) != size) status = -1;
+
+  } // END for (cluster_index)
+
+  // holes at the end of the disc still count toward the image size
+  if (status == 0 && (fflush(out) != 0 || ftruncate(fileno(out), image_size) != 0)) status = -1;
+  if (fclose(out) != 0) status = -1;
+  fclose(fp);
+
+  if (status != 0) {
+    printf("dvdcc:dedup:Restore() Cannot restore %s\n", iso_path);
+    return -1;
+  }
+
+  printf("Restored %u clusters (%u left as holes) to %s\n", cluster_number, holes, iso_path);
+
+  return 0;
+
+}; // END dedup::Restore()
+
+} // namespace dedup
+
+// Class for saving an ISO backup to a store as it is written. Sectors are
+// gathered into clusters, each cluster is added to the store and its
+// digest is written to the manifest in place of the ISO.
+class DedupSink : public Sink {
+
+ public:
+  DedupSink(const char *store_dir, const char *path, bool resume, bool compress, unsigned int sector_number);
+
+  int Write(unsigned int sector, unsigned char *data);
+  int Skip(unsigned int sector, unsigned int count);
+  int Close(void);
+  int Flush(void);                          // store the buffered cluster
+
+  dedup::Store store;                       // shared pack and index
+  int manifest;                             // manifest file
+  std::string manifest_path;                // ISO path + .manifest
+  unsigned int sector_number;               // number of disc sectors
+  unsigned int cluster_index;               // cluster being buffered
+  unsigned int written;                     // sectors written to the buffered cluster
+  std::vector<unsigned char> cluster;       // buffered cluster
+
+}; // END class DedupSink()
+
+DedupSink::DedupSink(const char *store_dir, const char *path, bool resume, bool compress, unsigned int sector_number)
+    : Sink(constants::SECTOR_SIZE), manifest(-1), manifest_path(std::string(path) + ".manifest"),
+      sector_number(sector_number), cluster_index(0), written(0), cluster(dedup::CLUSTER_SIZE, 0) {
+  // Constructor that opens the store and creates the manifest.
+  //
+  // Args:
+  //     store_dir (const char *): store directory, created when missing
+  //     path (const char *): ISO path the manifest is named after
+  //     resume (bool): true when resuming, which stores cannot do
+  //     compress (bool): true when compressing, which stores cannot do
+  //     sector_number (unsigned int): number of disc sectors
+
+  if (strcmp(path, "-") == 0 || resume || compress) {
+    printf("dvdcc:dedup:DedupSink() Stored backups cannot be streamed, resumed or compressed.\n");
+    printf("dvdcc:dedup:DedupSink() Exiting...\n");
+    exit(0);
+  }
+
+  if (access(manifest_path.c_str(), F_OK) == 0) {
+    printf("dvdcc:dedup:DedupSink() File %s already exists. Delete it first.\n", manifest_path.c_str());
+    printf("dvdcc:dedup:DedupSink() Exiting...\n");
+    exit(0);
+  }
+
+  if (store.Open(store_dir, true) != 0) {
+    printf("dvdcc:dedup:DedupSink() Exiting...\n");
+    exit(0);
+  }
+
+  unsigned char header[dedup::HEADER_SIZE];
+  memcpy(header, dedup::MAGIC, 8);
+  chunks::Put32(header + 8, dedup::SECTORS_PER_CLUSTER);
+  chunks::Put32(header + 12, sector_number);
+
+  manifest = open(manifest_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (manifest < 0 || write(manifest, header, dedup::HEADER_SIZE) != dedup::HEADER_SIZE) {
+    printf("dvdcc:dedup:DedupSink() Cannot create manifest %s\n", manifest_path.c_str());
+    printf("dvdcc:dedup:DedupSink() Exiting...\n");
+    exit(0);
+  }
+
+  printf(" Manifest: %s (store %s, %llu clusters)\n", manifest_path.c_str(), store_dir, store.clusters);
+
+}; // END DedupSink::DedupSink()
+
+int DedupSink::Flush(void) {
+  // Add the buffered cluster to the store and write its manifest entry.
+  // A cluster without written sectors keeps its all zero entry.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (written == 0) return 0;
+
+  unsigned char digest[dedup::ENTRY_SIZE];
+  Sha1 sha1;
+  sha1.Update(cluster.data(), dedup::CLUSTER_SIZE);
+  sha1.Final(digest);
+
+  int status = store.Put(digest, cluster.data());
+  off_t offset = dedup::HEADER_SIZE + (off_t)cluster_index * dedup::ENTRY_SIZE;
+  if (status == 0 && pwrite(manifest, digest, dedup::ENTRY_SIZE, offset) != dedup::ENTRY_SIZE) status = -1;
+
+  memset(cluster.data(), 0, dedup::CLUSTER_SIZE);
+  written = 0;
+
+  return status;
+
+}; // END DedupSink::Flush()
+
+int DedupSink::Write(unsigned int sector, unsigned char *data) {
+  // Add a sector to its cluster, storing the previous cluster first.
+  //
+  // Args:
+  //     sector (unsigned int): sector number (sectors arrive in order)
+  //     data (unsigned char *): sector bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned int index = sector / dedup::SECTORS_PER_CLUSTER;
+
+  if (index != cluster_index) {
+    if (Flush() != 0) return -1;
+    cluster_index = index;
+  }
+
+  memcpy(cluster.data() + (sector % dedup::SECTORS_PER_CLUSTER) * sector_size, data, sector_size);
+  written++;
+
+  if ((sector + 1) % dedup::SECTORS_PER_CLUSTER == 0) return Flush();
+
+  return 0;
+
+}; // END DedupSink::Write()
+
+int DedupSink::Skip(unsigned int sector, unsigned int count) {
+  // Leave sectors unwritten. They stay zero in a cluster that also holds
+  // written sectors, and whole skipped clusters become holes.
+  //
+  // Args:
+  //     sector (unsigned int): first sector to skip
+  //     count (unsigned int): number of sectors
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (count == 0) return 0;
+
+  unsigned int last = (sector + count - 1) / dedup::SECTORS_PER_CLUSTER;
+
+  // the buffered cluster is complete once the skip leaves it
+  if (written && last != cluster_index && Flush() != 0) return -1;
+
+  cluster_index = last;
+
+  return 0;
+
+}; // END DedupSink::Skip()
+
+int DedupSink::Close(void) {
+  // Store the last cluster, size the manifest to cover every cluster of
+  // the disc and report how much of the image was already stored.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  int status = Flush();
+
+  unsigned int cluster_number = (sector_number + dedup::SECTORS_PER_CLUSTER - 1) / dedup::SECTORS_PER_CLUSTER;
+  off_t size = dedup::HEADER_SIZE + (off_t)cluster_number * dedup::ENTRY_SIZE;
+
+  if (ftruncate(manifest, size) != 0) status = -1;
+  if (store.Sync() != 0 || fsync(manifest) != 0) status = -1;
+  if (close(manifest) != 0) status = -1;
+
+  unsigned long long stored = store.added + store.shared;
+  printf("\n Store: %llu of %llu clusters added (%.1f MB written), %.1f%% already in %s\n",
+         store.added, stored, store.added * dedup::CLUSTER_SIZE / 1e6,
+         stored ? 100.0 * store.shared / stored : 0.0, store.dir.c_str());
+
+  return status;
+
+}; // END DedupSink::Close()
+
+#endif // DVDCC_DEDUP_H_
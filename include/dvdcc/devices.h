@@ -25,6 +25,8 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <linux/cdrom.h>
 
 #include <string>
@@ -32,9 +34,13 @@
 
 #include "dvdcc/cypher.h"
 #include "dvdcc/ecma_267.h"
+#include "dvdcc/keys.h"
 #include "dvdcc/progress.h"
 #include "dvdcc/commands.h"
 #include "dvdcc/constants.h"
+#include "dvdcc/metrics.h"
+#include "dvdcc/metadata.h"
+#include "dvdcc/layout.h"
 
 // Class for interfacing with a DVD drive.
 class Dvd {
@@ -52,29 +58,51 @@ class Dvd {
   int Eject(bool verbose);                                                 // eject the disc
   int PollReady(bool verbose);                                             // poll the drive ready state
   int PollPowerState(bool verbose);                                        // return the drive power state
+  int PollMedia(bool verbose);                                             // return whether a disc is present
+  void Reset(void);                                                        // forget the disc after a disc change
   int ClearSectorCache(int sector, bool verbose);                          // clear cached blocks of raw sectors
-  int ReadRawSectorCache(int sector, unsigned char *buffer, bool verbose); // read 5 blocks of raw sectors
+  int ReadRawSectorCache(int sector, unsigned char *buffer, bool verbose,
+                         request_sense *sense);                            // read 5 blocks of raw sectors
   int FindKeys(unsigned int blocks, bool verbose);                         // find the keys for decoding sectors
   int FindDiscType(bool verbose);                                          // find the disc type (standard, gamecube, wii, etc)
+  int SearchSectorNumber(unsigned int *sectors, bool verbose);             // binary search for the number of sectors
+  int ReadPhysicalFormat(unsigned int *sectors, bool verbose);             // read the number of sectors from the lead-in
   int DisplayMetaData(bool verbose);                                       // display disc metadata from the first sector
+  int SetSpeed(unsigned int speed, bool verbose);                          // set the read speed in kB/s
+  template <class Layout>
+  int ReadCacheBlock(unsigned int cache_start, unsigned char *buffer,
+                     unsigned int retries, bool verbose);                  // read, decode and verify a cache block
+  int ReadCapacity(unsigned int *sectors, bool verbose);                   // read the number of sectors reported by the drive
+  unsigned int MaxTransferSectors(void);                                   // largest sector count for a single READ(12)
 
   unsigned int RawSectorId(unsigned char *raw_sector);                     // return sector id number
   unsigned int RawSectorEdc(unsigned char *raw_sector);                    // return sector error detection code
   unsigned int CypherIndex(unsigned int block);                            // return cypher index for a block
+  template <class Layout>
+  unsigned int DecodeSectors(unsigned int first, unsigned int count,
+                             unsigned char *buffer);                       // descramble and verify raw sectors
 
   int fd;                           // file descriptor
   int timeout;                      // command timeout in seconds
   char model[36];                   // drive model string with vendor/prod_id/prod_rev
   unsigned int cypher_number;       // number of cypher keys
   unsigned int sector_number;       // number of disc sectors
+  unsigned int speed;               // requested read speed in kB/s (constants::MAX_SPEED = maximum)
   std::string disc_type;            // disc type
+  std::string disc_id;              // Gamecube/Wii disc ID with system, game, region and publisher
+  unsigned char disc_number;        // Gamecube/Wii disc number for multi disc titles
+  bool dvd_rom;                     // true for the DVD-ROM sector layout, false for Gamecube/Wii, see layout::Select()
 
   Cypher *cyphers[20];              // cyphers for decoding raw sectors
 
+  metrics::Device *counters;        // counters exported by --metrics
+
 }; // END class Dvd()
 
 Dvd::Dvd(const char *path, int timeout = 1, bool verbose = false)
-    : timeout(timeout), cypher_number(0), sector_number(0), disc_type("UNKOWN"), cyphers{} {
+    : timeout(timeout), cypher_number(0), sector_number(0), speed(constants::MAX_SPEED),
+      disc_type("UNKOWN"), disc_number(0), dvd_rom(false), cyphers{},
+      counters(metrics::Add(path)) {
   // Constructor that opens a connection to the DVD drive.
   //
   // Args:
@@ -165,7 +193,7 @@ int Dvd::Eject(bool verbose = false) {
 
 }; // END Dvd::Eject()
 
-int Dvd::ReadRawSectorCache(int sector, unsigned char *buffer, bool verbose = false) {
+int Dvd::ReadRawSectorCache(int sector, unsigned char *buffer, bool verbose = false, request_sense *sense = NULL) {
   // Read all raw sectors from the 80 sector cache.
   //
   // Args:
@@ -173,6 +201,7 @@ int Dvd::ReadRawSectorCache(int sector, unsigned char *buffer, bool verbose = fa
   //     buffer (unsigned char *): pointer to the buffer where bytes
   //                               returned by the command are placed
   //     verbose (bool): when true print command details (default: false)
+  //     sense (request_sense *): SCSI sense data of the failed command (default: NULL = not needed)
   //
   // Returns:
   //     (int): command status (-1 means fail)
@@ -185,7 +214,7 @@ int Dvd::ReadRawSectorCache(int sector, unsigned char *buffer, bool verbose = fa
 
   // perform a streaming read to fill the cache with 5 blocks / 80 sectors
   // starting from sector. Note: reading first sector to fills the full cache.
-  if (commands::ReadSectors(fd, buffer, sector, 1, true, timeout, verbose, NULL) != 0)
+  if (commands::ReadSectors(fd, buffer, sector, 1, true, timeout, verbose, sense) != 0)
     return -1;
 
   // clear the buffer contents
@@ -194,10 +223,12 @@ int Dvd::ReadRawSectorCache(int sector, unsigned char *buffer, bool verbose = fa
   // read the cache in steps to work around the 65535 byte cache read limit
   for (int i = 0; i < buflen; i += 65535) {
     int len = i + 65535 <= buflen ? 65535 : buflen - i;
-    if (commands::ReadRawBytes(fd, buffer + i, i, len, timeout, verbose, NULL) != 0)
+    if (commands::ReadRawBytes(fd, buffer + i, i, len, timeout, verbose, sense) != 0)
       return -1;
   }
 
+  counters->cache_fills.fetch_add(1, std::memory_order_relaxed);
+
   return 0;
 
 }; // END Dvd::ReadRawSectorCache()
@@ -224,22 +255,12 @@ unsigned int Dvd::RawSectorEdc(unsigned char *raw_sector) {
   // Returns:
   //     (unsigned int): error detection code
 
-  unsigned char *edc_bytes = raw_sector + constants::RAW_SECTOR_SIZE - 4;
-
-  return (edc_bytes[0] << 24) + (edc_bytes[1] << 16) + (edc_bytes[2] << 8) + edc_bytes[3];
+  return keys::StoredEdc(raw_sector);
 
 }; // END Dvd::RawSectorEdc()
 
 unsigned int Dvd::CypherIndex(unsigned int block) {
-  // Return the cypher array index for a sector block.
-  //
-  // Blocks >= 1 use a repeating sequence of cypher values
-  // from 1 to cypher_number. The first block beyond cypher_number
-  // loops back to 1 to restart the sequence.
-  //
-  // Block 0 uses a unique cypher to decode disc information.
-  // The cypher index for this block is handled as a separate
-  // return value because it is not part of the repeating sequence.
+  // Return the cypher array index for a sector block, see keys::CypherIndex().
   //
   // Args:
   //     block (unsigned int): block number
@@ -247,12 +268,36 @@ unsigned int Dvd::CypherIndex(unsigned int block) {
   // Returns:
   //     (unsigned int): cypher index
 
-  if (block)
-    return (block - 1) % (cypher_number - 1) + 1;
-  return 0;
+  return keys::CypherIndex(block, cypher_number);
 
 }; // END Dvd::CypherIndex()
 
+template <class Layout>
+unsigned int Dvd::DecodeSectors(unsigned int first, unsigned int count, unsigned char *buffer) {
+  // Descramble consecutive raw sectors in place and verify their EDC
+  // using the offsets of the sector layout of the disc. Keys must be
+  // found first.
+  //
+  // Args:
+  //     first (unsigned int): sector number of the first raw sector
+  //     count (unsigned int): number of sectors
+  //     buffer (unsigned char *): raw sectors, descrambled in place
+  //
+  // Returns:
+  //     (unsigned int): number of sectors that failed EDC
+
+  unsigned int failures = 0;
+
+  for (unsigned int n = 0; n < count; n++) {
+    unsigned char *raw_sector = buffer + n * constants::RAW_SECTOR_SIZE;
+    layout::Descramble<Layout>(cyphers[CypherIndex((first + n) / constants::SECTORS_PER_BLOCK)], raw_sector);
+    if (!layout::Verify<Layout>(raw_sector)) failures++;
+  }
+
+  return failures;
+
+}; // END Dvd::DecodeSectors()
+
 int Dvd::FindKeys(unsigned int blocks = 20, bool verbose = false) {
   // Find the cypher keys needed to decode raw sector data.
   // Should only need 20 blocks since there is usually one
@@ -271,7 +316,7 @@ int Dvd::FindKeys(unsigned int blocks = 20, bool verbose = false) {
   unsigned int raw_sector_id, raw_edc, tmp_edc;
   const unsigned int buflen = constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE;
   unsigned char buffer[buflen];
-  unsigned char *raw_sector, tmp[constants::RAW_SECTOR_SIZE];
+  unsigned char *raw_sector;
 
   bool found_all_cyphers = false; // set to true once we find all cyphers
 
@@ -297,30 +342,19 @@ int Dvd::FindKeys(unsigned int blocks = 20, bool verbose = false) {
 
       if (cypher == NULL) {
 
-        // loop through seeds to find the correct cypher
-        for (unsigned int seed = 0; seed < 0x7FFF; seed++) {
-	  // create a temporary copy of raw_sector
-          memcpy(tmp, raw_sector, constants::RAW_SECTOR_SIZE);
-          // try decoding
-          cypher = new Cypher(seed, constants::SECTOR_SIZE);
-	  cypher->Decode64(tmp, 12);
-	  // verify edc
-	  if (raw_edc == ecma_267::calculate(tmp, constants::RAW_SECTOR_SIZE - 4)) {
-            // repeated seed 1 means we found all cyphers
-            if (cyphers[1] && cyphers[1]->seed == cypher->seed)
-	      found_all_cyphers = true;
-	    else
-              printf(" * Block %02d found key 0x%04x\n", block, cypher->seed);
-	    // decode the raw_sector now that we have the correct cypher
-	    // Note: this could be removed, but I left it here in case
-	    // we decide to consolidate key finding with a full disc read.
-            cypher->Decode64(raw_sector, 12);
-            break;
-	  } else {
-	    delete cypher;
-	    cypher = NULL;
-	  } // END if/else (raw_edc == ...)
-        } // END for (seed)
+        // search the seeds for the cypher of this block
+        cypher = keys::FindCypher(raw_sector);
+        if (cypher != NULL) {
+          // repeated seed 1 means we found all cyphers
+          if (cyphers[1] && cyphers[1]->seed == cypher->seed)
+            found_all_cyphers = true;
+          else
+            printf(" * Block %02d found key 0x%04x\n", block, cypher->seed);
+          // decode the raw_sector now that we have the correct cypher
+          // Note: this could be removed, but I left it here in case
+          // we decide to consolidate key finding with a full disc read.
+          layout::Descramble<layout::Sector>(cypher, raw_sector);
+        } // END if (cypher != NULL)
 
         // throw and error if we couldn't find the cypher
         if (cypher == NULL) {
@@ -331,7 +365,7 @@ int Dvd::FindKeys(unsigned int blocks = 20, bool verbose = false) {
       } else {
 
 	// verify edc for remaining sectors in the block
-        cypher->Decode64(raw_sector, 12);
+        layout::Descramble<layout::Sector>(cypher, raw_sector);
         if (raw_edc != ecma_267::calculate(raw_sector, constants::RAW_SECTOR_SIZE - 4)) {
           printf("dvdcc:devices:Dvd::FindKeys() Failed to decode sector with seed %04x\n", cypher->seed);
 	  return -1;
@@ -359,6 +393,11 @@ int Dvd::FindKeys(unsigned int blocks = 20, bool verbose = false) {
 int Dvd::FindDiscType(bool verbose = false) {
   // Find the disc type and sector number for a disc.
   //
+  // The sector number is taken from READ CAPACITY or READ DISC STRUCTURE
+  // when the drive reports it, otherwise it is found with a binary search
+  // on sector validity. The result is then mapped to a disc type using the
+  // known Gamecube/Wii sizes in constants::sector_numbers.
+  //
   // Args:
   //     verbose (bool): when true print command details (default: false).
   //
@@ -366,33 +405,102 @@ int Dvd::FindDiscType(bool verbose = false) {
   //     (int): command status (0 = success, -1 = fail)
 
   unsigned char buffer[constants::SECTOR_SIZE];
-  struct request_sense sense;
+  bool exact = true; // false when the size is only known to within the lead-out margin
 
   printf("Finding Disc Type...\n\n");
 
-  // loop through known sector numbers / disc types
-  std::map<unsigned int, std::string>::iterator it;
-  for (it = constants::sector_numbers.begin(); it != constants::sector_numbers.end(); it++) {
-
-    // parse this iteration
-    sector_number = it->first;
-    disc_type = it->second;
+  // Gamecube/Wii sector layout unless the disc turns out to be a standard DVD
+  dvd_rom = false;
 
-    // test sense keys just beyond the sector number to verify type
-    memset(&sense, 0, sizeof(sense));
-    commands::ReadSectors(fd, buffer, sector_number + 100, 1, false, timeout, verbose, &sense);
+  if (ReadCapacity(&sector_number, verbose) != 0 &&
+      ReadPhysicalFormat(&sector_number, verbose) != 0) {
+    exact = false;
+    if (SearchSectorNumber(&sector_number, verbose) != 0) {
+      sector_number = 0;
+      disc_type = "UNKOWN";
+      return -1;
+    }
+  } // END if (ReadCapacity ...)
 
-    if (sense.sense_key == 0x05 && sense.asc == 0x21) {
+  // match known Gamecube/Wii sizes. Binary search stops at the first sector
+  // reported out of range, which can lie a little beyond the last sector.
+  std::map<unsigned int, std::string>::const_iterator it;
+  for (it = constants::sector_numbers.begin(); it != constants::sector_numbers.end(); it++) {
+    unsigned int margin = exact ? 0 : constants::LEAD_OUT_MARGIN;
+    if (sector_number >= it->first && sector_number <= it->first + margin) {
+      sector_number = it->first;
+      disc_type = it->second;
       printf("Found %s with %d sectors.\n\n", disc_type.c_str(), sector_number);
       return 0;
     }
-
   } // END for (it)
 
-  return -1;
+  // standard DVDs can be read directly while Gamecube/Wii discs cannot
+  if (commands::ReadSectors(fd, buffer, 0, 1, false, timeout, verbose, NULL) == 0) {
+    disc_type = "DVD";
+    dvd_rom = true;
+  } else {
+    // non-standard Gamecube/Wii size (e.g. overburned), so use the
+    // largest known type that fits within the sector number
+    disc_type = constants::sector_numbers.begin()->second;
+    for (it = constants::sector_numbers.begin(); it != constants::sector_numbers.end(); it++)
+      if (it->first <= sector_number) disc_type = it->second;
+  }
+
+  printf("Found %s with %d sectors.\n\n", disc_type.c_str(), sector_number);
+
+  return 0;
 
 }; // END Dvd::FindDiscType()
 
+int Dvd::SearchSectorNumber(unsigned int *sectors, bool verbose = false) {
+  // Find the number of disc sectors with a binary search for the first
+  // sector that the drive reports as out of range (sense 05/21). Each
+  // step halves the range, so only ~23 reads are needed for any size.
+  //
+  // Args:
+  //     sectors (unsigned int *): returns the number of sectors
+  //     verbose (bool): when true print command details (default: false)
+  //
+  // Returns:
+  //     (int): command status (0 = success, -1 = fail)
+
+  unsigned char buffer[constants::SECTOR_SIZE];
+  struct request_sense sense;
+
+  // sector 0 is always valid, upper limit is beyond any dual layer disc
+  unsigned int valid = 0, invalid = constants::MAX_SECTOR_NUMBER;
+
+  // make sure the upper limit is out of range
+  memset(&sense, 0, sizeof(sense));
+  commands::ReadSectors(fd, buffer, invalid, 1, false, timeout, verbose, &sense);
+  if (!(sense.sense_key == 0x05 && sense.asc == 0x21))
+    return -1;
+
+  while (invalid - valid > 1) {
+
+    unsigned int sector = valid + (invalid - valid) / 2;
+
+    memset(&sense, 0, sizeof(sense));
+    commands::ReadSectors(fd, buffer, sector, 1, false, timeout, verbose, &sense);
+
+    // read errors other than out of range still mean the sector exists
+    if (sense.sense_key == 0x05 && sense.asc == 0x21)
+      invalid = sector;
+    else
+      valid = sector;
+
+  } // END while (invalid - valid > 1)
+
+  if (verbose)
+    printf("dvdcc:devices:Dvd:SearchSectorNumber() First out of range sector %u\n", invalid);
+
+  *sectors = invalid;
+
+  return 0;
+
+}; // END Dvd::SearchSectorNumber()
+
 int Dvd::DisplayMetaData(bool verbose = false) {
   // Display disc metadata on-screen
   //
@@ -424,55 +532,26 @@ int Dvd::DisplayMetaData(bool verbose = false) {
     if (status != 0) return status;
 
     // decode the first sector
-    cyphers[0]->Decode64(buffer, 12);
-
-    // point to the start of usable data following the 6 sector ID/IED bytes
-    unsigned char *data = buffer + 6;
-
-    char *system_id    = strndup((char *)&data[0], 1);
-    char *game_id      = strndup((char *)&data[1], 2);
-    char *region_id    = strndup((char *)&data[3], 1);
-    char *publisher_id = strndup((char *)&data[4], 2);
-
-    // full system name
-    std::string system = "UNKNOWN";
-    if (auto search = constants::systems.find(system_id); search != constants::systems.end())
-      system = search->second;
-
-    // full region name
-    std::string region = "UNKNOWN";
-    if (auto search = constants::regions.find(region_id); search != constants::regions.end())
-      region = search->second;
-
-    // full publisher name
-    std::string publisher = "UNKNOWN";
-    if (auto search = constants::publishers.find(publisher_id); search != constants::publishers.end())
-      publisher = search->second;
-
-    // title without additional whitespace
-    char *title        = strndup((char *)&data[0x20], 64);
-    for (int i = 63; i >= 0 && title[i] == ' '; i--)
-      title[i] = '\0';
-
-    printf("System ID..........: %s (%s)\n", system_id, system.c_str());
-    printf("Game ID............: %s\n", game_id);
-    printf("Region.............: %s (%s)\n", region_id, region.c_str());
-    printf("Publisher..........: %s (%s)\n", publisher_id, publisher.c_str());
-    printf("Version............: 1.%02u\n", data[7]);
-    printf("Game title.........: %s\n", title);
+    layout::Descramble<layout::GameDisc>(cyphers[0], buffer);
+
+    // keep the header following the 6 sector ID/IED bytes
+    unsigned char data[metadata::HEADER_BYTES];
+    memcpy(data, layout::Payload<layout::GameDisc>(buffer), metadata::HEADER_BYTES);
 
     // check for additional update information found in sector 160 of Wii discs
-    status = ReadRawSectorCache(160, buffer, verbose);
+    status = ReadRawSectorCache(metadata::UPDATE_SECTOR, buffer, verbose);
     // decode the sector
-    cyphers[CypherIndex(160 / constants::SECTORS_PER_BLOCK)]->Decode64(buffer, 12);
-    // point to the start of usable data following the 6 sector ID/IED bytes
-    data = buffer + 6;
-    // compute the update key value
-    unsigned int update_key = (data[4] << 24) + (data[5] << 16) + (data[6] << 8) + data[7];
-    // check the update key value
-    bool has_update = (update_key != 0xA5BED6AE) && (disc_type == "WII_SINGLE_LAYER" || disc_type == "WII_DUAL_LAYER");
+    layout::Descramble<layout::GameDisc>(cyphers[CypherIndex(metadata::UPDATE_SECTOR / constants::SECTORS_PER_BLOCK)], buffer);
+
+    bool wii = disc_type == "WII_SINGLE_LAYER" || disc_type == "WII_DUAL_LAYER";
+    metadata::Header header;
+    metadata::Parse(data, layout::Payload<layout::GameDisc>(buffer), wii, &header);
+
+    // keep the disc ID and number for naming backups and regenerating junk
+    disc_id = header.disc_id;
+    disc_number = header.disc_number;
 
-    printf("Contains update....: %s (0x%08x)\n\n", has_update ? "Yes" : "No", update_key);
+    metadata::Print(header);
 
     return status;
 
@@ -502,6 +581,9 @@ int Dvd::ClearSectorCache(int sector, bool verbose = false) {
 
   unsigned char buffer[constants::SECTOR_SIZE * constants::SECTORS_PER_CACHE];
 
+  // the cache is only cleared to read sectors again
+  counters->retries.fetch_add(1, std::memory_order_relaxed);
+
   return commands::ReadSectors(fd, buffer, adjacent_block * constants::SECTORS_PER_CACHE, constants::SECTORS_PER_CACHE, true, timeout, verbose, NULL);
 
 }; // END Dvd::ClearSectorCache()
@@ -529,6 +611,48 @@ int Dvd::PollPowerState(bool verbose = false) {
 
 }; // END Dvd::PollPowerState()
 
+int Dvd::PollMedia(bool verbose = false) {
+  // Get the media status from a media event notification.
+  //
+  // Args:
+  //     verbose (bool): when true print command details (default: false)
+  //
+  // Returns:
+  //     (int): media status (1 = disc present, 0 = no disc or tray open, -1 = fail)
+
+  const int buflen = 8;
+  unsigned char buffer[buflen];
+
+  bool poll = true;
+
+  int status = commands::GetEventStatus(fd, buffer, constants::EventType::kMedia, poll, buflen, timeout, verbose, NULL);
+
+  if (status < 0)
+    return status;
+
+  // media status byte: bit 0 = tray open, bit 1 = media present
+  return (buffer[5] & 0x03) == 0x02 ? 1 : 0;
+
+}; // END Dvd::PollMedia()
+
+void Dvd::Reset(void) {
+  // Forget the keys, size and ID of the last disc so the next disc in
+  // the drive is identified from scratch.
+
+  for (unsigned int i = 0; i < cypher_number; i++) {
+    delete cyphers[i];
+    cyphers[i] = NULL;
+  }
+
+  cypher_number = 0;
+  sector_number = 0;
+  disc_type = "UNKOWN";
+  disc_id.clear();
+  disc_number = 0;
+  dvd_rom = false;
+
+}; // END Dvd::Reset()
+
 int Dvd::PollReady(bool verbose = false) {
   // Get the test unit ready status.
   //
@@ -542,4 +666,169 @@ int Dvd::PollReady(bool verbose = false) {
 
 }; // END Dvd::PollReady()
 
+int Dvd::SetSpeed(unsigned int speed, bool verbose = false) {
+  // Set the drive read speed. SET STREAMING is tried first since it is the
+  // preferred method for DVD drives, followed by SET CD SPEED for drives
+  // that only support the legacy command.
+  //
+  // Args:
+  //     speed (unsigned int): read speed in kB/s (constants::MAX_SPEED = maximum)
+  //     verbose (bool): when true print command details (default: false)
+  //
+  // Returns:
+  //     (int): command status (0 = success, -1 = fail)
+
+  if (verbose)
+    printf("dvdcc:devices:Dvd:SetSpeed() Setting read speed to %u kB/s.\n", speed);
+
+  unsigned int end_sector = sector_number ? sector_number - 1 : 0x7FFFFFFF;
+
+  int status = -1;
+  if (speed != constants::MAX_SPEED)
+    status = commands::SetStreaming(fd, 0, end_sector, speed, timeout, verbose, NULL);
+  if (status != 0)
+    status = commands::SetCdSpeed(fd, speed, timeout, verbose, NULL);
+
+  if (status == 0)
+    this->speed = speed;
+
+  return status;
+
+}; // END Dvd::SetSpeed()
+
+template <class Layout>
+int Dvd::ReadCacheBlock(unsigned int cache_start, unsigned char *buffer, unsigned int retries, bool verbose) {
+  // Read a cache block of raw sectors, decode them and verify their EDC,
+  // clearing the cache and retrying the block while any sector fails.
+  // Keys must be found with FindKeys() first.
+  //
+  // Args:
+  //     cache_start (unsigned int): first sector of the cache block
+  //     buffer (unsigned char *): buffer for SECTORS_PER_CACHE raw sectors
+  //     retries (unsigned int): maximum number of reads
+  //     verbose (bool): when true print command details
+  //
+  // Returns:
+  //     (int): command status (0 = success, -1 = fail)
+
+  for (unsigned int retry = 0; retry < retries; retry++) {
+
+    if (retry) {
+      ClearSectorCache(cache_start, verbose);
+      trace::Sleep(1);
+    }
+
+    if (ReadRawSectorCache(cache_start, buffer, verbose) != 0)
+      continue;
+
+    unsigned int count = constants::SECTORS_PER_CACHE;
+    if (cache_start + count > sector_number) count = sector_number > cache_start ? sector_number - cache_start : 0;
+
+    unsigned int failures = DecodeSectors<Layout>(cache_start, count, buffer);
+    if (failures == 0) return 0;
+
+    counters->edc_failures.fetch_add(failures, std::memory_order_relaxed);
+
+  } // END for (retry)
+
+  return -1;
+
+}; // END Dvd::ReadCacheBlock()
+
+int Dvd::ReadCapacity(unsigned int *sectors, bool verbose = false) {
+  // Read the number of disc sectors reported by the drive.
+  //
+  // Args:
+  //     sectors (unsigned int *): returns the number of sectors
+  //     verbose (bool): when true print command details (default: false)
+  //
+  // Returns:
+  //     (int): command status (0 = success, -1 = fail)
+
+  unsigned int last_sector, block_size;
+
+  int status = commands::ReadCapacity(fd, &last_sector, &block_size, timeout, verbose, NULL);
+
+  if (status != 0 || block_size != constants::SECTOR_SIZE || last_sector == 0)
+    return -1;
+
+  *sectors = last_sector + 1;
+
+  return 0;
+
+}; // END Dvd::ReadCapacity()
+
+int Dvd::ReadPhysicalFormat(unsigned int *sectors, bool verbose = false) {
+  // Read the number of disc sectors from the physical format information
+  // recorded in the lead-in, returned by READ DISC STRUCTURE format 0x00.
+  //
+  // Args:
+  //     sectors (unsigned int *): returns the number of sectors
+  //     verbose (bool): when true print command details (default: false)
+  //
+  // Returns:
+  //     (int): command status (0 = success, -1 = fail)
+
+  const int buflen = 4 + constants::SECTOR_SIZE;
+  unsigned char buffer[buflen];
+
+  memset(buffer, 0, buflen);
+
+  if (commands::ReadDiscStructure(fd, buffer, buflen, 0, 0x00, timeout, verbose, NULL) != 0)
+    return -1;
+
+  // skip the 4 byte header
+  unsigned char *info = buffer + 4;
+
+  unsigned int layers   = ((info[2] >> 5) & 0x03) + 1;
+  bool opposite_path    = (info[2] >> 4) & 0x01;
+  unsigned int start    = (info[5] << 16) + (info[6] << 8) + info[7];
+  unsigned int end      = (info[9] << 16) + (info[10] << 8) + info[11];
+  unsigned int end_l0   = (info[13] << 16) + (info[14] << 8) + info[15];
+
+  if (start == 0 || end < start)
+    return -1;
+
+  // opposite track path layer 1 addresses are the complement of layer 0
+  if (layers == 2 && opposite_path)
+    *sectors = (end_l0 - start + 1) + (end - (~end_l0 & 0xFFFFFF) + 1);
+  else
+    *sectors = end - start + 1;
+
+  return 0;
+
+}; // END Dvd::ReadPhysicalFormat()
+
+unsigned int Dvd::MaxTransferSectors(void) {
+  // Return the largest number of sectors the transport accepts in a
+  // single READ(12) command. The limit is taken from the kernel block
+  // queue and rounded down to whole blocks of 16 sectors. Traces keep
+  // the limit so replays send the same commands on any host.
+  //
+  // Returns:
+  //     (unsigned int): number of sectors per transfer
+
+  unsigned int sectors = 2 * constants::SECTORS_PER_BLOCK; // conservative 64 kB default
+  const unsigned int max_sectors = 32 * constants::SECTORS_PER_BLOCK;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode))
+    return trace::Value(sectors);
+
+  char path[128];
+  sprintf(path, "/sys/dev/block/%u:%u/queue/max_sectors_kb", major(st.st_rdev), minor(st.st_rdev));
+
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL)
+    return trace::Value(sectors);
+
+  unsigned int kb;
+  if (fscanf(fp, "%u", &kb) == 1 && kb * 1024 / constants::SECTOR_SIZE >= constants::SECTORS_PER_BLOCK)
+    sectors = kb * 1024 / constants::SECTOR_SIZE / constants::SECTORS_PER_BLOCK * constants::SECTORS_PER_BLOCK;
+  fclose(fp);
+
+  return trace::Value(sectors < max_sectors ? sectors : max_sectors);
+
+}; // END Dvd::MaxTransferSectors()
+
 #endif // DVDCC_DEVICES_H_
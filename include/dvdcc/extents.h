@@ -0,0 +1,268 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_EXTENTS_H_
+#define DVDCC_EXTENTS_H_
+
+#include <stdio.h>
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/devices.h"
+#include "dvdcc/reader.h"
+
+// Class for tracking the sectors of a disc that hold data.
+// Byte ranges are added as they are found and then rounded out to
+// whole cache blocks, since that is the unit read from the drive.
+class ExtentMap {
+
+ public:
+  ExtentMap() : sectors_per_extent(constants::SECTORS_PER_CACHE) {};
+
+  void Add(unsigned long long offset, unsigned long long size);  // add a used byte range
+  void Finalize(unsigned int sector_number);                      // round to cache blocks and merge
+  bool Contains(unsigned int sector);                             // true when a sector is used
+  unsigned int UsedSectors(void);                                 // number of used sectors
+
+  unsigned int sectors_per_extent;                                // rounding granularity in sectors
+  std::vector<std::pair<unsigned int, unsigned int>> extents;     // [first, last) sector ranges
+
+}; // END class ExtentMap()
+
+void ExtentMap::Add(unsigned long long offset, unsigned long long size) {
+  // Add a used byte range.
+  //
+  // Args:
+  //     offset (unsigned long long): disc byte offset
+  //     size (unsigned long long): number of bytes
+
+  if (size == 0) return;
+
+  unsigned int first = offset / constants::SECTOR_SIZE;
+  unsigned int last = (offset + size + constants::SECTOR_SIZE - 1) / constants::SECTOR_SIZE;
+
+  extents.push_back(std::make_pair(first, last));
+
+}; // END ExtentMap::Add()
+
+void ExtentMap::Finalize(unsigned int sector_number) {
+  // Round extents out to cache blocks, clip to the disc and merge overlaps.
+  //
+  // Args:
+  //     sector_number (unsigned int): number of disc sectors
+
+  for (unsigned int i = 0; i < extents.size(); i++) {
+    extents[i].first = extents[i].first / sectors_per_extent * sectors_per_extent;
+    extents[i].second = (extents[i].second + sectors_per_extent - 1) / sectors_per_extent * sectors_per_extent;
+    if (extents[i].second > sector_number) extents[i].second = sector_number;
+  }
+
+  std::sort(extents.begin(), extents.end());
+
+  std::vector<std::pair<unsigned int, unsigned int>> merged;
+  for (unsigned int i = 0; i < extents.size(); i++) {
+    if (extents[i].first >= extents[i].second) continue;
+    if (!merged.empty() && extents[i].first <= merged.back().second)
+      merged.back().second = std::max(merged.back().second, extents[i].second);
+    else
+      merged.push_back(extents[i]);
+  }
+
+  extents.swap(merged);
+
+}; // END ExtentMap::Finalize()
+
+bool ExtentMap::Contains(unsigned int sector) {
+  // Check whether a sector is used.
+  //
+  // Args:
+  //     sector (unsigned int): sector number
+  //
+  // Returns:
+  //     (bool): true when the sector lies within an extent
+
+  auto it = std::upper_bound(extents.begin(), extents.end(), std::make_pair(sector, 0xFFFFFFFFu));
+  if (it == extents.begin()) return false;
+  --it;
+
+  return sector >= it->first && sector < it->second;
+
+}; // END ExtentMap::Contains()
+
+unsigned int ExtentMap::UsedSectors(void) {
+  // Return the number of used sectors.
+  //
+  // Returns:
+  //     (unsigned int): sectors within extents
+
+  unsigned int total = 0;
+  for (unsigned int i = 0; i < extents.size(); i++)
+    total += extents[i].second - extents[i].first;
+
+  return total;
+
+}; // END ExtentMap::UsedSectors()
+
+namespace extents {
+
+unsigned int Get32(const unsigned char *p) {
+  return (p[0] << 24) + (p[1] << 16) + (p[2] << 8) + p[3];
+}
+
+int AddGamecube(DiscReader<layout::GameDisc> &reader, unsigned char *header, ExtentMap *map) {
+  // Add the boot files, main executable, file system table (FST) and every
+  // file listed in the FST of a Gamecube disc.
+  //
+  // Args:
+  //     reader (DiscReader<layout::GameDisc> &): reader of a drive with keys found
+  //     header (unsigned char *): first 0x440 bytes of the disc
+  //     map (ExtentMap *): map receiving the used extents
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char apploader[0x20], dol[0x100];
+
+  unsigned int dol_offset = Get32(header + 0x420);
+  unsigned int fst_offset = Get32(header + 0x424);
+  unsigned int fst_size   = Get32(header + 0x428);
+
+  // disc header, debug info and apploader
+  if (reader.ReadBytes(0x2440, apploader, 0x20) != 0) return -1;
+  map->Add(0, 0x2440 + 0x20 + Get32(apploader + 0x14) + Get32(apploader + 0x18));
+
+  // main executable spans to the end of its farthest text/data section
+  if (reader.ReadBytes(dol_offset, dol, 0x100) != 0) return -1;
+  unsigned int dol_size = 0x100;
+  for (int i = 0; i < 18; i++) {
+    unsigned int end = Get32(dol + 4 * i) + Get32(dol + 0x90 + 4 * i);
+    if (end > dol_size) dol_size = end;
+  }
+  map->Add(dol_offset, dol_size);
+
+  // file system table and its files
+  std::vector<unsigned char> fst(fst_size);
+  if (fst_size < 12 || reader.ReadBytes(fst_offset, fst.data(), fst_size) != 0) return -1;
+  map->Add(fst_offset, fst_size);
+
+  unsigned int entries = Get32(fst.data() + 8);
+  if ((unsigned long long)entries * 12 > fst_size) return -1;
+
+  for (unsigned int i = 1; i < entries; i++) {
+    unsigned char *entry = fst.data() + 12 * i;
+    if (entry[0] == 0) map->Add(Get32(entry + 4), Get32(entry + 8));
+  }
+
+  if (reader.verbose)
+    printf("dvdcc:extents:AddGamecube() Found %u FST entries\n", entries);
+
+  return 0;
+
+}; // END extents::AddGamecube()
+
+int AddWii(DiscReader<layout::GameDisc> &reader, ExtentMap *map) {
+  // Add the disc header, partition tables and the full extent of every
+  // partition of a Wii disc. Partition contents are encrypted, so each
+  // partition is kept whole from its header to the end of its data.
+  //
+  // Args:
+  //     reader (DiscReader<layout::GameDisc> &): reader of a drive with keys found
+  //     map (ExtentMap *): map receiving the used extents
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char tables[0x20], info[0x100], partition[0x2C0];
+
+  // disc header, partition tables and region settings
+  map->Add(0, 0x50000);
+
+  // four partition tables of (count, offset >> 2)
+  if (reader.ReadBytes(0x40000, tables, 0x20) != 0) return -1;
+
+  for (int t = 0; t < 4; t++) {
+
+    unsigned int count = Get32(tables + 8 * t);
+    unsigned long long table_offset = (unsigned long long)Get32(tables + 8 * t + 4) << 2;
+
+    if (count == 0) continue;
+    if (count > 0x20) return -1;
+    if (reader.ReadBytes(table_offset, info, 8 * count) != 0) return -1;
+
+    for (unsigned int p = 0; p < count; p++) {
+
+      unsigned long long offset = (unsigned long long)Get32(info + 8 * p) << 2;
+      if (reader.ReadBytes(offset, partition, 0x2C0) != 0) return -1;
+
+      unsigned long long data_offset = (unsigned long long)Get32(partition + 0x2B8) << 2;
+      unsigned long long data_size   = (unsigned long long)Get32(partition + 0x2BC) << 2;
+
+      map->Add(offset, data_offset + data_size);
+
+      if (reader.verbose)
+        printf("dvdcc:extents:AddWii() Partition at 0x%llx with 0x%llx data bytes\n", offset, data_size);
+
+    } // END for (p)
+
+  } // END for (t)
+
+  return 0;
+
+}; // END extents::AddWii()
+
+int FindUsed(Dvd &dvd, ExtentMap *map, bool verbose) {
+  // Build the map of used sectors for a Gamecube or Wii disc. Only these
+  // discs have a file system to walk, so the reader uses their layout.
+  //
+  // Args:
+  //     dvd (Dvd &): drive with keys found
+  //     map (ExtentMap *): map receiving the used extents
+  //     verbose (bool): when true print command details
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char header[0x440];
+
+  // metadata is scattered, so blocks are cached without reading ahead
+  DiscReader<layout::GameDisc> reader(&dvd, 32, 0, verbose);
+
+  if (reader.ReadBytes(0, header, 0x440) != 0)
+    return -1;
+
+  int status;
+  if (Get32(header + 0x18) == 0x5D1C9EA3)
+    status = AddWii(reader, map);
+  else if (Get32(header + 0x1C) == 0xC2339F3D)
+    status = AddGamecube(reader, header, map);
+  else
+    status = -1;
+
+  if (status != 0)
+    return status;
+
+  map->Finalize(dvd.sector_number);
+
+  return 0;
+
+}; // END extents::FindUsed()
+
+} // namespace extents
+
+#endif // DVDCC_EXTENTS_H_
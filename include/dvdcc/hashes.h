@@ -0,0 +1,658 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_HASHES_H_
+#define DVDCC_HASHES_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <zlib.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/sinks.h"
+#include "dvdcc/chunks.h"
+#include "dvdcc/junk.h"
+
+// Class for the MD5 message digest (RFC 1321).
+class Md5 {
+
+ public:
+  Md5() { Reset(); };
+
+  void Reset(void);                                     // start a new digest
+  void Update(const unsigned char *data, size_t size);  // add message bytes
+  void Final(unsigned char *digest);                    // 16 byte digest
+  void Transform(const unsigned char *block);           // process one 64 byte block
+
+  static const unsigned int STATE_SIZE = 88;            // bytes used by Save()/Load()
+  void Save(unsigned char *state);                      // serialize the running state
+  void Load(const unsigned char *state);                // restore the running state
+
+  unsigned int h[4];                                    // chaining values
+  unsigned long long length;                            // message length in bytes
+  unsigned char buffer[64];                             // partial block
+
+}; // END class Md5()
+
+void Md5::Reset(void) {
+  // Start a new digest.
+
+  h[0] = 0x67452301; h[1] = 0xEFCDAB89; h[2] = 0x98BADCFE; h[3] = 0x10325476;
+  length = 0;
+
+}; // END Md5::Reset()
+
+void Md5::Transform(const unsigned char *block) {
+  // Process one 64 byte block.
+  //
+  // Args:
+  //     block (const unsigned char *): message block
+
+  static const unsigned int k[64] = {
+    0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE, 0xF57C0FAF, 0x4787C62A, 0xA8304613, 0xFD469501,
+    0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE, 0x6B901122, 0xFD987193, 0xA679438E, 0x49B40821,
+    0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA, 0xD62F105D, 0x02441453, 0xD8A1E681, 0xE7D3FBC8,
+    0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED, 0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A,
+    0xFFFA3942, 0x8771F681, 0x6D9D6122, 0xFDE5380C, 0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70,
+    0x289B7EC6, 0xEAA127FA, 0xD4EF3085, 0x04881D05, 0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665,
+    0xF4292244, 0x432AFF97, 0xAB9423A7, 0xFC93A039, 0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+    0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1, 0xF7537E82, 0xBD3AF235, 0x2AD7D2BB, 0xEB86D391};
+  static const unsigned int r[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21};
+
+  unsigned int m[16];
+  for (int i = 0; i < 16; i++)
+    m[i] = block[4 * i] + (block[4 * i + 1] << 8) + (block[4 * i + 2] << 16) + ((unsigned int)block[4 * i + 3] << 24);
+
+  unsigned int a = h[0], b = h[1], c = h[2], d = h[3];
+
+  for (int i = 0; i < 64; i++) {
+    unsigned int f, g;
+    if (i < 16)      { f = (b & c) | (~b & d); g = i; }
+    else if (i < 32) { f = (d & b) | (~d & c); g = (5 * i + 1) % 16; }
+    else if (i < 48) { f = b ^ c ^ d;          g = (3 * i + 5) % 16; }
+    else             { f = c ^ (b | ~d);       g = (7 * i) % 16; }
+    unsigned int t = a + f + k[i] + m[g];
+    a = d; d = c; c = b;
+    b = b + ((t << r[i]) | (t >> (32 - r[i])));
+  } // END for (i)
+
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+
+}; // END Md5::Transform()
+
+void Md5::Update(const unsigned char *data, size_t size) {
+  // Add message bytes.
+  //
+  // Args:
+  //     data (const unsigned char *): message bytes
+  //     size (size_t): number of bytes
+
+  unsigned int used = length % 64;
+  length += size;
+
+  if (used) {
+    size_t n = size < 64 - used ? size : 64 - used;
+    memcpy(buffer + used, data, n);
+    data += n; size -= n;
+    if (used + n < 64) return;
+    Transform(buffer);
+  }
+
+  for (; size >= 64; data += 64, size -= 64)
+    Transform(data);
+
+  memcpy(buffer, data, size);
+
+}; // END Md5::Update()
+
+void Md5::Final(unsigned char *digest) {
+  // Pad the message and return the digest.
+  //
+  // Args:
+  //     digest (unsigned char *): buffer for the 16 byte digest
+
+  unsigned char pad[72] = {0x80}, bits[8];
+  unsigned long long total = length * 8;
+
+  for (int i = 0; i < 8; i++) bits[i] = total >> (8 * i);
+
+  Update(pad, 1 + (119 - length % 64) % 64);
+  Update(bits, 8);
+
+  for (int i = 0; i < 16; i++) digest[i] = h[i / 4] >> (8 * (i % 4));
+
+}; // END Md5::Final()
+
+void Md5::Save(unsigned char *state) {
+  // Serialize the running state.
+  //
+  // Args:
+  //     state (unsigned char *): buffer for STATE_SIZE bytes
+
+  for (int i = 0; i < 4; i++) chunks::Put32(state + 4 * i, h[i]);
+  chunks::Put64(state + 16, length);
+  memcpy(state + 24, buffer, 64);
+
+}; // END Md5::Save()
+
+void Md5::Load(const unsigned char *state) {
+  // Restore the running state.
+  //
+  // Args:
+  //     state (const unsigned char *): STATE_SIZE bytes from Save()
+
+  for (int i = 0; i < 4; i++) h[i] = chunks::Get32(state + 4 * i);
+  length = chunks::Get64(state + 16);
+  memcpy(buffer, state + 24, 64);
+
+}; // END Md5::Load()
+
+// Class for the SHA-1 message digest (FIPS 180-4).
+class Sha1 {
+
+ public:
+  Sha1() { Reset(); };
+
+  void Reset(void);                                     // start a new digest
+  void Update(const unsigned char *data, size_t size);  // add message bytes
+  void Final(unsigned char *digest);                    // 20 byte digest
+  void Transform(const unsigned char *block);           // process one 64 byte block
+
+  static const unsigned int STATE_SIZE = 92;            // bytes used by Save()/Load()
+  void Save(unsigned char *state);                      // serialize the running state
+  void Load(const unsigned char *state);                // restore the running state
+
+  unsigned int h[5];                                    // chaining values
+  unsigned long long length;                            // message length in bytes
+  unsigned char buffer[64];                             // partial block
+
+}; // END class Sha1()
+
+void Sha1::Reset(void) {
+  // Start a new digest.
+
+  h[0] = 0x67452301; h[1] = 0xEFCDAB89; h[2] = 0x98BADCFE; h[3] = 0x10325476; h[4] = 0xC3D2E1F0;
+  length = 0;
+
+}; // END Sha1::Reset()
+
+void Sha1::Transform(const unsigned char *block) {
+  // Process one 64 byte block.
+  //
+  // Args:
+  //     block (const unsigned char *): message block
+
+  unsigned int w[80];
+  for (int i = 0; i < 16; i++)
+    w[i] = ((unsigned int)block[4 * i] << 24) + (block[4 * i + 1] << 16) + (block[4 * i + 2] << 8) + block[4 * i + 3];
+  for (int i = 16; i < 80; i++) {
+    unsigned int t = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+    w[i] = (t << 1) | (t >> 31);
+  }
+
+  unsigned int a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+  for (int i = 0; i < 80; i++) {
+    unsigned int f, k;
+    if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+    else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+    else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+    else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+    unsigned int t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+    e = d; d = c; c = (b << 30) | (b >> 2); b = a; a = t;
+  } // END for (i)
+
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+
+}; // END Sha1::Transform()
+
+void Sha1::Update(const unsigned char *data, size_t size) {
+  // Add message bytes.
+  //
+  // Args:
+  //     data (const unsigned char *): message bytes
+  //     size (size_t): number of bytes
+
+  unsigned int used = length % 64;
+  length += size;
+
+  if (used) {
+    size_t n = size < 64 - used ? size : 64 - used;
+    memcpy(buffer + used, data, n);
+    data += n; size -= n;
+    if (used + n < 64) return;
+    Transform(buffer);
+  }
+
+  for (; size >= 64; data += 64, size -= 64)
+    Transform(data);
+
+  memcpy(buffer, data, size);
+
+}; // END Sha1::Update()
+
+void Sha1::Final(unsigned char *digest) {
+  // Pad the message and return the digest.
+  //
+  // Args:
+  //     digest (unsigned char *): buffer for the 20 byte digest
+
+  unsigned char pad[72] = {0x80}, bits[8];
+  unsigned long long total = length * 8;
+
+  for (int i = 0; i < 8; i++) bits[i] = total >> (56 - 8 * i);
+
+  Update(pad, 1 + (119 - length % 64) % 64);
+  Update(bits, 8);
+
+  for (int i = 0; i < 20; i++) digest[i] = h[i / 4] >> (24 - 8 * (i % 4));
+
+}; // END Sha1::Final()
+
+void Sha1::Save(unsigned char *state) {
+  // Serialize the running state.
+  //
+  // Args:
+  //     state (unsigned char *): buffer for STATE_SIZE bytes
+
+  for (int i = 0; i < 5; i++) chunks::Put32(state + 4 * i, h[i]);
+  chunks::Put64(state + 20, length);
+  memcpy(state + 28, buffer, 64);
+
+}; // END Sha1::Save()
+
+void Sha1::Load(const unsigned char *state) {
+  // Restore the running state.
+  //
+  // Args:
+  //     state (const unsigned char *): STATE_SIZE bytes from Save()
+
+  for (int i = 0; i < 5; i++) h[i] = chunks::Get32(state + 4 * i);
+  length = chunks::Get64(state + 20);
+  memcpy(buffer, state + 28, 64);
+
+}; // END Sha1::Load()
+
+namespace hashes {
+
+// Hash state checkpoint format
+//
+//   0   8 bytes  magic "DVDCCH01"
+//   8   8 bytes  number of bytes hashed
+//  16   4 bytes  CRC32
+//  20  88 bytes  MD5 state
+// 108  92 bytes  SHA-1 state
+//
+// All integers are little endian. The checkpoint is replaced atomically
+// so an interrupted backup always leaves a complete one behind.
+const char MAGIC[8] = {'D', 'V', 'D', 'C', 'C', 'H', '0', '1'};
+const unsigned int STATE_SIZE = 20 + Md5::STATE_SIZE + Sha1::STATE_SIZE;
+
+// bytes hashed between checkpoints
+const unsigned long long CHECKPOINT_BYTES = 16 * 1024 * 1024;
+
+void Hex(const unsigned char *digest, unsigned int size, char *text) {
+  // Format a digest as lower case hex.
+  //
+  // Args:
+  //     digest (const unsigned char *): digest bytes
+  //     size (unsigned int): number of digest bytes
+  //     text (char *): buffer for 2 * size + 1 characters
+
+  for (unsigned int i = 0; i < size; i++)
+    sprintf(text + 2 * i, "%02x", digest[i]);
+
+}; // END hashes::Hex()
+
+} // namespace hashes
+
+// Class for hashing a backup output as it is written. Sectors are passed
+// through to the wrapped output and queued for a hashing thread that
+// computes CRC32, MD5 and SHA-1 together, so the image never has to be
+// read back. The running state is checkpointed to PATH.hashstate so a
+// resumed backup only hashes the sectors written since the checkpoint.
+// Checkpoints are written one interval late, so the bytes they cover
+// have left the output buffers before an interruption can lose them.
+class HashSink : public Sink {
+
+ public:
+  HashSink(Sink *sink, const char *path, bool resume, unsigned int start_sector);
+  ~HashSink() { delete sink; };
+
+  int Write(unsigned int sector, unsigned char *data);
+  int Skip(unsigned int sector, unsigned int count);
+  int Close(void);
+  void Run(void);                                       // hashing thread loop
+  void Queue(void);                                     // hand the filled batch to the thread
+  void Hash(const unsigned char *data, size_t size);    // update all hashes
+  void Snapshot(unsigned char *state);                  // serialize the running state
+  int SaveState(const unsigned char *state);            // write the checkpoint
+  int LoadState(void);                                  // read the checkpoint
+  int CatchUp(unsigned long long end);                  // hash the file up to end
+
+  Sink *sink;                                           // wrapped output
+  std::string path;                                     // output path
+  bool stream;                                          // true when hashing stdout
+  unsigned int batch_sectors;                           // sectors per queued batch
+  unsigned long long hashed;                            // bytes hashed
+  unsigned long long checkpoint;                        // bytes hashed at the last checkpoint
+  bool closing;                                         // set when no more batches will arrive
+  bool snapshot;                                        // true when last_state holds a snapshot
+  unsigned char last_state[8 + hashes::STATE_SIZE];     // snapshot from the previous interval
+
+  uLong crc;                                            // running CRC32
+  Md5 md5;                                              // running MD5
+  Sha1 sha1;                                            // running SHA-1
+
+  std::vector<unsigned char> batch;                     // batch being filled
+  std::deque<std::vector<unsigned char>> queue;         // batches waiting for the thread
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread worker;
+
+}; // END class HashSink()
+
+HashSink::HashSink(Sink *sink, const char *path, bool resume, unsigned int start_sector)
+    : Sink(sink->sector_size), sink(sink), path(path), stream(strcmp(path, "-") == 0),
+      batch_sectors(constants::SECTORS_PER_CACHE), hashed(0), checkpoint(0), closing(false),
+      snapshot(false), crc(crc32(0L, Z_NULL, 0)) {
+  // Constructor that restores the hash state of a resumed backup and
+  // starts the hashing thread.
+  //
+  // Args:
+  //     sink (Sink *): output to wrap (deleted with the HashSink)
+  //     path (const char *): path of the output ("-" for stdout)
+  //     resume (bool): true when continuing an existing file
+  //     start_sector (unsigned int): first sector the backup loop will write
+
+  unsigned long long end = (unsigned long long)start_sector * sector_size;
+
+  if (resume && end > 0) {
+
+    // a checkpoint ahead of the file cannot be rewound, so start over
+    if (LoadState() != 0 || hashed > end) {
+      crc = crc32(0L, Z_NULL, 0);
+      md5.Reset();
+      sha1.Reset();
+      hashed = 0;
+    }
+
+    printf(" Hashing %llu existing bytes not covered by the hash checkpoint...\n", end - hashed);
+
+    if (CatchUp(end) != 0) {
+      printf("dvdcc:hashes:HashSink() Cannot read %s to resume hashing\n", path);
+      printf("dvdcc:hashes:HashSink() Exiting...\n");
+      exit(0);
+    }
+
+    checkpoint = hashed;
+
+  } // END if (resume && ...)
+
+  batch.reserve((size_t)batch_sectors * sector_size);
+
+  worker = std::thread(&HashSink::Run, this);
+
+}; // END HashSink::HashSink()
+
+void HashSink::Hash(const unsigned char *data, size_t size) {
+  // Update all hashes with the next bytes of the output.
+  //
+  // Args:
+  //     data (const unsigned char *): output bytes
+  //     size (size_t): number of bytes
+
+  crc = crc32(crc, data, size);
+  md5.Update(data, size);
+  sha1.Update(data, size);
+  hashed += size;
+
+}; // END HashSink::Hash()
+
+int HashSink::CatchUp(unsigned long long end) {
+  // Hash the existing file from the checkpoint up to end. Junk listed in
+  // the junk map of an elided ISO is regenerated so the hashes match the
+  // full image.
+  //
+  // Args:
+  //     end (unsigned long long): byte offset to hash up to
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  // read in large pieces to keep the number of junk map reads small
+  const size_t piece = 64 * junk::REGION_SIZE;
+  std::vector<unsigned char> data(piece);
+
+  while (hashed < end) {
+
+    size_t size = end - hashed < piece ? end - hashed : piece;
+
+    if (junk::Read(path.c_str(), hashed, data.data(), size) != 0)
+      return -1;
+
+    Hash(data.data(), size);
+
+  } // END while (hashed < end)
+
+  return 0;
+
+}; // END HashSink::CatchUp()
+
+int HashSink::Write(unsigned int sector, unsigned char *data) {
+  // Write a sector to the wrapped output and queue it for hashing.
+  //
+  // Args:
+  //     sector (unsigned int): sector number (sectors arrive in order)
+  //     data (unsigned char *): sector bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (sink->Write(sector, data) != 0) return -1;
+
+  batch.insert(batch.end(), data, data + sector_size);
+  if (batch.size() >= (size_t)batch_sectors * sector_size) Queue();
+
+  return 0;
+
+}; // END HashSink::Write()
+
+int HashSink::Skip(unsigned int sector, unsigned int count) {
+  // Skip sectors in the wrapped output and hash them as the zeros
+  // they read back as.
+  //
+  // Args:
+  //     sector (unsigned int): first sector to skip
+  //     count (unsigned int): number of sectors
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (sink->Skip(sector, count) != 0) return -1;
+
+  for (unsigned int i = 0; i < count; i++) {
+    batch.insert(batch.end(), sector_size, 0);
+    if (batch.size() >= (size_t)batch_sectors * sector_size) Queue();
+  }
+
+  return 0;
+
+}; // END HashSink::Skip()
+
+void HashSink::Queue(void) {
+  // Hand the filled batch to the hashing thread, waiting while the
+  // thread is more than a few batches behind.
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [&] { return queue.size() < 4; });
+
+  queue.push_back(std::move(batch));
+  batch = std::vector<unsigned char>();
+  batch.reserve((size_t)batch_sectors * sector_size);
+
+  cond.notify_all();
+
+}; // END HashSink::Queue()
+
+void HashSink::Run(void) {
+  // Hashing thread that consumes batches and writes checkpoints.
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+
+    cond.wait(lock, [&] { return !queue.empty() || closing; });
+    if (queue.empty()) break;
+
+    std::vector<unsigned char> data = std::move(queue.front());
+    queue.pop_front();
+    cond.notify_all();
+
+    lock.unlock();
+    Hash(data.data(), data.size());
+    if (!stream && hashed - checkpoint >= hashes::CHECKPOINT_BYTES) {
+      if (snapshot) SaveState(last_state);
+      Snapshot(last_state);
+      snapshot = true;
+      checkpoint = hashed;
+    }
+    lock.lock();
+
+  } // END while (true)
+
+}; // END HashSink::Run()
+
+void HashSink::Snapshot(unsigned char *state) {
+  // Serialize the running state in the checkpoint format.
+  //
+  // Args:
+  //     state (unsigned char *): buffer for 8 + hashes::STATE_SIZE bytes
+
+  memcpy(state, hashes::MAGIC, 8);
+  chunks::Put64(state + 8, hashed);
+  chunks::Put32(state + 16, crc);
+  md5.Save(state + 20);
+  sha1.Save(state + 20 + Md5::STATE_SIZE);
+
+}; // END HashSink::Snapshot()
+
+int HashSink::SaveState(const unsigned char *state) {
+  // Write a checkpoint to a temporary file and rename it into place.
+  //
+  // Args:
+  //     state (const unsigned char *): state from Snapshot()
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  const size_t size = 8 + hashes::STATE_SIZE;
+
+  std::string state_path = path + ".hashstate";
+  std::string tmp_path = state_path + ".tmp";
+
+  FILE *fp = fopen(tmp_path.c_str(), "wb");
+  if (fp == NULL) return -1;
+
+  bool ok = fwrite(state, 1, size, fp) == size;
+  ok = fclose(fp) == 0 && ok;
+
+  return ok && rename(tmp_path.c_str(), state_path.c_str()) == 0 ? 0 : -1;
+
+}; // END HashSink::SaveState()
+
+int HashSink::LoadState(void) {
+  // Read the checkpoint of a resumed backup.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char state[8 + hashes::STATE_SIZE];
+  std::string state_path = path + ".hashstate";
+
+  FILE *fp = fopen(state_path.c_str(), "rb");
+  if (fp == NULL) return -1;
+
+  bool ok = fread(state, 1, sizeof(state), fp) == sizeof(state) && memcmp(state, hashes::MAGIC, 8) == 0;
+  fclose(fp);
+  if (!ok) return -1;
+
+  hashed = chunks::Get64(state + 8);
+  crc = chunks::Get32(state + 16);
+  md5.Load(state + 20);
+  sha1.Load(state + 20 + Md5::STATE_SIZE);
+
+  return 0;
+
+}; // END HashSink::LoadState()
+
+int HashSink::Close(void) {
+  // Hash the remaining sectors, close the wrapped output and report the
+  // hashes. They are also written to PATH.hashes unless streaming.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (!batch.empty()) Queue();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+  }
+  cond.notify_all();
+  worker.join();
+
+  int status = sink->Close();
+
+  unsigned char md5_digest[16], sha1_digest[20];
+  char md5_text[33], sha1_text[41];
+  md5.Final(md5_digest);
+  sha1.Final(sha1_digest);
+  hashes::Hex(md5_digest, 16, md5_text);
+  hashes::Hex(sha1_digest, 20, sha1_text);
+
+  printf("\n Hashes of %s (%llu bytes)\n", path.c_str(), hashed);
+  printf("  CRC32: %08lx\n  MD5  : %s\n  SHA-1: %s\n", crc, md5_text, sha1_text);
+
+  if (stream) return status;
+
+  std::string hashes_path = path + ".hashes";
+  FILE *fp = fopen(hashes_path.c_str(), "w");
+  if (fp == NULL) return -1;
+  fprintf(fp, "size  %llu\ncrc32 %08lx\nmd5   %s\nsha1  %s\n", hashed, crc, md5_text, sha1_text);
+  if (fclose(fp) != 0) status = -1;
+
+  // the checkpoint is only needed while the backup is incomplete
+  unlink((path + ".hashstate").c_str());
+
+  return status;
+
+}; // END HashSink::Close()
+
+#endif // DVDCC_HASHES_H_
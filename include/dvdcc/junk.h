@@ -0,0 +1,500 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_JUNK_H_
+#define DVDCC_JUNK_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/sinks.h"
+#include "dvdcc/chunks.h"
+
+// Class for regenerating the padding ("junk") that fills unused space on
+// Gamecube/Wii discs.
+//
+// Note:
+//     Junk is produced by a Lagged Fibonacci Generator (LFG) with lags
+//     j = 32, k = 521 over 32 bit words. The generator is re-seeded at the
+//     start of every 256 kB block of the disc from the 4 byte disc ID, the
+//     disc number and the block number, so any region can be regenerated
+//     without reading the rest of the disc. See:
+//
+// [1] https://en.wikipedia.org/wiki/Lagged_Fibonacci_generator
+// [2] https://wiibrew.org/wiki/Wii_disc
+class JunkGenerator {
+
+ public:
+  JunkGenerator(const unsigned char *disc_id, unsigned char disc_number);
+
+  void Seed(unsigned int block);                                               // restart at a 256 kB block
+  void Forward(void);                                                          // advance the LFG by k words
+  void Generate(unsigned long long offset, unsigned char *data, size_t size);  // junk for a disc byte range
+
+  static const unsigned int K = 521;         // long lag in words
+  static const unsigned int J = 32;          // short lag in words
+  static const unsigned int SEED_WORDS = 17; // words set directly by the seed
+  static const unsigned int BLOCK_SIZE = 0x40000;
+
+  unsigned int id;                           // disc ID as a big endian word
+  unsigned char disc_number;                 // disc number for multi disc titles
+  unsigned int block;                        // block the generator is positioned in
+  unsigned int position;                     // byte position within the block
+  bool seeded;                               // set once Seed() has been called
+  unsigned int buffer[K];                    // LFG state stored as output bytes
+
+}; // END class JunkGenerator()
+
+JunkGenerator::JunkGenerator(const unsigned char *disc_id, unsigned char disc_number)
+    : disc_number(disc_number), block(0), position(0), seeded(false) {
+  // Constructor for the junk generator of a disc.
+  //
+  // Args:
+  //     disc_id (const unsigned char *): first 4 bytes of the disc header (e.g. "RNPE")
+  //     disc_number (unsigned char): disc number from byte 6 of the disc header
+
+  id = (disc_id[0] << 24) + (disc_id[1] << 16) + (disc_id[2] << 8) + disc_id[3];
+
+}; // END JunkGenerator::JunkGenerator()
+
+void JunkGenerator::Seed(unsigned int block) {
+  // Seed the generator for the start of a 256 kB block.
+  //
+  // Args:
+  //     block (unsigned int): block number (disc offset / 256 kB)
+
+  // the first 17 words take one bit at a time from a linear congruential sequence
+  unsigned int sample = ((id ^ disc_number) * 0x260BCD5) ^ (block * 0x1EF29123);
+  for (unsigned int i = 0; i < SEED_WORDS; i++) {
+    buffer[i] = 0;
+    for (unsigned int j = 0; j < 32; j++) {
+      sample = sample * 0x5D588B65 + 1;
+      buffer[i] = (buffer[i] >> 1) | (sample & 0x80000000);
+    }
+  }
+
+  // the remaining words follow from the seed words
+  for (unsigned int i = SEED_WORDS; i < K; i++)
+    buffer[i] = (buffer[i - 17] << 23) ^ (buffer[i - 16] >> 9) ^ buffer[i - 1];
+
+  // output takes bits 18-25 rather than 16-23 for the third byte, which is
+  // applied once here before storing each word as big endian bytes
+  for (unsigned int i = 0; i < K; i++) {
+    unsigned int x = (buffer[i] & 0xFF00FFFF) | ((buffer[i] >> 2) & 0x00FF0000);
+    buffer[i] = __builtin_bswap32(x);
+  }
+
+  for (int i = 0; i < 4; i++) Forward();
+
+  this->block = block;
+  position = 0;
+  seeded = true;
+
+}; // END JunkGenerator::Seed()
+
+void JunkGenerator::Forward(void) {
+  // Advance the generator by one full buffer of k words.
+
+  for (unsigned int i = 0; i < J; i++)
+    buffer[i] ^= buffer[i + K - J];
+  for (unsigned int i = J; i < K; i++)
+    buffer[i] ^= buffer[i - J];
+
+}; // END JunkGenerator::Forward()
+
+void JunkGenerator::Generate(unsigned long long offset, unsigned char *data, size_t size) {
+  // Write the junk bytes expected at a disc byte offset. Sequential calls
+  // continue from the current generator state instead of re-seeding.
+  //
+  // Args:
+  //     offset (unsigned long long): disc byte offset
+  //     data (unsigned char *): buffer for the junk bytes
+  //     size (size_t): number of bytes
+
+  const unsigned int buffer_size = K * 4;
+
+  while (size > 0) {
+
+    unsigned int target_block = offset / BLOCK_SIZE;
+    unsigned int target_position = offset % BLOCK_SIZE;
+
+    // re-seed when changing blocks or moving backwards
+    if (!seeded || target_block != block || target_position < position)
+      Seed(target_block);
+
+    // skip forward to the target position
+    while (position / buffer_size < target_position / buffer_size) {
+      Forward();
+      position = (position / buffer_size + 1) * buffer_size;
+    }
+    position = target_position;
+
+    // copy up to the end of the LFG buffer or the end of the block
+    unsigned int start = position % buffer_size;
+    size_t length = buffer_size - start;
+    if (length > BLOCK_SIZE - position) length = BLOCK_SIZE - position;
+    if (length > size) length = size;
+
+    memcpy(data, (unsigned char *)buffer + start, length);
+
+    data += length;
+    size -= length;
+    offset += length;
+    position += length;
+
+    if (position % buffer_size == 0) Forward();
+
+  } // END while (size > 0)
+
+}; // END JunkGenerator::Generate()
+
+namespace junk {
+
+// Junk map sidecar format
+//
+//   header   16 bytes
+//            0  8 bytes  magic "DVDCCJ01"
+//            8  4 bytes  disc ID
+//           12  1 byte   disc number
+//           13  3 bytes  reserved
+//   regions  4 bytes (little endian) per 32 kB region replaced by a hole
+//
+// Regions are appended as they are found so the map stays valid if a
+// backup is interrupted and later resumed.
+const char MAGIC[8] = {'D', 'V', 'D', 'C', 'C', 'J', '0', '1'};
+const unsigned int HEADER_SIZE = 16;
+const unsigned int REGION_SIZE = 0x8000;
+
+int ReadMap(const char *path, unsigned char *disc_id, unsigned char *disc_number,
+            std::vector<unsigned int> *regions) {
+  // Read a junk map sidecar.
+  //
+  // Args:
+  //     path (const char *): path to the sidecar
+  //     disc_id (unsigned char *): returns the 4 byte disc ID
+  //     disc_number (unsigned char *): returns the disc number
+  //     regions (std::vector<unsigned int> *): returns the junk region numbers
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char header[HEADER_SIZE], entry[4];
+
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) return -1;
+
+  if (fread(header, 1, HEADER_SIZE, fp) != HEADER_SIZE || memcmp(header, MAGIC, 8) != 0) {
+    fclose(fp);
+    return -1;
+  }
+
+  memcpy(disc_id, header + 8, 4);
+  *disc_number = header[12];
+
+  while (fread(entry, 1, 4, fp) == 4)
+    regions->push_back(entry[0] + (entry[1] << 8) + (entry[2] << 16) + (entry[3] << 24));
+
+  fclose(fp);
+
+  return 0;
+
+}; // END junk::ReadMap()
+
+int Fill(const char *image_path, const char *map_path) {
+  // Rebuild a byte exact image by writing the regenerated junk back
+  // into the holes listed in the junk map.
+  //
+  // Args:
+  //     image_path (const char *): path to the ISO image with holes
+  //     map_path (const char *): path to the junk map sidecar
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char disc_id[4], disc_number;
+  std::vector<unsigned int> regions;
+
+  if (ReadMap(map_path, disc_id, &disc_number, &regions) != 0) {
+    printf("dvdcc:junk:Fill() Cannot read junk map %s\n", map_path);
+    return -1;
+  }
+
+  int fd = open(image_path, O_RDWR);
+  if (fd < 0) {
+    printf("dvdcc:junk:Fill() Cannot open %s\n", image_path);
+    return -1;
+  }
+
+  // junk is written at ISO offsets, which would corrupt a compressed image
+  char magic[8];
+  if (pread(fd, magic, 8, 0) == 8 && memcmp(magic, chunks::MAGIC, 8) == 0) {
+    printf("dvdcc:junk:Fill() %s is a compressed image. Only ISO images can be filled.\n", image_path);
+    close(fd);
+    return -1;
+  }
+
+  JunkGenerator generator(disc_id, disc_number);
+  unsigned char data[REGION_SIZE];
+
+  for (unsigned int i = 0; i < regions.size(); i++) {
+    unsigned long long offset = (unsigned long long)regions[i] * REGION_SIZE;
+    generator.Generate(offset, data, REGION_SIZE);
+    if (pwrite(fd, data, REGION_SIZE, offset) != REGION_SIZE) {
+      printf("dvdcc:junk:Fill() Failed writing region %u\n", regions[i]);
+      close(fd);
+      return -1;
+    }
+  }
+
+  printf("Filled %zu junk regions (%.2f GB).\n", regions.size(),
+         double(regions.size()) * REGION_SIZE / (1024 * 1024 * 1024));
+
+  return close(fd) == 0 ? 0 : -1;
+
+}; // END junk::Fill()
+
+void Regenerate(const unsigned char *disc_id, unsigned char disc_number, const std::vector<unsigned int> &regions,
+                unsigned long long offset, unsigned char *data, size_t size) {
+  // Regenerate the junk of the listed regions that overlap a byte range.
+  //
+  // Args:
+  //     disc_id (const unsigned char *): 4 byte disc ID
+  //     disc_number (unsigned char): disc number
+  //     regions (const std::vector<unsigned int> &): junk region numbers in ascending order
+  //     offset (unsigned long long): byte offset of the range
+  //     data (unsigned char *): bytes of the range, overwritten where junk was elided
+  //     size (size_t): number of bytes
+
+  JunkGenerator generator(disc_id, disc_number);
+  unsigned long long end = offset + size;
+
+  // regions are written in disc order, so only the overlapping ones are visited
+  std::vector<unsigned int>::const_iterator it = std::lower_bound(regions.begin(), regions.end(),
+                                                                   (unsigned int)(offset / REGION_SIZE));
+
+  for (; it != regions.end() && (unsigned long long)*it * REGION_SIZE < end; it++) {
+    unsigned long long first = (unsigned long long)*it * REGION_SIZE;
+    unsigned long long last = first + REGION_SIZE;
+    if (first < offset) first = offset;
+    if (last > end) last = end;
+    generator.Generate(first, data + (first - offset), last - first);
+  }
+
+}; // END junk::Regenerate()
+
+int Read(const char *image_path, unsigned long long offset, unsigned char *data, size_t size) {
+  // Read a byte range of an ISO image, regenerating the junk of regions
+  // listed in its junk map (image path + .junk) when the map exists, so
+  // elided images read back as the full image.
+  //
+  // Args:
+  //     image_path (const char *): path to the ISO image
+  //     offset (unsigned long long): byte offset
+  //     data (unsigned char *): buffer for the bytes
+  //     size (size_t): number of bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  int fd = open(image_path, O_RDONLY);
+  if (fd < 0) return -1;
+
+  ssize_t n = pread(fd, data, size, offset);
+  close(fd);
+  if (n != (ssize_t)size) return -1;
+
+  unsigned char disc_id[4], disc_number;
+  std::vector<unsigned int> regions;
+  std::string map_path = std::string(image_path) + ".junk";
+  if (ReadMap(map_path.c_str(), disc_id, &disc_number, &regions) != 0) return 0;
+
+  Regenerate(disc_id, disc_number, regions, offset, data, size);
+
+  return 0;
+
+}; // END junk::Read()
+
+} // namespace junk
+
+// Class for eliding junk from an ISO backup. Sectors are grouped into
+// aligned 32 kB regions that are compared against the regenerated junk.
+// Matching regions are skipped in the wrapped output, leaving a hole, and
+// recorded in the junk map sidecar instead.
+class JunkSink : public Sink {
+
+ public:
+  JunkSink(Sink *sink, const char *map_path, const unsigned char *disc_id, unsigned char disc_number);
+  ~JunkSink() { delete sink; };
+
+  int Write(unsigned int sector, unsigned char *data);
+  int Skip(unsigned int sector, unsigned int count);
+  int Close(void);
+  int Flush(void);                          // write or elide the buffered region
+
+  Sink *sink;                               // wrapped ISO output
+  FILE *map;                                // junk map sidecar
+  JunkGenerator generator;                  // junk for this disc
+  unsigned int sectors_per_region;          // sectors in a 32 kB region
+  unsigned int region_start;                // first sector of the buffered region
+  unsigned int region_fill;                 // sectors in the buffered region
+  unsigned int elided;                      // number of regions elided
+  std::vector<unsigned char> region;        // buffered region
+  std::vector<unsigned char> expected;      // regenerated junk for the region
+
+}; // END class JunkSink()
+
+JunkSink::JunkSink(Sink *sink, const char *map_path, const unsigned char *disc_id, unsigned char disc_number)
+    : Sink(sink->sector_size), sink(sink), generator(disc_id, disc_number),
+      sectors_per_region(junk::REGION_SIZE / sink->sector_size), region_start(0), region_fill(0),
+      elided(0), region(junk::REGION_SIZE), expected(junk::REGION_SIZE) {
+  // Constructor that opens or continues the junk map sidecar.
+  //
+  // Args:
+  //     sink (Sink *): ISO output to wrap (deleted with the JunkSink)
+  //     map_path (const char *): path to the junk map sidecar
+  //     disc_id (const unsigned char *): first 4 bytes of the disc header
+  //     disc_number (unsigned char): disc number from the disc header
+
+  map = fopen(map_path, "ab");
+  if (map == NULL) {
+    printf("dvdcc:junk:JunkSink() Cannot open junk map %s\n", map_path);
+    printf("dvdcc:junk:JunkSink() Exiting...\n");
+    exit(0);
+  }
+
+  // new maps start with the header
+  if (ftello(map) == 0) {
+    unsigned char header[junk::HEADER_SIZE];
+    memset(header, 0, junk::HEADER_SIZE);
+    memcpy(header, junk::MAGIC, 8);
+    memcpy(header + 8, disc_id, 4);
+    header[12] = disc_number;
+    fwrite(header, 1, junk::HEADER_SIZE, map);
+    fflush(map);
+  }
+
+}; // END JunkSink::JunkSink()
+
+int JunkSink::Write(unsigned int sector, unsigned char *data) {
+  // Buffer a sector and check the region once it is complete. Sectors
+  // before the first region boundary (e.g. after a resume) pass through.
+  //
+  // Args:
+  //     sector (unsigned int): sector number (sectors arrive in order)
+  //     data (unsigned char *): sector bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (region_fill == 0) {
+    if (sector % sectors_per_region != 0)
+      return sink->Write(sector, data);
+    region_start = sector;
+  }
+
+  memcpy(region.data() + (size_t)region_fill * sector_size, data, sector_size);
+
+  if (++region_fill < sectors_per_region)
+    return 0;
+
+  return Flush();
+
+}; // END JunkSink::Write()
+
+int JunkSink::Flush(void) {
+  // Elide the buffered region when it matches the regenerated junk,
+  // otherwise pass its sectors to the wrapped output.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned int count = region_fill;
+  region_fill = 0;
+
+  if (count == sectors_per_region) {
+
+    unsigned long long offset = (unsigned long long)region_start * sector_size;
+
+    // memcmp is vectorized by the C library, so check a cheap prefix first
+    generator.Generate(offset, expected.data(), junk::REGION_SIZE);
+    if (memcmp(region.data(), expected.data(), 64) == 0 &&
+        memcmp(region.data(), expected.data(), junk::REGION_SIZE) == 0) {
+
+      unsigned int number = offset / junk::REGION_SIZE;
+      unsigned char entry[4] = {(unsigned char)number, (unsigned char)(number >> 8),
+                                (unsigned char)(number >> 16), (unsigned char)(number >> 24)};
+
+      if (fwrite(entry, 1, 4, map) != 4 || fflush(map) != 0) return -1;
+      elided++;
+
+      return sink->Skip(region_start, count);
+
+    } // END if (memcmp ...)
+
+  } // END if (count == sectors_per_region)
+
+  for (unsigned int i = 0; i < count; i++)
+    if (sink->Write(region_start + i, region.data() + (size_t)i * sector_size) != 0)
+      return -1;
+
+  return 0;
+
+}; // END JunkSink::Flush()
+
+int JunkSink::Skip(unsigned int sector, unsigned int count) {
+  // Pass a skipped range through to the wrapped output.
+  //
+  // Args:
+  //     sector (unsigned int): first sector to skip
+  //     count (unsigned int): number of sectors
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (region_fill && Flush() != 0) return -1;
+
+  return sink->Skip(sector, count);
+
+}; // END JunkSink::Skip()
+
+int JunkSink::Close(void) {
+  // Write any partial region and close the wrapped output and junk map.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  int status = region_fill ? Flush() : 0;
+
+  if (elided)
+    printf("Elided %u junk regions (%.2f GB).\n", elided,
+           double(elided) * junk::REGION_SIZE / (1024 * 1024 * 1024));
+
+  if (fclose(map) != 0) status = -1;
+  if (sink->Close() != 0) status = -1;
+
+  return status;
+
+}; // END JunkSink::Close()
+
+#endif // DVDCC_JUNK_H_
@@ -0,0 +1,156 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_KEYS_H_
+#define DVDCC_KEYS_H_
+
+#include <string.h>
+
+#include <vector>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/cypher.h"
+#include "dvdcc/ecma_267.h"
+#include "dvdcc/layout.h"
+
+// Functions for recovering the cypher keys of scrambled raw sectors.
+// They are shared by Dvd::FindKeys(), which reads sectors from the drive
+// cache, and the offline tools, which read them from RAW images.
+namespace keys {
+
+const unsigned int MAX_SEED = 0x7FFF;
+
+unsigned int StoredEdc(const unsigned char *raw_sector) {
+  // Return the error detection code from the last 4 bytes of raw sector data.
+  //
+  // Args:
+  //     raw_sector (const unsigned char *): raw sector data
+  //
+  // Returns:
+  //     (unsigned int): error detection code
+
+  const unsigned char *edc_bytes = raw_sector + constants::RAW_SECTOR_SIZE - 4;
+
+  return (edc_bytes[0] << 24) + (edc_bytes[1] << 16) + (edc_bytes[2] << 8) + edc_bytes[3];
+
+}; // END keys::StoredEdc()
+
+bool Verify(unsigned char *raw_sector) {
+  // Check a decoded raw sector against its error detection code.
+  //
+  // Args:
+  //     raw_sector (unsigned char *): decoded raw sector data
+  //
+  // Returns:
+  //     (bool): true when the EDC matches
+
+  return layout::Verify<layout::Sector>(raw_sector);
+
+}; // END keys::Verify()
+
+unsigned int CypherIndex(unsigned int block, unsigned int cypher_number) {
+  // Return the cypher index for a sector block.
+  //
+  // Blocks >= 1 use a repeating sequence of cypher values
+  // from 1 to cypher_number. The first block beyond cypher_number
+  // loops back to 1 to restart the sequence.
+  //
+  // Block 0 uses a unique cypher to decode disc information.
+  // The cypher index for this block is handled as a separate
+  // return value because it is not part of the repeating sequence.
+  //
+  // Args:
+  //     block (unsigned int): block number
+  //     cypher_number (unsigned int): number of cyphers in the sequence
+  //
+  // Returns:
+  //     (unsigned int): cypher index
+
+  if (block)
+    return (block - 1) % (cypher_number - 1) + 1;
+  return 0;
+
+}; // END keys::CypherIndex()
+
+Cypher *FindCypher(const unsigned char *raw_sector) {
+  // Search the seeds for the cypher that decodes a scrambled raw sector.
+  //
+  // Args:
+  //     raw_sector (const unsigned char *): scrambled raw sector data
+  //
+  // Returns:
+  //     (Cypher *): new cypher owned by the caller (NULL = no seed matched)
+
+  unsigned char tmp[constants::RAW_SECTOR_SIZE];
+
+  for (unsigned int seed = 0; seed < MAX_SEED; seed++) {
+    // try decoding a copy of the sector
+    memcpy(tmp, raw_sector, constants::RAW_SECTOR_SIZE);
+    Cypher *cypher = new Cypher(seed, constants::SECTOR_SIZE);
+    layout::Descramble<layout::Sector>(cypher, tmp);
+    if (Verify(tmp))
+      return cypher;
+    delete cypher;
+  } // END for (seed)
+
+  return NULL;
+
+}; // END keys::FindCypher()
+
+int FindSequence(const unsigned char *image, unsigned int sector_number,
+                 unsigned int blocks, std::vector<Cypher *> *cyphers) {
+  // Find the cypher of each block of a scrambled RAW image until the
+  // repeating sequence restarts, in the order used by Dvd::CypherIndex().
+  //
+  // Args:
+  //     image (const unsigned char *): raw sectors starting from sector 0
+  //     sector_number (unsigned int): number of sectors in the image
+  //     blocks (unsigned int): maximum number of blocks to check
+  //     cyphers (std::vector<Cypher *> *): returns the cyphers owned by the caller
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  for (unsigned int block = 0; block < blocks; block++) {
+
+    if ((block + 1) * constants::SECTORS_PER_BLOCK > sector_number) break;
+
+    const unsigned char *raw_sector = image + (size_t)block * constants::SECTORS_PER_BLOCK * constants::RAW_SECTOR_SIZE;
+
+    Cypher *cypher = FindCypher(raw_sector);
+    if (cypher == NULL) {
+      printf("dvdcc:keys:FindSequence() Could not identify cypher %02zu\n", cyphers->size());
+      return -1;
+    }
+
+    // repeated seed 1 means we found all cyphers
+    if (cyphers->size() > 1 && (*cyphers)[1]->seed == cypher->seed) {
+      delete cypher;
+      break;
+    }
+
+    printf(" * Block %02d found key 0x%04x\n", block, cypher->seed);
+    cyphers->push_back(cypher);
+
+  } // END for (block)
+
+  return cyphers->size() > 1 ? 0 : -1;
+
+}; // END keys::FindSequence()
+
+} // namespace keys
+
+#endif // DVDCC_KEYS_H_
@@ -0,0 +1,112 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_LAYOUT_H_
+#define DVDCC_LAYOUT_H_
+
+#include <string.h>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/cypher.h"
+#include "dvdcc/ecma_267.h"
+
+// Raw sector layouts, see DOCUMENTATION.md. Both layouts scramble the
+// same 2048 bytes and cover the same bytes with the EDC, but place the
+// user data differently:
+//
+//   DVD-ROM        ID (4) | IED (2) | CPR_MAI (6) | data (2048) | EDC (4)
+//   Gamecube/Wii   ID (4) | IED (2) | data (2048) | unknown (6) | EDC (4)
+//
+// The layouts are passed as template parameters to the decode, verify
+// and extract loops so their offsets are compile time constants, and
+// the layout of a disc is selected once with Select().
+namespace layout {
+
+// Scrambled range and EDC span shared by both layouts. Steps that run
+// before the layout of a disc is known, such as the key search, use it
+// directly.
+struct Sector {
+  static constexpr unsigned int SCRAMBLE_START = 12;   // first scrambled byte
+  static constexpr unsigned int SCRAMBLE_BYTES = 2048; // scrambled bytes
+  static constexpr unsigned int EDC_SPAN = 2060;       // bytes covered by the EDC
+};
+
+// Standard DVD-ROM sectors.
+struct DvdRom : Sector {
+  static constexpr unsigned int PAYLOAD = 12;          // offset of the user data
+};
+
+// Gamecube and Wii sectors.
+struct GameDisc : Sector {
+  static constexpr unsigned int PAYLOAD = 6;           // offset of the user data
+};
+
+static_assert(Sector::EDC_SPAN + 4 == constants::RAW_SECTOR_SIZE, "the EDC ends raw sectors");
+
+template <class Layout>
+void Descramble(const Cypher *cypher, unsigned char *raw_sector) {
+  // descramble a raw sector with the cypher of its block
+  cypher->Decode64<Layout::SCRAMBLE_START, Layout::SCRAMBLE_BYTES>(raw_sector);
+}
+
+template <class Layout>
+bool Verify(unsigned char *raw_sector) {
+  // check a descrambled raw sector against the big endian EDC that follows the span
+  const unsigned char *edc = raw_sector + Layout::EDC_SPAN;
+  unsigned int stored = (edc[0] << 24) + (edc[1] << 16) + (edc[2] << 8) + edc[3];
+  return stored == ecma_267::calculate(raw_sector, Layout::EDC_SPAN);
+}
+
+template <class Layout, class T>
+T *Payload(T *raw_sector) {
+  // user data of a descrambled raw sector
+  return raw_sector + Layout::PAYLOAD;
+}
+
+template <class Layout>
+void Extract(const unsigned char *raw, unsigned int count, unsigned char *iso) {
+  // Copy the user data of consecutive raw sectors to consecutive ISO
+  // sectors, which is all an ISO backup holds of each raw sector.
+  //
+  // Args:
+  //     raw (const unsigned char *): count descrambled raw sectors
+  //     count (unsigned int): number of sectors
+  //     iso (unsigned char *): buffer for count ISO sectors
+
+  for (unsigned int n = 0; n < count; n++)
+    memcpy(iso + (size_t)n * constants::SECTOR_SIZE, Payload<Layout>(raw + (size_t)n * constants::RAW_SECTOR_SIZE),
+           constants::SECTOR_SIZE);
+
+}; // END layout::Extract()
+
+template <class F>
+auto Select(bool dvd_rom, F function) {
+  // Call a function taking the layout of a disc as its argument type.
+  //
+  // Args:
+  //     dvd_rom (bool): true for standard DVD-ROM discs, false for Gamecube/Wii
+  //     function (F): generic callable, e.g. [&](auto layout) { ... }
+  //
+  // Returns:
+  //     the result of the function
+
+  return dvd_rom ? function(DvdRom()) : function(GameDisc());
+
+}; // END layout::Select()
+
+} // namespace layout
+
+#endif // DVDCC_LAYOUT_H_
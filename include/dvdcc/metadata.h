@@ -0,0 +1,136 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_METADATA_H_
+#define DVDCC_METADATA_H_
+
+#include <stdio.h>
+
+#include <string>
+
+#include "dvdcc/constants.h"
+
+// Functions for decoding the Gamecube/Wii disc header from sector
+// payloads, shared by drives and offline images.
+namespace metadata {
+
+const unsigned int HEADER_BYTES = 0x60;           // bytes of sector 0 holding the ID, title and magic words
+const unsigned int UPDATE_SECTOR = 160;           // sector holding the Wii update key
+const unsigned int NO_UPDATE_KEY = 0xA5BED6AE;    // update key of Wii discs without a system update
+const unsigned int WII_MAGIC = 0x5D1C9EA3;        // magic word at 0x18 of Wii discs
+const unsigned int GAMECUBE_MAGIC = 0xC2339F3D;   // magic word at 0x1C of Gamecube discs
+
+// Decoded disc header.
+struct Header {
+  std::string disc_id;           // system, game, region and publisher IDs
+  unsigned char disc_number = 0; // disc number of multi disc games
+  unsigned char version = 0;     // disc version (1.xx)
+  std::string system_id;
+  std::string game_id;
+  std::string region_id;
+  std::string publisher_id;
+  std::string system;            // full system name (UNKNOWN when not listed)
+  std::string region;            // full region name (UNKNOWN when not listed)
+  std::string publisher;         // full publisher name (UNKNOWN when not listed)
+  std::string title;             // game title without trailing whitespace
+  unsigned int update_key = 0;   // update key from sector 160 (0 = not read)
+  bool has_update = false;       // true when a Wii disc holds a system update
+};
+
+unsigned int Get32(const unsigned char *p) {
+  // big endian word of the disc header
+  return (p[0] << 24) + (p[1] << 16) + (p[2] << 8) + p[3];
+}
+
+std::string Type(const unsigned char *data) {
+  // Identify a disc from the magic words of its header.
+  //
+  // Args:
+  //     data (const unsigned char *): first HEADER_BYTES of the sector 0 payload
+  //
+  // Returns:
+  //     (std::string): "WII", "GAMECUBE" or "" when neither
+
+  if (Get32(data + 0x18) == WII_MAGIC) return "WII";
+  if (Get32(data + 0x1C) == GAMECUBE_MAGIC) return "GAMECUBE";
+
+  return "";
+
+}; // END metadata::Type()
+
+void Parse(const unsigned char *data, const unsigned char *update, bool wii, Header *header) {
+  // Decode the disc header and look up the system, region and publisher.
+  //
+  // Args:
+  //     data (const unsigned char *): first HEADER_BYTES of the sector 0 payload
+  //     update (const unsigned char *): first 8 bytes of the sector 160 payload (NULL = unknown)
+  //     wii (bool): true for Wii discs, the only discs with system updates
+  //     header (Header *): returns the decoded header
+
+  header->disc_id      = std::string((char *)&data[0], 6);
+  header->disc_number  = data[6];
+  header->version      = data[7];
+  header->system_id    = std::string((char *)&data[0], 1);
+  header->game_id      = std::string((char *)&data[1], 2);
+  header->region_id    = std::string((char *)&data[3], 1);
+  header->publisher_id = std::string((char *)&data[4], 2);
+
+  // full system name
+  header->system = "UNKNOWN";
+  if (auto search = constants::systems.find(header->system_id); search != constants::systems.end())
+    header->system = search->second;
+
+  // full region name
+  header->region = "UNKNOWN";
+  if (auto search = constants::regions.find(header->region_id); search != constants::regions.end())
+    header->region = search->second;
+
+  // full publisher name
+  header->publisher = "UNKNOWN";
+  if (auto search = constants::publishers.find(header->publisher_id); search != constants::publishers.end())
+    header->publisher = search->second;
+
+  // title without additional whitespace
+  header->title = std::string((char *)&data[0x20], 64);
+  header->title.resize(header->title.find('\0') == std::string::npos ? 64 : header->title.find('\0'));
+  while (!header->title.empty() && header->title.back() == ' ')
+    header->title.pop_back();
+
+  // Wii discs without a system update hold a fixed key in sector 160
+  header->update_key = update ? Get32(update + 4) : 0;
+  header->has_update = update && wii && header->update_key != NO_UPDATE_KEY;
+
+}; // END metadata::Parse()
+
+void Print(Header &header) {
+  // Display the decoded header on-screen.
+  //
+  // Args:
+  //     header (Header &): decoded header
+
+  printf("System ID..........: %s (%s)\n", header.system_id.c_str(), header.system.c_str());
+  printf("Game ID............: %s\n", header.game_id.c_str());
+  printf("Region.............: %s (%s)\n", header.region_id.c_str(), header.region.c_str());
+  printf("Publisher..........: %s (%s)\n", header.publisher_id.c_str(), header.publisher.c_str());
+  printf("Version............: 1.%02u\n", header.version);
+  printf("Game title.........: %s\n", header.title.c_str());
+  printf("Contains update....: %s (0x%08x)\n\n", header.has_update ? "Yes" : "No", header.update_key);
+
+}; // END metadata::Print()
+
+} // namespace metadata
+
+#endif // DVDCC_METADATA_H_
@@ -0,0 +1,246 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_METRICS_H_
+#define DVDCC_METRICS_H_
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <condition_variable>
+
+#include "dvdcc/constants.h"
+
+// Functions for exporting per drive counters as a Prometheus textfile
+// (node_exporter --collector.textfile). Drives only bump relaxed atomic
+// counters, while a background thread formats the file and replaces it
+// with a rename so the collector never sees a partial file.
+namespace metrics {
+
+const unsigned int INTERVAL = 5; // seconds between rewrites of the file
+
+// Class for the counters of one drive.
+class Device {
+
+ public:
+  Device(std::string label)
+    : label(label), sectors_read(0), bytes_written(0), retries(0), edc_failures(0), cache_fills(0),
+      current_lba(0), standby_seconds(0), last_sectors(0), last_progress(0) {};
+
+  void Read(unsigned int lba, unsigned int sectors, unsigned long long bytes) {
+    // count sectors read and written to the outputs, ending before lba + sectors
+    sectors_read.fetch_add(sectors, std::memory_order_relaxed);
+    bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+    current_lba.store(lba + sectors, std::memory_order_relaxed);
+  };
+
+  std::string label;                                  // device path
+
+  std::atomic<unsigned long long> sectors_read;       // sectors read and verified
+  std::atomic<unsigned long long> bytes_written;      // bytes passed to the outputs
+  std::atomic<unsigned long long> retries;            // cache clears before re-reading
+  std::atomic<unsigned long long> edc_failures;       // sectors failing EDC
+  std::atomic<unsigned long long> cache_fills;        // raw cache reads from the drive
+  std::atomic<unsigned int> current_lba;              // next sector of the backup
+  std::atomic<unsigned int> standby_seconds;          // last wait for drive activity to stop
+
+  unsigned long long last_sectors;                    // sectors_read at the previous export
+  time_t last_progress;                               // time sectors_read last changed
+
+}; // END class Device()
+
+std::mutex mutex;                  // guards devices and the exporter state
+std::list<Device> devices;         // every drive opened, never removed
+std::string path;                  // textfile path (empty = not exporting)
+std::thread exporter;              // background writer
+std::condition_variable wake;      // wakes the writer to stop
+bool stopping = false;
+
+Device *Add(std::string label) {
+  // Get the counters of a drive, creating them the first time. Counters
+  // are kept for the life of the program so they only ever increase.
+  //
+  // Args:
+  //     label (std::string): device path
+  //
+  // Returns:
+  //     (Device *): counters of the drive
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (auto it = devices.begin(); it != devices.end(); it++)
+    if (it->label == label) return &*it;
+
+  devices.emplace_back(label);
+  devices.back().last_progress = time(NULL);
+
+  return &devices.back();
+
+}; // END metrics::Add()
+
+int Write(double seconds) {
+  // Write every counter to a temporary file and rename it over the
+  // textfile. Called with mutex held.
+  //
+  // Args:
+  //     seconds (double): time since the previous write, for throughput
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  std::string tmp = path + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "w");
+  if (fp == NULL) return -1;
+
+  time_t now = time(NULL);
+
+  struct Family { const char *name, *type, *help; };
+  const Family families[] = {
+    {"dvdcc_sectors_read_total",              "counter", "Sectors read and verified."},
+    {"dvdcc_bytes_written_total",             "counter", "Bytes passed to the backup outputs."},
+    {"dvdcc_retries_total",                   "counter", "Drive cache clears before re-reading sectors."},
+    {"dvdcc_edc_failures_total",              "counter", "Sectors that failed the EDC check."},
+    {"dvdcc_cache_fills_total",               "counter", "Raw drive cache reads."},
+    {"dvdcc_current_lba",                     "gauge",   "Next sector of the backup."},
+    {"dvdcc_throughput_megabytes_per_second", "gauge",   "User data read since the previous export in MB/s."},
+    {"dvdcc_standby_wait_seconds",            "gauge",   "Last wait for drive activity to stop."},
+    {"dvdcc_last_progress_timestamp_seconds", "gauge",   "Time a sector was last read."},
+  };
+
+  for (unsigned int f = 0; f < sizeof(families) / sizeof(families[0]); f++) {
+
+    fprintf(fp, "# HELP %s %s\n# TYPE %s %s\n", families[f].name, families[f].help, families[f].name, families[f].type);
+
+    for (auto it = devices.begin(); it != devices.end(); it++) {
+
+      unsigned long long sectors = it->sectors_read.load(std::memory_order_relaxed);
+      double value = 0;
+
+      switch (f) {
+        case 0: value = sectors; break;
+        case 1: value = it->bytes_written.load(std::memory_order_relaxed); break;
+        case 2: value = it->retries.load(std::memory_order_relaxed); break;
+        case 3: value = it->edc_failures.load(std::memory_order_relaxed); break;
+        case 4: value = it->cache_fills.load(std::memory_order_relaxed); break;
+        case 5: value = it->current_lba.load(std::memory_order_relaxed); break;
+        case 6: value = seconds > 0 ? (sectors - it->last_sectors) * constants::SECTOR_SIZE / seconds / 1e6 : 0; break;
+        case 7: value = it->standby_seconds.load(std::memory_order_relaxed); break;
+        case 8: value = it->last_progress; break;
+      }
+
+      fprintf(fp, "%s{device=\"%s\"} %.17g\n", families[f].name, it->label.c_str(), value);
+
+    } // END for (it)
+  } // END for (f)
+
+  // throughput and progress are measured from one export to the next
+  for (auto it = devices.begin(); it != devices.end(); it++) {
+    unsigned long long sectors = it->sectors_read.load(std::memory_order_relaxed);
+    if (sectors != it->last_sectors) it->last_progress = now;
+    it->last_sectors = sectors;
+  }
+
+  bool good = fflush(fp) == 0 && ferror(fp) == 0;
+  if (fclose(fp) != 0) good = false;
+
+  if (!good || rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return -1;
+  }
+
+  return 0;
+
+}; // END metrics::Write()
+
+void Run(void) {
+  // Rewrite the textfile every INTERVAL seconds until stopped. Runs on the
+  // exporter thread.
+
+  std::unique_lock<std::mutex> lock(mutex);
+  auto last = std::chrono::steady_clock::now();
+  bool warned = false;
+
+  while (true) {
+
+    wake.wait_for(lock, std::chrono::seconds(INTERVAL), []() { return stopping; });
+
+    auto now = std::chrono::steady_clock::now();
+    if (Write(std::chrono::duration<double>(now - last).count()) != 0 && !warned) {
+      fprintf(stderr, "\ndvdcc:metrics:Run() Cannot write %s\n", path.c_str());
+      warned = true;
+    }
+    last = now;
+
+    if (stopping) break;
+
+  } // END while (true)
+
+}; // END metrics::Run()
+
+void Stop(void) {
+  // Write the final counters and stop the exporter. Registered with
+  // atexit() so the last values are exported on every exit.
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!exporter.joinable()) return;
+    stopping = true;
+  }
+
+  wake.notify_all();
+  exporter.join();
+
+}; // END metrics::Stop()
+
+int Start(const char *textfile) {
+  // Start exporting the counters of every drive to a textfile.
+  //
+  // Args:
+  //     textfile (const char *): path to the textfile (e.g. DIR/dvdcc.prom)
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  path = textfile;
+
+  // fail early when the directory cannot take the file
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Write(0) != 0) {
+      printf("dvdcc:metrics:Start() Cannot write %s\n", textfile);
+      path.clear();
+      return -1;
+    }
+  }
+
+  exporter = std::thread(Run);
+  atexit(Stop);
+
+  return 0;
+
+}; // END metrics::Start()
+
+} // namespace metrics
+
+#endif // DVDCC_METRICS_H_
@@ -0,0 +1,614 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_NBD_H_
+#define DVDCC_NBD_H_
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+#include <vector>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/devices.h"
+#include "dvdcc/layout.h"
+#include "dvdcc/reader.h"
+
+// Functions for serving the ISO image of a disc as a read only network
+// block device (NBD) on a local Unix socket. Sectors are read from the
+// drive only when the kernel or another client asks for them.
+//
+// Example with the kernel client:
+//     nbd-client -unix /tmp/disc.sock /dev/nbd0 -readonly
+//     mount -o ro /dev/nbd0 /mnt
+namespace nbd {
+
+// handshake (fixed newstyle negotiation)
+const unsigned long long NBDMAGIC  = 0x4E42444D41474943ULL;
+const unsigned long long IHAVEOPT  = 0x49484156454F5054ULL;
+const unsigned long long REPLYOPT  = 0x0003E889045565A9ULL;
+const unsigned int FLAG_FIXED_NEWSTYLE = 1;
+const unsigned int FLAG_NO_ZEROES      = 2;
+
+// options
+const unsigned int OPT_EXPORT_NAME = 1;
+const unsigned int OPT_ABORT       = 2;
+const unsigned int OPT_LIST        = 3;
+const unsigned int OPT_INFO        = 6;
+const unsigned int OPT_GO          = 7;
+
+// option replies
+const unsigned int REP_ACK        = 1;
+const unsigned int REP_SERVER     = 2;
+const unsigned int REP_INFO       = 3;
+const unsigned int REP_ERR_UNSUP  = 0x80000001;
+const unsigned int INFO_EXPORT     = 0;
+const unsigned int INFO_BLOCK_SIZE = 3;
+
+// transmission
+const unsigned int REQUEST_MAGIC = 0x25609513;
+const unsigned int REPLY_MAGIC   = 0x67446698;
+const unsigned int CMD_READ  = 0;
+const unsigned int CMD_WRITE = 1;
+const unsigned int CMD_DISC  = 2;
+const unsigned int CMD_FLUSH = 3;
+const unsigned int FLAG_HAS_FLAGS  = 1;
+const unsigned int FLAG_READ_ONLY  = 2;
+const unsigned int FLAG_SEND_FLUSH = 4;
+
+// largest read request accepted from a client
+const unsigned int MAX_REQUEST = 32 * 1024 * 1024;
+
+// preferred block size, a power of two as the protocol requires
+const unsigned int PREFERRED_BLOCK = 128 * 1024;
+
+// header of a PATH.present map: magic (8), disc ID (16, zero padded),
+// disc number (1) and reserved bytes, followed by one byte per cache block
+const char STORE_MAGIC[8] = {'D', 'V', 'D', 'C', 'C', 'N', '0', '1'};
+const unsigned int STORE_HEADER = 32;
+
+// set by SIGINT and SIGTERM to stop serving
+volatile sig_atomic_t stopping = 0;
+
+void Stop(int signal_number) {
+  // Signal handler that stops the server.
+  //
+  // Args:
+  //     signal_number (int): signal received
+
+  stopping = 1;
+
+}; // END nbd::Stop()
+
+void Put16(unsigned char *p, unsigned int v) {
+  p[0] = v >> 8; p[1] = v;
+}
+
+void Put32(unsigned char *p, unsigned int v) {
+  for (int i = 0; i < 4; i++) p[i] = v >> (24 - 8 * i);
+}
+
+void Put64(unsigned char *p, unsigned long long v) {
+  for (int i = 0; i < 8; i++) p[i] = v >> (56 - 8 * i);
+}
+
+unsigned int Get16(const unsigned char *p) {
+  return (p[0] << 8) | p[1];
+}
+
+unsigned int Get32(const unsigned char *p) {
+  return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+unsigned long long Get64(const unsigned char *p) {
+  return ((unsigned long long)Get32(p) << 32) | Get32(p + 4);
+}
+
+int ReadAll(int fd, void *data, size_t size) {
+  // Read exactly size bytes from a socket.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail or closed)
+
+  unsigned char *p = (unsigned char *)data;
+
+  while (size > 0) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR && !stopping) continue;
+    if (n <= 0) return -1;
+    p += n;
+    size -= n;
+  }
+
+  return 0;
+
+}; // END nbd::ReadAll()
+
+int WriteAll(int fd, const void *data, size_t size) {
+  // Write exactly size bytes to a socket.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  const unsigned char *p = (const unsigned char *)data;
+
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return -1;
+    p += n;
+    size -= n;
+  }
+
+  return 0;
+
+}; // END nbd::WriteAll()
+
+// Class for a sparse ISO file holding the cache blocks already read from
+// the disc, with a PATH.present map of one byte per cache block, so later
+// reads and later runs are served from disk instead of the drive. The map
+// header names the disc, as discs of one type all have the same size.
+class BackingStore {
+
+ public:
+  BackingStore() : fd(-1), map_fd(-1) {};
+  ~BackingStore() { if (fd >= 0) close(fd); if (map_fd >= 0) close(map_fd); };
+
+  int Open(const char *path, unsigned int sector_number, const std::string &disc_id,
+           unsigned char disc_number);                            // open or create the store
+  bool Has(unsigned int cache_start);                             // true when the block is stored
+  int Read(unsigned int cache_start, unsigned char *data);        // read the user data of a stored block
+  template <class Layout>
+  int Store(unsigned int cache_start, const unsigned char *block, unsigned int count); // store decoded raw sectors
+
+  int fd;                              // sparse ISO file
+  int map_fd;                          // block map file
+  std::vector<unsigned char> present;  // one byte per cache block (1 = stored)
+
+}; // END class BackingStore()
+
+int BackingStore::Open(const char *path, unsigned int sector_number, const std::string &disc_id,
+                       unsigned char disc_number) {
+  // Open the store, creating a sparse ISO sized for the disc when needed.
+  // A map left by another disc of the same size is started over.
+  //
+  // Args:
+  //     path (const char *): path to the sparse ISO
+  //     sector_number (unsigned int): number of disc sectors
+  //     disc_id (const std::string &): Gamecube/Wii disc ID (empty = standard DVD)
+  //     disc_number (unsigned char): Gamecube/Wii disc number
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  std::string map_path = std::string(path) + ".present";
+  unsigned int blocks = (sector_number + constants::SECTORS_PER_CACHE - 1) / constants::SECTORS_PER_CACHE;
+  struct stat st;
+
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  map_fd = open(map_path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0 || map_fd < 0 || fstat(fd, &st) != 0) return -1;
+
+  // a store for another disc size is never reused
+  off_t size = (off_t)sector_number * constants::SECTOR_SIZE;
+  if (st.st_size != 0 && st.st_size != size) {
+    printf("dvdcc:nbd:BackingStore:Open() %s does not match the disc size\n", path);
+    return -1;
+  }
+
+  unsigned char header[STORE_HEADER], stored[STORE_HEADER];
+  memset(header, 0, STORE_HEADER);
+  memcpy(header, STORE_MAGIC, 8);
+  memcpy(header + 8, disc_id.data(), disc_id.size() < 16 ? disc_id.size() : 16);
+  header[24] = disc_number;
+
+  if (fstat(map_fd, &st) != 0) return -1;
+  if (st.st_size != 0 && (st.st_size != (off_t)(STORE_HEADER + blocks) ||
+                          pread(map_fd, stored, STORE_HEADER, 0) != (ssize_t)STORE_HEADER ||
+                          memcmp(stored, header, STORE_HEADER) != 0)) {
+    printf("dvdcc:nbd:BackingStore:Open() %s belongs to another disc, starting it over\n", map_path.c_str());
+    if (ftruncate(map_fd, 0) != 0) return -1;
+  }
+
+  if (ftruncate(fd, size) != 0 || ftruncate(map_fd, STORE_HEADER + blocks) != 0 ||
+      pwrite(map_fd, header, STORE_HEADER, 0) != (ssize_t)STORE_HEADER)
+    return -1;
+
+  present.resize(blocks);
+  if (pread(map_fd, present.data(), blocks, STORE_HEADER) != (ssize_t)blocks) return -1;
+
+  return 0;
+
+}; // END BackingStore::Open()
+
+bool BackingStore::Has(unsigned int cache_start) {
+  // Check whether a cache block is stored.
+  //
+  // Args:
+  //     cache_start (unsigned int): first sector of the block
+
+  return fd >= 0 && present[cache_start / constants::SECTORS_PER_CACHE] == 1;
+
+}; // END BackingStore::Has()
+
+int BackingStore::Read(unsigned int cache_start, unsigned char *data) {
+  // Read the user data of a stored block.
+  //
+  // Args:
+  //     cache_start (unsigned int): first sector of the block
+  //     data (unsigned char *): buffer for SECTORS_PER_CACHE user data sectors
+  //
+  // Returns:
+  //     (int): bytes read (-1 = fail)
+
+  return pread(fd, data, constants::SECTOR_SIZE * constants::SECTORS_PER_CACHE,
+               (off_t)cache_start * constants::SECTOR_SIZE);
+
+}; // END BackingStore::Read()
+
+template <class Layout>
+int BackingStore::Store(unsigned int cache_start, const unsigned char *block, unsigned int count) {
+  // Store the user data of a decoded block, then mark it in the map so a
+  // crash never leaves a marked block without its data.
+  //
+  // Args:
+  //     cache_start (unsigned int): first sector of the block
+  //     block (const unsigned char *): decoded raw sectors
+  //     count (unsigned int): sectors in the block
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  std::vector<unsigned char> data((size_t)count * constants::SECTOR_SIZE);
+  layout::Extract<Layout>(block, count, data.data());
+
+  if (pwrite(fd, data.data(), data.size(), (off_t)cache_start * constants::SECTOR_SIZE) != (ssize_t)data.size() ||
+      fdatasync(fd) != 0)
+    return -1;
+
+  unsigned int i = cache_start / constants::SECTORS_PER_CACHE;
+  present[i] = 1;
+
+  return pwrite(map_fd, &present[i], 1, STORE_HEADER + i) == 1 ? 0 : -1;
+
+}; // END BackingStore::Store()
+
+template <class Layout>
+int ReadImage(DiscReader<Layout> &reader, BackingStore &store, unsigned long long offset,
+              unsigned char *data, unsigned int size) {
+  // Read bytes of the ISO image, from the store when the covering blocks
+  // are stored and otherwise from the disc, storing what was read.
+  //
+  // Args:
+  //     reader (DiscReader<Layout> &): reader of the disc
+  //     store (BackingStore &): sparse ISO (closed = none)
+  //     offset (unsigned long long): byte offset in the ISO image
+  //     data (unsigned char *): buffer for the bytes
+  //     size (unsigned int): number of bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  const unsigned int block_bytes = constants::SECTOR_SIZE * constants::SECTORS_PER_CACHE;
+  std::vector<unsigned char> stored;
+
+  while (size > 0) {
+
+    unsigned int cache_start = offset / block_bytes * constants::SECTORS_PER_CACHE;
+    unsigned int within = offset % block_bytes;
+    unsigned int length = block_bytes - within < size ? block_bytes - within : size;
+
+    if (store.Has(cache_start)) {
+      stored.resize(block_bytes);
+      if (store.Read(cache_start, stored.data()) < (int)(within + length)) return -1;
+      memcpy(data, stored.data() + within, length);
+    } else {
+      if (reader.ReadBytes(offset, data, length) != 0) return -1;
+      if (store.fd >= 0) {
+        unsigned int count = reader.dvd->sector_number - cache_start < constants::SECTORS_PER_CACHE ?
+                             reader.dvd->sector_number - cache_start : constants::SECTORS_PER_CACHE;
+        if (store.Store<Layout>(cache_start, reader.Block(cache_start), count) != 0)
+          printf("dvdcc:nbd:ReadImage() Failed storing block at sector %u\n", cache_start);
+      }
+    }
+
+    data += length;
+    offset += length;
+    size -= length;
+
+  } // END while (size > 0)
+
+  return 0;
+
+}; // END nbd::ReadImage()
+
+int OptionReply(int fd, unsigned int option, unsigned int type, const unsigned char *data, unsigned int length) {
+  // Send a reply to a negotiation option.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char header[20];
+
+  Put64(header, REPLYOPT);
+  Put32(header + 8, option);
+  Put32(header + 12, type);
+  Put32(header + 16, length);
+
+  if (WriteAll(fd, header, 20) != 0) return -1;
+
+  return length ? WriteAll(fd, data, length) : 0;
+
+}; // END nbd::OptionReply()
+
+int Negotiate(int fd, unsigned long long size, bool verbose) {
+  // Run the fixed newstyle handshake until the client picks the export.
+  //
+  // Args:
+  //     fd (int): client socket
+  //     size (unsigned long long): export size in bytes
+  //     verbose (bool): set to true to print more details to stdout
+  //
+  // Returns:
+  //     (int): status (0 = start transmission, -1 = client left)
+
+  const unsigned int flags = FLAG_HAS_FLAGS | FLAG_READ_ONLY | FLAG_SEND_FLUSH;
+  unsigned char buffer[20];
+
+  Put64(buffer, NBDMAGIC);
+  Put64(buffer + 8, IHAVEOPT);
+  Put16(buffer + 16, FLAG_FIXED_NEWSTYLE | FLAG_NO_ZEROES);
+  if (WriteAll(fd, buffer, 18) != 0) return -1;
+
+  if (ReadAll(fd, buffer, 4) != 0) return -1;
+  bool no_zeroes = Get32(buffer) & FLAG_NO_ZEROES;
+
+  while (true) {
+
+    if (ReadAll(fd, buffer, 16) != 0 || Get64(buffer) != IHAVEOPT) return -1;
+
+    unsigned int option = Get32(buffer + 8);
+    unsigned int length = Get32(buffer + 12);
+    if (length > 4096) return -1;
+
+    std::vector<unsigned char> data(length);
+    if (length && ReadAll(fd, data.data(), length) != 0) return -1;
+
+    if (verbose)
+      printf("dvdcc:nbd:Negotiate() Option %u with %u bytes\n", option, length);
+
+    if (option == OPT_EXPORT_NAME) {
+      // the oldest way to pick an export ends negotiation without a reply header
+      unsigned char reply[10 + 124];
+      memset(reply, 0, sizeof(reply));
+      Put64(reply, size);
+      Put16(reply + 8, flags);
+      return WriteAll(fd, reply, no_zeroes ? 10 : sizeof(reply));
+    }
+
+    if (option == OPT_ABORT) {
+      OptionReply(fd, option, REP_ACK, NULL, 0);
+      return -1;
+    }
+
+    if (option == OPT_LIST) {
+      // one unnamed export
+      unsigned char name[4] = {0, 0, 0, 0};
+      if (OptionReply(fd, option, REP_SERVER, name, 4) != 0) return -1;
+      if (OptionReply(fd, option, REP_ACK, NULL, 0) != 0) return -1;
+      continue;
+    }
+
+    if (option == OPT_INFO || option == OPT_GO) {
+      unsigned char info[14];
+      Put16(info, INFO_EXPORT);
+      Put64(info + 2, size);
+      Put16(info + 10, flags);
+      if (OptionReply(fd, option, REP_INFO, info, 12) != 0) return -1;
+      // reads are served per sector and aligned to cache blocks internally
+      Put16(info, INFO_BLOCK_SIZE);
+      Put32(info + 2, 1);
+      Put32(info + 6, PREFERRED_BLOCK);
+      Put32(info + 10, MAX_REQUEST);
+      if (OptionReply(fd, option, REP_INFO, info, 14) != 0) return -1;
+      if (OptionReply(fd, option, REP_ACK, NULL, 0) != 0) return -1;
+      if (option == OPT_GO) return 0;
+      continue;
+    }
+
+    if (OptionReply(fd, option, REP_ERR_UNSUP, NULL, 0) != 0) return -1;
+
+  } // END while (true)
+
+}; // END nbd::Negotiate()
+
+template <class Layout>
+int Transmit(int fd, DiscReader<Layout> &reader, BackingStore &store, unsigned long long size, bool verbose) {
+  // Answer client requests until the client disconnects.
+  //
+  // Args:
+  //     fd (int): client socket
+  //     reader (DiscReader<Layout> &): reader of the disc
+  //     store (BackingStore &): sparse ISO (closed = none)
+  //     size (unsigned long long): export size in bytes
+  //     verbose (bool): set to true to print more details to stdout
+  //
+  // Returns:
+  //     (int): status (0 = client disconnected, -1 = connection failed)
+
+  unsigned char request[28], reply[16];
+  std::vector<unsigned char> data;
+
+  while (!stopping) {
+
+    if (ReadAll(fd, request, 28) != 0 || Get32(request) != REQUEST_MAGIC) return -1;
+
+    unsigned int type = Get16(request + 6);
+    unsigned long long offset = Get64(request + 16);
+    unsigned int length = Get32(request + 24);
+    unsigned int error = 0;
+
+    // the handle is echoed back unchanged
+    Put32(reply, REPLY_MAGIC);
+    memcpy(reply + 8, request + 8, 8);
+
+    if (type == CMD_DISC) return 0;
+
+    if (type == CMD_READ) {
+      // compared without offset + length, which wraps for offsets near 2^64
+      if (length > MAX_REQUEST || offset > size || length > size - offset) {
+        error = EINVAL;
+      } else {
+        data.resize(length);
+        if (ReadImage(reader, store, offset, data.data(), length) != 0) error = EIO;
+      }
+      if (verbose)
+        printf("dvdcc:nbd:Transmit() Read %u bytes at 0x%llx%s\n", length, offset, error ? " failed" : "");
+    } else if (type == CMD_FLUSH) {
+      error = 0;
+    } else {
+      // writes, trims and anything else on a read only export
+      error = type == CMD_WRITE ? EPERM : EINVAL;
+      // a write carries its data, which must be drained
+      if (type == CMD_WRITE) {
+        if (length > MAX_REQUEST) return -1;
+        data.resize(length);
+        if (ReadAll(fd, data.data(), length) != 0) return -1;
+      }
+    }
+
+    Put32(reply + 4, error);
+    if (WriteAll(fd, reply, 16) != 0) return -1;
+    if (type == CMD_READ && error == 0 && WriteAll(fd, data.data(), length) != 0) return -1;
+
+  } // END while (!stopping)
+
+  return 0;
+
+}; // END nbd::Transmit()
+
+template <class Layout>
+void Listen(int server, Dvd &dvd, BackingStore &store, unsigned long long size, bool verbose) {
+  // Accept clients one at a time until interrupted. Clients are served
+  // through one DiscReader, so cached blocks are shared between
+  // connections.
+  //
+  // Args:
+  //     server (int): listening Unix socket
+  //     dvd (Dvd &): drive with keys found
+  //     store (BackingStore &): sparse ISO (closed = none)
+  //     size (unsigned long long): export size in bytes
+  //     verbose (bool): set to true to print more details to stdout
+
+  DiscReader<Layout> reader(&dvd, 64, 4, verbose);
+
+  while (!stopping) {
+
+    int client = accept(server, NULL, NULL);
+    if (client < 0) continue;
+
+    printf("Client connected.\n");
+
+    if (Negotiate(client, size, verbose) == 0)
+      Transmit(client, reader, store, size, verbose);
+
+    close(client);
+
+    printf("Client disconnected (%llu cache hits, %llu drive reads, %llu read ahead).\n",
+           reader.hits, reader.misses, reader.prefetched);
+
+  } // END while (!stopping)
+
+}; // END nbd::Listen()
+
+int Serve(Dvd &dvd, const char *socket_path, const char *store_path, bool verbose) {
+  // Serve the ISO image of the disc on a Unix socket until interrupted.
+  //
+  // Args:
+  //     dvd (Dvd &): drive with keys found
+  //     socket_path (const char *): path of the Unix socket
+  //     store_path (const char *): sparse ISO for blocks already read (NULL = none)
+  //     verbose (bool): set to true to print more details to stdout
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = fail)
+
+  unsigned long long size = (unsigned long long)dvd.sector_number * constants::SECTOR_SIZE;
+
+  BackingStore store;
+
+  if (store_path) {
+    if (store.Open(store_path, dvd.sector_number, dvd.disc_id, dvd.disc_number) != 0) {
+      printf("dvdcc:nbd:Serve() Cannot open %s\n", store_path);
+      return 1;
+    }
+    unsigned int stored = 0;
+    for (unsigned int i = 0; i < store.present.size(); i++) stored += store.present[i];
+    printf(" Store path: %s (%u of %zu blocks stored)\n", store_path, stored, store.present.size());
+  }
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    printf("dvdcc:nbd:Serve() Socket path %s is too long\n", socket_path);
+    return 1;
+  }
+  strcpy(address.sun_path, socket_path);
+
+  // replace a socket left by an earlier run, but never another file
+  struct stat st;
+  if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socket_path);
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0 || bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server, 1) != 0) {
+    printf("dvdcc:nbd:Serve() Cannot listen on %s\n", socket_path);
+    if (server >= 0) close(server);
+    return 1;
+  }
+
+  // interrupt accept() and reads instead of restarting them
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = Stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("Serving %llu bytes on %s. Press Ctrl+C to stop.\n\n", size, socket_path);
+
+  layout::Select(dvd.dvd_rom, [&](auto disc) { Listen<decltype(disc)>(server, dvd, store, size, verbose); });
+
+  close(server);
+  unlink(socket_path);
+
+  printf("\nStopped.\n");
+
+  return 0;
+
+}; // END nbd::Serve()
+
+} // namespace nbd
+
+#endif // DVDCC_NBD_H_
@@ -26,26 +26,106 @@
 #include <string.h>
 #include <getopt.h>
 
+#include <vector>
+
 // Class for parsing command line options
 class Options {
  public:
   Options()
-    : load(0), eject(0), resume(0), timeout(100), verbose(0), iso(NULL), raw(NULL), device_path(NULL) {};
-  ~Options() { free(iso); free(raw); free(device_path); };
+    : load(0), eject(0), resume(0), timeout(100), verbose(0), speed(0), adaptive_speed(0), compress(0), elide_junk(0), selective(0),
+      raw_sidecar(0), scramble(0), hash(0), keep_going(0), block_index(0), shard(0), trace_compact(0), replay_timing(0), start_sector(0), end_sector(0), scan_stride(10), iso(NULL), raw(NULL), device_path(NULL), fill_junk(NULL), build_raw(NULL),
+      from_raw(NULL), verify(NULL), repair(NULL), daemon_dir(NULL), nbd(NULL), nbd_store(NULL), trace(NULL), replay(NULL), metrics(NULL), scan(NULL), dedup(NULL), from_manifest(NULL), catalog(NULL), catalog_index(NULL) {};
+  ~Options() { free(iso); free(raw); free(device_path); free(fill_junk); free(build_raw); free(from_raw); free(verify); free(repair); free(daemon_dir); free(nbd); free(nbd_store); free(trace); free(replay); free(metrics); free(scan); free(dedup); free(from_manifest); free(catalog); free(catalog_index);
+              for (unsigned int i = 0; i < devices.size(); i++) free(devices[i]); };
 
   void Parse(int argc, char **argv);
   void DisplayHelp(void) {
     printf("Usage: dvdcc --device DEVICE [--eject --load ...]\n"
            "Operate a DVD drive using SCSI commands.\n\n"
            "Command line options:\n"
-           "  -d, --device      path to the device (example: /dev/sr0)\n"
+           "  -d, --device      path to the device (example: /dev/sr0), repeat to back up\n"
+           "                    several drives at once (outputs get the device name,\n"
+           "                    example: game.sr0.iso)\n"
            "      --eject       eject the disc\n"
            "      --load        load the disc\n"
            "  -i, --iso         create ISO backup\n"
            "  -r, --raw         create RAW backup\n"
+           "                    (use - for stdout or a named pipe path to stream the backup)\n"
+           "      --compress    write ISO/RAW backups as chunked zlib images with a\n"
+           "                    random access index (compressed on all cores)\n"
+           "      --elide-junk  leave Gamecube/Wii junk padding as holes in the ISO backup\n"
+           "                    and list it in a PATH.junk map (ISO path + .junk)\n"
+           "      --selective   only read Gamecube/Wii sectors used by the file system or\n"
+           "                    partitions, leaving unused sectors as holes\n"
+           "      --fill-junk   rebuild a byte exact ISO by regenerating the junk listed\n"
+           "                    in its .junk map (no device needed)\n"
+           "      --hash        compute CRC32, MD5 and SHA-1 of the ISO/RAW backups while\n"
+           "                    writing them (saved to PATH.hashes, resumable)\n"
+           "      --block-index write a SHA-1 per cache block of the ISO backup to\n"
+           "                    PATH.blocks (ISO path + .blocks) for fast verification\n"
+           "      --verify      compare the disc against an archived ISO, using its\n"
+           "                    .blocks index when present, without writing output\n"
+           "      --keep-going  with --verify log every divergent block instead of\n"
+           "                    stopping at the first\n"
+           "      --repair      re-read only the sectors of an existing RAW backup that\n"
+           "                    fail EDC and patch them in place (and in the --iso file)\n"
+           "      --raw-sidecar store the non-payload bytes of each raw sector in a\n"
+           "                    PATH.sidecar next to the ISO backup (ISO path + .sidecar)\n"
+           "                    instead of writing a full RAW backup\n"
+           "      --build-raw   rebuild a RAW backup at the --raw path from an ISO and its\n"
+           "                    .sidecar (no device needed, fill elided junk first)\n"
+           "      --scramble    with --build-raw re-apply the disc scrambling to the sectors\n"
+           "      --from-raw    decode and verify a RAW image on all cores, writing the\n"
+           "                    ISO to the --iso path when given (no device needed)\n"
+           "      --daemon      keep running and back up every disc inserted into the\n"
+           "                    --device drives as DIR/GAMEID.iso, ejecting each disc\n"
+           "                    when done and logging jobs to DIR/dvdcc-jobs.log\n"
+           "      --nbd         serve the disc as a read only network block device on\n"
+           "                    the given Unix socket, reading sectors on demand\n"
+           "      --nbd-store   with --nbd keep sectors read from the disc in a sparse\n"
+           "                    ISO at this path (PATH.present lists stored blocks)\n"
+           "      --start-sector\n"
+           "                    first sector to back up, earlier sectors are left as\n"
+           "                    holes so ranges can be combined in one image\n"
+           "      --end-sector  back up sectors before this one (default: end of disc)\n"
+           "      --shard       with several --device drives holding the same disc,\n"
+           "                    split the sectors between them and write one image\n"
+           "      --trace       record every command sent to the drive and its result\n"
+           "                    in a binary trace at this path\n"
+           "      --trace-compact\n"
+           "                    with --trace store a CRC32 and the first bytes of large\n"
+           "                    buffers instead of the sectors read (cannot be replayed)\n"
+           "      --replay      answer commands from a recorded trace instead of the\n"
+           "                    drive (no device needed)\n"
+           "      --replay-timing\n"
+           "                    with --replay take as long as the drive did for each\n"
+           "                    command instead of running at full speed\n"
+           "      --metrics     export per drive sectors, bytes, retries, EDC failures,\n"
+           "                    throughput and standby waits to a Prometheus textfile\n"
+           "                    at this path, rewritten every 5 seconds\n"
+           "      --scan        read only surface scan that samples cache blocks and writes\n"
+           "                    read rates, EDC failures, retries and sense codes per zone\n"
+           "                    to this CSV (or .json) path with a predicted backup time\n"
+           "      --scan-stride with --scan read one cache block in every N (default: 10,\n"
+           "                    1 = whole disc)\n"
+           "      --dedup       save the ISO backup to a shared store in this directory,\n"
+           "                    writing each unique 32 KB cluster once and the image as\n"
+           "                    a PATH.manifest of cluster hashes (ISO path + .manifest)\n"
+           "      --from-manifest\n"
+           "                    rebuild the ISO at the --iso path from a manifest and the\n"
+           "                    --dedup store (no device needed)\n"
+           "      --catalog     index the ISO, RAW and compressed images below this\n"
+           "                    directory from their headers on all cores (no device needed)\n"
+           "      --catalog-index\n"
+           "                    with --catalog write the sorted index to this CSV (or .json)\n"
+           "                    path (default: DIR/dvdcc-catalog.csv)\n"
            "  -t, --timeout     command timeout in clock cycles\n"
            "                    (example: 100 = 1 second on systems where `getconf CLK_TCK` = 100)\n"
            "      --resume      resume disc backup to existing file(s)\n"
+           "  -s, --speed       read speed as a DVD multiple (example: 4 = 4x, default: maximum)\n"
+           "      --adaptive-speed\n"
+           "                    lower the read speed when EDC failures cluster and\n"
+           "                    raise it again once reads are clean\n"
            "      --verbose     print full command details\n"
            "      --help        display this help and exit\n");
   };
@@ -55,10 +135,45 @@ class Options {
   int resume;
   int timeout;
   int verbose;
+  int speed;
+  int adaptive_speed;
+  int compress;
+  int elide_junk;
+  int selective;
+  int raw_sidecar;
+  int scramble;
+  int hash;
+  int keep_going;
+  int block_index;
+  int shard;
+  int trace_compact;
+  int replay_timing;
+
+  unsigned int start_sector;  // first sector to back up
+  unsigned int end_sector;    // sector after the last to back up (0 = end of disc)
+  unsigned int scan_stride;   // read one cache block in this many when scanning
 
   char *iso;
   char *raw;
   char *device_path;
+  char *fill_junk;
+  char *build_raw;
+  char *from_raw;
+  char *verify;
+  char *repair;
+  char *daemon_dir;
+  char *nbd;
+  char *nbd_store;
+  char *trace;
+  char *replay;
+  char *metrics;
+  char *scan;
+  char *dedup;
+  char *from_manifest;
+  char *catalog;
+  char *catalog_index;
+
+  std::vector<char *> devices;  // every --device in order, the first is device_path
 
 }; // END class Options()
 
@@ -79,19 +194,51 @@ void Options::Parse(int argc, char **argv) {
   while (1) {
 
     static struct option long_options[] = {
-      {"help",    no_argument,       0,        'h'},
-      {"device",  required_argument, 0,        'd'},
-      {"eject",   no_argument,       &eject,   1},
-      {"load",    no_argument,       &load,    1},
-      {"iso",     required_argument, 0,        'i'},
-      {"raw",     required_argument, 0,        'r'},
-      {"resume",  no_argument,       &resume,  1},
-      {"timeout", required_argument, 0,        't'},
-      {"verbose", no_argument,       &verbose, 1},
+      {"help",           no_argument,       0,               'h'},
+      {"device",         required_argument, 0,               'd'},
+      {"eject",          no_argument,       &eject,          1},
+      {"load",           no_argument,       &load,           1},
+      {"iso",            required_argument, 0,               'i'},
+      {"raw",            required_argument, 0,               'r'},
+      {"resume",         no_argument,       &resume,         1},
+      {"timeout",        required_argument, 0,               't'},
+      {"verbose",        no_argument,       &verbose,        1},
+      {"speed",          required_argument, 0,               's'},
+      {"adaptive-speed", no_argument,       &adaptive_speed, 1},
+      {"compress",       no_argument,       &compress,       1},
+      {"elide-junk",     no_argument,       &elide_junk,     1},
+      {"selective",      no_argument,       &selective,      1},
+      {"fill-junk",      required_argument, 0,               'J'},
+      {"hash",           no_argument,       &hash,           1},
+      {"block-index",    no_argument,       &block_index,    1},
+      {"verify",         required_argument, 0,               'V'},
+      {"keep-going",     no_argument,       &keep_going,     1},
+      {"repair",         required_argument, 0,               'P'},
+      {"raw-sidecar",    no_argument,       &raw_sidecar,    1},
+      {"build-raw",      required_argument, 0,               'B'},
+      {"from-raw",       required_argument, 0,               'F'},
+      {"scramble",       no_argument,       &scramble,       1},
+      {"daemon",         required_argument, 0,               'W'},
+      {"start-sector",   required_argument, 0,               'S'},
+      {"end-sector",     required_argument, 0,               'E'},
+      {"shard",          no_argument,       &shard,          1},
+      {"nbd",            required_argument, 0,               'N'},
+      {"nbd-store",      required_argument, 0,               'K'},
+      {"trace",          required_argument, 0,               'T'},
+      {"trace-compact",  no_argument,       &trace_compact,  1},
+      {"replay",         required_argument, 0,               'Y'},
+      {"replay-timing",  no_argument,       &replay_timing,  1},
+      {"metrics",        required_argument, 0,               'M'},
+      {"scan",           required_argument, 0,               'C'},
+      {"scan-stride",    required_argument, 0,               'R'},
+      {"dedup",          required_argument, 0,               'D'},
+      {"from-manifest",  required_argument, 0,               'U'},
+      {"catalog",        required_argument, 0,               'L'},
+      {"catalog-index",  required_argument, 0,               'X'},
       {0, 0, 0, 0}
     };
 
-    int c = getopt_long(argc, argv, "hd:i:r:t:", long_options, NULL);
+    int c = getopt_long(argc, argv, "hd:i:r:t:s:", long_options, NULL);
 
     if (c == -1)
       break;
@@ -109,7 +256,8 @@ void Options::Parse(int argc, char **argv) {
         break;
 
       case 'd':
-        device_path = strdup(optarg);
+        if (device_path == NULL) device_path = strdup(optarg);
+        devices.push_back(strdup(optarg));
         break;
 
       case 'i':
@@ -124,6 +272,86 @@ void Options::Parse(int argc, char **argv) {
         timeout = atoi(optarg);
         break;
 
+      case 's':
+        speed = atoi(optarg);
+        break;
+
+      case 'J':
+        fill_junk = strdup(optarg);
+        break;
+
+      case 'B':
+        build_raw = strdup(optarg);
+        break;
+
+      case 'F':
+        from_raw = strdup(optarg);
+        break;
+
+      case 'V':
+        verify = strdup(optarg);
+        break;
+
+      case 'P':
+        repair = strdup(optarg);
+        break;
+
+      case 'W':
+        daemon_dir = strdup(optarg);
+        break;
+
+      case 'N':
+        nbd = strdup(optarg);
+        break;
+
+      case 'K':
+        nbd_store = strdup(optarg);
+        break;
+
+      case 'T':
+        trace = strdup(optarg);
+        break;
+
+      case 'Y':
+        replay = strdup(optarg);
+        break;
+
+      case 'M':
+        metrics = strdup(optarg);
+        break;
+
+      case 'C':
+        scan = strdup(optarg);
+        break;
+
+      case 'R':
+        scan_stride = strtoul(optarg, NULL, 0);
+        break;
+
+      case 'D':
+        dedup = strdup(optarg);
+        break;
+
+      case 'U':
+        from_manifest = strdup(optarg);
+        break;
+
+      case 'L':
+        catalog = strdup(optarg);
+        break;
+
+      case 'X':
+        catalog_index = strdup(optarg);
+        break;
+
+      case 'S':
+        start_sector = strtoul(optarg, NULL, 0);
+        break;
+
+      case 'E':
+        end_sector = strtoul(optarg, NULL, 0);
+        break;
+
       case '?':
         exit(1);
         break;
@@ -134,12 +362,28 @@ void Options::Parse(int argc, char **argv) {
     } // END switch (c)
   } // END while (1)
 
-  if (device_path == NULL) {
+  // offline modes work on existing images without a drive
+  bool offline = fill_junk != NULL || build_raw != NULL || from_raw != NULL || from_manifest != NULL ||
+                 catalog != NULL;
+
+  // a replayed trace stands in for the drive
+  if (replay && device_path == NULL) {
+    device_path = strdup(replay);
+    devices.push_back(strdup(replay));
+  }
+
+  if (device_path == NULL && !offline) {
     printf("dvdcc:options:Options:Parse() User must specific device path with --device.\n");
     printf("dvdcc:options:Options:Parse() Exiting...\n");
     exit(1);
   }
 
+  if (end_sector != 0 && end_sector <= start_sector) {
+    printf("dvdcc:options:Options:Parse() --end-sector must be greater than --start-sector.\n");
+    printf("dvdcc:options:Options:Parse() Exiting...\n");
+    exit(1);
+  }
+
   return;
 
 }; // END Options::Parse()
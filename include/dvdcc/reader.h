@@ -0,0 +1,430 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_READER_H_
+#define DVDCC_READER_H_
+
+#include <stdio.h>
+#include <string.h>
+
+#include <list>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/devices.h"
+#include "dvdcc/layout.h"
+#include "dvdcc/async.h"
+
+// Class for random access to decoded disc sectors. Requests are mapped
+// to whole cache blocks, which are read, decoded and verified once and
+// kept in a least recently used cache. When requests walk the disc in
+// order, the following blocks are queued on the drive's I/O thread while
+// the caller works on the current one, and dropped again when the caller
+// jumps elsewhere before they reach the drive.
+//
+// Keys must be found with Dvd::FindKeys() first. The drive must not be
+// used by anything else while the reader is in use. Layout is the
+// sector layout of the disc (layout::DvdRom or layout::GameDisc).
+template <class Layout>
+class DiscReader {
+
+ public:
+  DiscReader(Dvd *dvd, unsigned int capacity = 32, unsigned int read_ahead = 2, bool verbose = false);
+  ~DiscReader();
+
+  const unsigned char *Block(unsigned int cache_start);                       // decoded raw sectors of a cache block
+  int Read(unsigned int lba, unsigned int count, unsigned char *data);        // read user data sectors
+  int ReadRaw(unsigned int lba, unsigned int count, unsigned char *raw);      // read decoded raw sectors
+  int ReadBytes(unsigned long long offset, unsigned char *data, size_t size); // read user data at a byte offset
+
+  // Class for reading sectors one after another from a starting sector.
+  class Cursor {
+   public:
+    Cursor(DiscReader *reader, unsigned int lba) : reader(reader), lba(lba) {};
+    int Next(unsigned char *data);   // read the next user data sector (-1 = fail or end of disc)
+    DiscReader *reader;              // reader serving the sectors
+    unsigned int lba;                // next sector
+  }; // END class DiscReader::Cursor()
+
+  Cursor Sequential(unsigned int lba) { return Cursor(this, lba); };  // iterate from a sector
+
+  // cache block of decoded raw sectors
+  struct Entry {
+    unsigned int cache_start;
+    std::vector<unsigned char> data;
+  };
+
+  Dvd *dvd;                      // drive with keys found
+  unsigned int capacity;         // cache blocks kept in memory (more than read_ahead)
+  unsigned int read_ahead;       // blocks read ahead of sequential requests (0 = none)
+  unsigned int retries;          // reads per block before giving up
+  bool verbose;                  // print command details when true
+
+  unsigned long long hits;       // requests served from the cache
+  unsigned long long misses;     // requests read from the drive
+  unsigned long long prefetched; // blocks read ahead
+
+  unsigned int last;             // last requested cache block (UINT_MAX = none)
+  unsigned int streak;           // consecutive sequential block requests
+
+  std::list<Entry> lru;                                                       // most recently used first
+  std::unordered_map<unsigned int, typename std::list<Entry>::iterator> index; // cache_start to entry
+
+  // cache block being read ahead
+  struct Ahead {
+    std::shared_ptr<Entry> entry;
+    AsyncDvd::Operation operation;
+  };
+
+  AsyncDvd io;                                                       // I/O thread serving every read
+  std::deque<Ahead> ahead;                                           // blocks being read ahead, in order
+
+  Entry *Insert(Entry entry);                                        // add a block, evicting the oldest
+  Entry Fill(unsigned int cache_start);                              // read, decode and verify a block
+  void Prefetch(unsigned int cache_start);                           // queue a block to read ahead
+  bool Queued(unsigned int cache_start);                             // true when a block is being read ahead
+  void Collect(unsigned int wanted);                                 // add finished read ahead blocks
+  void Cancel(void);                                                 // drop read ahead blocks not started
+
+}; // END class DiscReader()
+
+template <class Layout>
+DiscReader<Layout>::DiscReader(Dvd *dvd, unsigned int capacity, unsigned int read_ahead, bool verbose)
+    : dvd(dvd), capacity(capacity > read_ahead ? capacity : read_ahead + 1), read_ahead(read_ahead), retries(20), verbose(verbose),
+      hits(0), misses(0), prefetched(0), last(0xFFFFFFFF), streak(0), io(dvd, verbose) {
+  // Constructor for a reader of a drive with keys found.
+  //
+  // Args:
+  //     dvd (Dvd *): drive with keys found
+  //     capacity (unsigned int): cache blocks kept in memory (default: 32, about 5 MB)
+  //     read_ahead (unsigned int): blocks read ahead of sequential requests (default: 2)
+  //     verbose (bool): when true print command details (default: false)
+
+}; // END DiscReader::DiscReader()
+
+template <class Layout>
+DiscReader<Layout>::~DiscReader() {
+  // Destructor that drops queued read ahead blocks and waits for the one
+  // at the drive.
+
+  Cancel();
+
+}; // END DiscReader::~DiscReader()
+
+template <class Layout>
+typename DiscReader<Layout>::Entry DiscReader<Layout>::Fill(unsigned int cache_start) {
+  // Read, decode and verify a cache block.
+  //
+  // Args:
+  //     cache_start (unsigned int): first sector of the block
+  //
+  // Returns:
+  //     (Entry): decoded block (empty data = cannot read the block)
+
+  Entry entry;
+  entry.cache_start = cache_start;
+  entry.data.resize(constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE);
+
+  unsigned char *data = entry.data.data();
+  if (io.Submit([this, cache_start, data]() { return dvd->ReadCacheBlock<Layout>(cache_start, data, retries, verbose); }).Wait() != 0)
+    entry.data.clear();
+
+  return entry;
+
+}; // END DiscReader::Fill()
+
+template <class Layout>
+void DiscReader<Layout>::Prefetch(unsigned int cache_start) {
+  // Queue a cache block to be read, decoded and verified on the I/O thread.
+  //
+  // Args:
+  //     cache_start (unsigned int): first sector of the block
+
+  Ahead block;
+  block.entry = std::make_shared<Entry>();
+  block.entry->cache_start = cache_start;
+  block.entry->data.resize(constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE);
+
+  // the entry is shared with the command so it outlives a dropped reader
+  std::shared_ptr<Entry> entry = block.entry;
+  block.operation = io.Submit([this, entry]() {
+    return dvd->ReadCacheBlock<Layout>(entry->cache_start, entry->data.data(), retries, verbose);
+  });
+
+  ahead.push_back(block);
+
+}; // END DiscReader::Prefetch()
+
+template <class Layout>
+bool DiscReader<Layout>::Queued(unsigned int cache_start) {
+  // Check whether a cache block is being read ahead.
+  //
+  // Args:
+  //     cache_start (unsigned int): first sector of the block
+
+  for (unsigned int i = 0; i < ahead.size(); i++)
+    if (ahead[i].entry->cache_start == cache_start) return true;
+
+  return false;
+
+}; // END DiscReader::Queued()
+
+template <class Layout>
+typename DiscReader<Layout>::Entry *DiscReader<Layout>::Insert(Entry entry) {
+  // Add a decoded block to the front of the cache, evicting the least
+  // recently used blocks when full.
+  //
+  // Args:
+  //     entry (Entry): decoded block
+  //
+  // Returns:
+  //     (Entry *): cached block
+
+  auto found = index.find(entry.cache_start);
+  if (found != index.end()) {
+    lru.erase(found->second);
+    index.erase(found);
+  }
+
+  while (lru.size() >= capacity) {
+    index.erase(lru.back().cache_start);
+    lru.pop_back();
+  }
+
+  lru.push_front(std::move(entry));
+  index[lru.front().cache_start] = lru.begin();
+
+  return &lru.front();
+
+}; // END DiscReader::Insert()
+
+template <class Layout>
+void DiscReader<Layout>::Collect(unsigned int wanted) {
+  // Add read ahead blocks to the cache in order, waiting for them up to
+  // and including a wanted block.
+  //
+  // Args:
+  //     wanted (unsigned int): block to wait for (UINT_MAX = only take finished blocks)
+
+  bool waiting = false;
+  for (unsigned int i = 0; i < ahead.size(); i++)
+    if (ahead[i].entry->cache_start == wanted) waiting = true;
+
+  while (!ahead.empty() && (waiting || ahead.front().operation.Ready())) {
+
+    Ahead block = ahead.front();
+    ahead.pop_front();
+
+    if (block.operation.Wait() == 0) {
+      Insert(std::move(*block.entry));
+      prefetched++;
+    }
+
+    if (block.entry->cache_start == wanted) waiting = false;
+
+  } // END while (!ahead.empty() ...)
+
+}; // END DiscReader::Collect()
+
+template <class Layout>
+void DiscReader<Layout>::Cancel(void) {
+  // Drop read ahead blocks that have not reached the drive and collect
+  // the one being read.
+
+  for (unsigned int i = 0; i < ahead.size(); i++)
+    ahead[i].operation.Cancel();
+
+  while (!ahead.empty()) {
+    if (ahead.front().operation.Wait() == 0) {
+      Insert(std::move(*ahead.front().entry));
+      prefetched++;
+    }
+    ahead.pop_front();
+  }
+
+}; // END DiscReader::Cancel()
+
+template <class Layout>
+const unsigned char *DiscReader<Layout>::Block(unsigned int cache_start) {
+  // Get the decoded raw sectors of a cache block, reading it from the
+  // drive when it is not cached. Sequential requests start reading the
+  // following blocks in the background. The returned sectors stay valid
+  // until the next call.
+  //
+  // Args:
+  //     cache_start (unsigned int): first sector of the block (multiple of SECTORS_PER_CACHE)
+  //
+  // Returns:
+  //     (const unsigned char *): SECTORS_PER_CACHE decoded raw sectors (NULL = cannot read)
+
+  if (cache_start >= dvd->sector_number) return NULL;
+
+  // repeated requests for the same block neither count as sequential nor break a streak
+  bool moved = cache_start != last;
+  if (moved) {
+    streak = cache_start == last + constants::SECTORS_PER_CACHE ? streak + 1 : 0;
+    last = cache_start;
+  }
+
+  auto found = index.find(cache_start);
+
+  if (found != index.end()) {
+    hits++;
+    lru.splice(lru.begin(), lru, found->second);
+    // only take finished read ahead blocks so the caller never waits on the drive
+    Collect(0xFFFFFFFF);
+  } else {
+    // wait when the block is on its way, otherwise the read ahead is no longer wanted
+    if (Queued(cache_start)) Collect(cache_start);
+    else Cancel();
+    if (index.find(cache_start) != index.end()) {
+      hits++;
+      lru.splice(lru.begin(), lru, index[cache_start]);
+    } else {
+      misses++;
+      Entry filled = Fill(cache_start);
+      if (filled.data.empty()) {
+        printf("dvdcc:reader:DiscReader:Block() Cannot read block at sector %u\n", cache_start);
+        return NULL;
+      }
+      Insert(std::move(filled));
+    }
+  } // END if/else (found ...)
+
+  // once two blocks in a row were requested in order, keep the blocks
+  // following the request queued so the drive never waits for the caller
+  if (read_ahead && moved && streak >= 1) {
+    for (unsigned int n = 1; n <= read_ahead; n++) {
+      unsigned int next = cache_start + n * constants::SECTORS_PER_CACHE;
+      if (next < dvd->sector_number && index.find(next) == index.end() && !Queued(next)) Prefetch(next);
+    }
+  } // END if (read_ahead ...)
+
+  return index[cache_start]->data.data();
+
+}; // END DiscReader::Block()
+
+template <class Layout>
+int DiscReader<Layout>::ReadRaw(unsigned int lba, unsigned int count, unsigned char *raw) {
+  // Read decoded raw sectors.
+  //
+  // Args:
+  //     lba (unsigned int): first sector
+  //     count (unsigned int): number of sectors
+  //     raw (unsigned char *): buffer for count * RAW_SECTOR_SIZE bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  while (count > 0) {
+
+    unsigned int cache_start = lba / constants::SECTORS_PER_CACHE * constants::SECTORS_PER_CACHE;
+    unsigned int n = cache_start + constants::SECTORS_PER_CACHE - lba;
+    if (n > count) n = count;
+
+    const unsigned char *block = Block(cache_start);
+    if (block == NULL || lba + n > dvd->sector_number) return -1;
+
+    memcpy(raw, block + (lba - cache_start) * constants::RAW_SECTOR_SIZE, (size_t)n * constants::RAW_SECTOR_SIZE);
+
+    raw += (size_t)n * constants::RAW_SECTOR_SIZE;
+    lba += n;
+    count -= n;
+
+  } // END while (count > 0)
+
+  return 0;
+
+}; // END DiscReader::ReadRaw()
+
+template <class Layout>
+int DiscReader<Layout>::Read(unsigned int lba, unsigned int count, unsigned char *data) {
+  // Read user data sectors, the 2048 bytes at the payload offset of the
+  // layout as stored in ISO backups.
+  //
+  // Args:
+  //     lba (unsigned int): first sector
+  //     count (unsigned int): number of sectors
+  //     data (unsigned char *): buffer for count * SECTOR_SIZE bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  return ReadBytes((unsigned long long)lba * constants::SECTOR_SIZE, data, (size_t)count * constants::SECTOR_SIZE);
+
+}; // END DiscReader::Read()
+
+template <class Layout>
+int DiscReader<Layout>::ReadBytes(unsigned long long offset, unsigned char *data, size_t size) {
+  // Read user data at a byte offset of the ISO image.
+  //
+  // Args:
+  //     offset (unsigned long long): byte offset of the user data
+  //     data (unsigned char *): buffer for the user data
+  //     size (size_t): number of bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  while (size > 0) {
+
+    unsigned int sector = offset / constants::SECTOR_SIZE;
+    unsigned int within = offset % constants::SECTOR_SIZE;
+    unsigned int cache_start = sector / constants::SECTORS_PER_CACHE * constants::SECTORS_PER_CACHE;
+
+    if (sector >= dvd->sector_number) return -1;
+
+    const unsigned char *block = Block(cache_start);
+    if (block == NULL) return -1;
+
+    // copy the rest of the block in one pass of sectors
+    for (; sector < cache_start + constants::SECTORS_PER_CACHE && sector < dvd->sector_number && size > 0; sector++) {
+      const unsigned char *raw_sector = block + (sector - cache_start) * constants::RAW_SECTOR_SIZE;
+      size_t length = constants::SECTOR_SIZE - within < size ? constants::SECTOR_SIZE - within : size;
+      memcpy(data, layout::Payload<Layout>(raw_sector) + within, length);
+      data += length;
+      offset += length;
+      size -= length;
+      within = 0;
+    }
+
+  } // END while (size > 0)
+
+  return 0;
+
+}; // END DiscReader::ReadBytes()
+
+template <class Layout>
+int DiscReader<Layout>::Cursor::Next(unsigned char *data) {
+  // Read the next user data sector.
+  //
+  // Args:
+  //     data (unsigned char *): buffer for SECTOR_SIZE bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail or end of disc)
+
+  if (reader->Read(lba, 1, data) != 0) return -1;
+  lba++;
+
+  return 0;
+
+}; // END DiscReader::Cursor::Next()
+
+#endif // DVDCC_READER_H_
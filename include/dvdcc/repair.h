@@ -0,0 +1,183 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_REPAIR_H_
+#define DVDCC_REPAIR_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <vector>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/devices.h"
+#include "dvdcc/keys.h"
+#include "dvdcc/layout.h"
+#include "dvdcc/progress.h"
+#include "dvdcc/convert.h"
+
+// Functions for repairing existing backups in place.
+namespace repair {
+
+bool IsScrambled(const unsigned char *image, unsigned int sector_number) {
+  // Check whether a RAW image holds scrambled sectors. Images written by
+  // dvdcc are descrambled, so at least one of the first sectors verifies
+  // as stored. Checking several sectors tolerates a damaged first sector.
+  //
+  // Args:
+  //     image (const unsigned char *): mapped RAW image
+  //     sector_number (unsigned int): number of sectors in the image
+  //
+  // Returns:
+  //     (bool): true when no early sector verifies as stored
+
+  unsigned char raw_sector[constants::RAW_SECTOR_SIZE];
+
+  for (unsigned int sector = 0; sector < constants::SECTORS_PER_BLOCK && sector < sector_number; sector++) {
+    memcpy(raw_sector, image + (size_t)sector * constants::RAW_SECTOR_SIZE, constants::RAW_SECTOR_SIZE);
+    if (keys::Verify(raw_sector)) return false;
+  }
+
+  return true;
+
+}; // END repair::IsScrambled()
+
+int Raw(Dvd &dvd, const char *raw_path, const char *iso_path, bool verbose) {
+  // Repair a RAW backup in place. The image is scanned on all cores for
+  // sectors that fail their EDC, then only the cache blocks holding them
+  // are read from the drive and the bad sectors are patched with pwrite,
+  // along with the matching ISO sectors when an ISO is given. Keys must
+  // be found with Dvd::FindKeys() first.
+  //
+  // Args:
+  //     dvd (Dvd &): drive with keys found
+  //     raw_path (const char *): path to the RAW backup
+  //     iso_path (const char *): path to the matching ISO backup (NULL = none)
+  //     verbose (bool): when true print command details
+  //
+  // Returns:
+  //     (int): status (0 = every bad sector repaired, 1 = fail)
+
+  std::vector<unsigned int> bad;
+  std::vector<Cypher *> cyphers;
+  bool scrambled;
+  unsigned int sector_number;
+
+  // scan for bad sectors, releasing the mapping before patching the file
+  {
+    convert::MappedImage image;
+    if (image.Open(raw_path) != 0) {
+      printf("dvdcc:repair:Raw() Cannot map %s\n", raw_path);
+      return 1;
+    }
+
+    sector_number = image.size / constants::RAW_SECTOR_SIZE;
+    if (sector_number > dvd.sector_number) {
+      printf("dvdcc:repair:Raw() %s has %u sectors but the disc has %u\n", raw_path, sector_number, dvd.sector_number);
+      return 1;
+    }
+
+    // scrambled images are checked with the disc keys
+    scrambled = IsScrambled(image.data, sector_number);
+    if (scrambled) cyphers.assign(dvd.cyphers, dvd.cyphers + dvd.cypher_number);
+
+    printf("Scanning %s for bad sectors...\n\n", raw_path);
+    convert::Scan(image.data, sector_number, &cyphers, dvd.dvd_rom, -1, &bad);
+  }
+
+  printf("\nFound %zu bad sectors.\n\n", bad.size());
+  if (bad.empty()) return 0;
+
+  int raw_fd = open(raw_path, O_WRONLY);
+  int iso_fd = iso_path ? open(iso_path, O_WRONLY) : -1;
+  if (raw_fd < 0 || (iso_path && iso_fd < 0)) {
+    printf("dvdcc:repair:Raw() Cannot open %s for writing\n", raw_fd < 0 ? raw_path : iso_path);
+    if (raw_fd >= 0) close(raw_fd);
+    if (iso_fd >= 0) close(iso_fd);
+    return 1;
+  }
+
+  const unsigned int buflen = constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE;
+  std::vector<unsigned char> buffer(buflen), iso(constants::SECTOR_SIZE);
+  unsigned int repaired = 0, failed = 0;
+
+  Progress progress("Repairing");
+  progress.Start();
+
+  layout::Select(dvd.dvd_rom, [&](auto disc) {
+    using Layout = decltype(disc);
+
+    // bad sectors are in order, so each cache block is read once
+    for (unsigned int n = 0; n < bad.size(); ) {
+
+      unsigned int cache_start = bad[n] / constants::SECTORS_PER_CACHE * constants::SECTORS_PER_CACHE;
+      bool read = dvd.ReadCacheBlock<Layout>(cache_start, buffer.data(), 20, verbose) == 0;
+
+      for (; n < bad.size() && bad[n] < cache_start + constants::SECTORS_PER_CACHE; n++) {
+
+        if (!read) {
+          printf("\r\x1b[K Cannot read sector %u\n", bad[n]);
+          failed++;
+          continue;
+        }
+
+        unsigned char *raw_sector = buffer.data() + (bad[n] - cache_start) * constants::RAW_SECTOR_SIZE;
+        bool ok = true;
+
+        if (iso_fd >= 0) {
+          layout::Extract<Layout>(raw_sector, 1, iso.data());
+          ok = pwrite(iso_fd, iso.data(), constants::SECTOR_SIZE,
+                      (off_t)bad[n] * constants::SECTOR_SIZE) == constants::SECTOR_SIZE;
+        }
+
+        if (scrambled)
+          layout::Descramble<Layout>(dvd.cyphers[dvd.CypherIndex(bad[n] / constants::SECTORS_PER_BLOCK)], raw_sector);
+
+        ok = ok && pwrite(raw_fd, raw_sector, constants::RAW_SECTOR_SIZE,
+                          (off_t)bad[n] * constants::RAW_SECTOR_SIZE) == constants::RAW_SECTOR_SIZE;
+
+        if (ok) {
+          repaired++;
+          if (verbose) printf("\r\x1b[K Repaired sector %u\n", bad[n]);
+        } else {
+          printf("\r\x1b[K Failed writing sector %u\n", bad[n]);
+          failed++;
+        }
+
+      } // END for (n)
+
+      progress.Update(n - 1, bad.size());
+
+    } // END for (n)
+
+  });
+
+  progress.Finish();
+
+  if (close(raw_fd) != 0) failed++;
+  if (iso_fd >= 0 && close(iso_fd) != 0) failed++;
+
+  printf("\nRepaired %u of %zu bad sectors.\n", repaired, bad.size());
+
+  return failed ? 1 : 0;
+
+}; // END repair::Raw()
+
+} // namespace repair
+
+#endif // DVDCC_REPAIR_H_
@@ -0,0 +1,286 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_SCAN_H_
+#define DVDCC_SCAN_H_
+
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/devices.h"
+#include "dvdcc/keys.h"
+#include "dvdcc/layout.h"
+#include "dvdcc/progress.h"
+#include "dvdcc/trace.h"
+
+// Functions for a read only surface scan that samples cache blocks across
+// the disc and reports read rates, EDC failures, retries and sense codes
+// per zone of sectors, with a prediction of the backup time.
+namespace scan {
+
+const unsigned int ZONES = 100;  // most zones across the disc
+const unsigned int RETRIES = 5;  // reads of a failing block before it counts as unreadable
+
+// Results of the sampled blocks of one zone.
+struct Zone {
+  unsigned int first;                         // first sector
+  unsigned int end;                           // sector after the last
+  unsigned int blocks;                        // cache blocks in the zone
+  unsigned int sampled;                       // cache blocks read
+  unsigned int sectors;                       // sectors checked on the first read
+  unsigned int edc_failures;                  // sectors failing EDC on the first read
+  unsigned int retries;                       // re-reads of failing blocks
+  unsigned int unreadable;                    // blocks failing every read
+  double seconds;                             // time spent on the sampled blocks, retries included
+  double slowest;                             // slowest first read in seconds
+  std::map<unsigned int, unsigned int> sense; // (key << 16 | asc << 8 | ascq) to count
+
+  double Rate(void) {                         // user data MB/s of the sampled blocks
+    return seconds > 0 ? (double)sectors * constants::SECTOR_SIZE / seconds / 1e6 : 0;
+  };
+  double PassRate(void) {                     // fraction of sectors passing EDC on the first read
+    return sectors ? 1.0 - (double)edc_failures / sectors : 0;
+  };
+  double Predicted(void) {                    // seconds to back up the whole zone
+    return sampled ? seconds / sampled * blocks : 0;
+  };
+};
+
+std::string SenseList(Zone &zone) {
+  // Format the sense codes of a zone as KEY/ASC/ASCQ=COUNT pairs.
+  //
+  // Args:
+  //     zone (Zone &): scanned zone
+  //
+  // Returns:
+  //     (std::string): space separated codes (empty = none)
+
+  std::string list;
+  char code[32];
+
+  for (auto it = zone.sense.begin(); it != zone.sense.end(); it++) {
+    sprintf(code, "%s%02X/%02X/%02X=%u", list.empty() ? "" : " ", it->first >> 16, (it->first >> 8) & 0xFF,
+            it->first & 0xFF, it->second);
+    list += code;
+  }
+
+  return list;
+
+}; // END scan::SenseList()
+
+template <class Layout>
+void Sample(Dvd &dvd, Zone &zone, unsigned int cache_start, unsigned char *buffer, bool verbose) {
+  // Read one cache block, retrying it like a backup would, and add the
+  // timing, EDC failures, retries and sense codes to its zone.
+  //
+  // Args:
+  //     dvd (Dvd &): drive with keys found
+  //     zone (Zone &): zone of the block, updated
+  //     cache_start (unsigned int): first sector of the block
+  //     buffer (unsigned char *): buffer for SECTORS_PER_CACHE raw sectors
+  //     verbose (bool): when true print command details
+
+  unsigned int count = dvd.sector_number - cache_start < constants::SECTORS_PER_CACHE ?
+                       dvd.sector_number - cache_start : constants::SECTORS_PER_CACHE;
+  request_sense sense;
+  bool good = false;
+
+  auto t0 = std::chrono::steady_clock::now();
+
+  for (unsigned int retry = 0; retry < RETRIES && !good; retry++) {
+
+    if (retry) {
+      dvd.ClearSectorCache(cache_start, verbose);
+      trace::Sleep(1);
+      zone.retries++;
+    }
+
+    auto t1 = std::chrono::steady_clock::now();
+    memset(&sense, 0, sizeof(sense));
+    int status = dvd.ReadRawSectorCache(cache_start, buffer, verbose, &sense);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+
+    if (sense.sense_key || sense.asc || sense.ascq)
+      zone.sense[(sense.sense_key << 16) | (sense.asc << 8) | sense.ascq]++;
+
+    unsigned int failures = status == 0 ? dvd.DecodeSectors<Layout>(cache_start, count, buffer) : count;
+    good = failures == 0;
+
+    // the first read shows the state of the disc, retries show whether it recovers
+    if (retry == 0) {
+      zone.sectors += count;
+      zone.edc_failures += failures;
+      if (elapsed > zone.slowest) zone.slowest = elapsed;
+    }
+
+  } // END for (retry)
+
+  if (!good) zone.unreadable++;
+
+  zone.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  zone.sampled++;
+
+}; // END scan::Sample()
+
+int Write(const char *path, std::vector<Zone> &zones, Dvd &dvd, unsigned int stride, double predicted) {
+  // Write the zone results as JSON when the path ends in .json, or as CSV.
+  //
+  // Args:
+  //     path (const char *): output path
+  //     zones (std::vector<Zone> &): scanned zones
+  //     dvd (Dvd &): scanned drive
+  //     stride (unsigned int): one cache block was read in every stride blocks
+  //     predicted (double): predicted backup time in seconds
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) return -1;
+
+  size_t length = strlen(path);
+  bool json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+
+  if (json) {
+    fprintf(fp, "{\n  \"model\": \"%s\",\n  \"disc_type\": \"%s\",\n  \"disc_id\": \"%s\",\n", dvd.model,
+            dvd.disc_type.c_str(), dvd.disc_id.c_str());
+    fprintf(fp, "  \"sectors\": %u,\n  \"stride\": %u,\n  \"predicted_seconds\": %.1f,\n  \"zones\": [\n",
+            dvd.sector_number, stride, predicted);
+  } else {
+    fprintf(fp, "zone,first_sector,end_sector,blocks,sampled,mb_per_s,slowest_ms,edc_pass_rate,edc_failures,"
+                "retries,unreadable,predicted_seconds,sense\n");
+  }
+
+  for (unsigned int i = 0; i < zones.size(); i++) {
+
+    Zone &z = zones[i];
+
+    if (json)
+      fprintf(fp, "    {\"zone\": %u, \"first_sector\": %u, \"end_sector\": %u, \"blocks\": %u, \"sampled\": %u, "
+                  "\"mb_per_s\": %.3f, \"slowest_ms\": %.1f, \"edc_pass_rate\": %.5f, \"edc_failures\": %u, "
+                  "\"retries\": %u, \"unreadable\": %u, \"predicted_seconds\": %.1f, \"sense\": \"%s\"}%s\n",
+              i, z.first, z.end, z.blocks, z.sampled, z.Rate(), z.slowest * 1e3, z.PassRate(), z.edc_failures,
+              z.retries, z.unreadable, z.Predicted(), SenseList(z).c_str(), i + 1 < zones.size() ? "," : "");
+    else
+      fprintf(fp, "%u,%u,%u,%u,%u,%.3f,%.1f,%.5f,%u,%u,%u,%.1f,%s\n", i, z.first, z.end, z.blocks, z.sampled,
+              z.Rate(), z.slowest * 1e3, z.PassRate(), z.edc_failures, z.retries, z.unreadable, z.Predicted(),
+              SenseList(z).c_str());
+
+  } // END for (i)
+
+  if (json) fprintf(fp, "  ]\n}\n");
+
+  return fclose(fp) == 0 ? 0 : -1;
+
+}; // END scan::Write()
+
+int Disc(Dvd &dvd, const char *path, unsigned int stride, bool verbose) {
+  // Scan the disc without writing a backup, reading one cache block in
+  // every stride blocks, and print a map of the zones.
+  //
+  // Args:
+  //     dvd (Dvd &): drive with keys found
+  //     path (const char *): CSV or JSON output path
+  //     stride (unsigned int): read one cache block in every stride blocks (1 = all)
+  //     verbose (bool): when true print command details
+  //
+  // Returns:
+  //     (int): status (0 = every sampled block readable, 1 = fail)
+
+  if (stride == 0) stride = 1;
+
+  unsigned int blocks = (dvd.sector_number + constants::SECTORS_PER_CACHE - 1) / constants::SECTORS_PER_CACHE;
+  unsigned int zone_blocks = (blocks + ZONES - 1) / ZONES;
+  if (zone_blocks == 0) {
+    printf("dvdcc:scan:Disc() Disc has no sectors.\n");
+    return 1;
+  }
+
+  std::vector<Zone> zones;
+  for (unsigned int b = 0; b < blocks; b += zone_blocks) {
+    Zone zone = {};
+    zone.first = b * constants::SECTORS_PER_CACHE;
+    zone.blocks = blocks - b < zone_blocks ? blocks - b : zone_blocks;
+    zone.end = (b + zone.blocks) * constants::SECTORS_PER_CACHE;
+    if (zone.end > dvd.sector_number) zone.end = dvd.sector_number;
+    zones.push_back(zone);
+  }
+
+  printf("Scanning %u of %u cache blocks in %zu zones...\n\n", (blocks + stride - 1) / stride, blocks, zones.size());
+
+  std::vector<unsigned char> buffer(constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE);
+
+  Progress progress("Progress");
+  progress.Start();
+
+  layout::Select(dvd.dvd_rom, [&](auto disc) {
+    for (unsigned int b = 0; b < blocks; b += stride) {
+      Sample<decltype(disc)>(dvd, zones[b / zone_blocks], b * constants::SECTORS_PER_CACHE, buffer.data(), verbose);
+      progress.Update(b, blocks);
+    }
+  });
+
+  progress.Finish();
+
+  // zones between samples take their neighbour's figures for the prediction
+  double predicted = 0;
+  unsigned int unreadable = 0;
+  for (unsigned int i = 0; i < zones.size(); i++) {
+    Zone *z = &zones[i];
+    for (unsigned int j = 1; z->sampled == 0 && j < zones.size(); j++)
+      if (i >= j && zones[i - j].sampled) z = &zones[i - j];
+    predicted += z->sampled ? z->seconds / z->sampled * zones[i].blocks : 0;
+    unreadable += zones[i].unreadable;
+  }
+
+  // one character per zone: fast, slow, retried and unreadable
+  double fastest = 0;
+  for (unsigned int i = 0; i < zones.size(); i++)
+    if (zones[i].Rate() > fastest) fastest = zones[i].Rate();
+
+  printf("\nZone map (. good, o below half speed, r retried, X unreadable, space not sampled):\n\n  ");
+  for (unsigned int i = 0; i < zones.size(); i++) {
+    Zone &z = zones[i];
+    char c = z.sampled == 0 ? ' ' : z.unreadable ? 'X' : z.retries ? 'r' : z.Rate() < fastest / 2 ? 'o' : '.';
+    printf("%c%s", c, (i + 1) % 50 == 0 ? "\n  " : "");
+  }
+  printf("\n\n");
+
+  char eta[32];
+  progress.DeltaString(eta, predicted);
+  printf("Predicted backup time: %s\n", eta);
+  if (unreadable)
+    printf("Unreadable blocks....: %u, consider cleaning the disc, a lower --speed or another drive\n", unreadable);
+
+  if (Write(path, zones, dvd, stride, predicted) != 0) {
+    printf("dvdcc:scan:Disc() Cannot write %s\n", path);
+    return 1;
+  }
+  printf("Zone results written to %s\n", path);
+
+  return unreadable ? 1 : 0;
+
+}; // END scan::Disc()
+
+} // namespace scan
+
+#endif // DVDCC_SCAN_H_
@@ -0,0 +1,549 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_SHARD_H_
+#define DVDCC_SHARD_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+
+#include "dvdcc/options.h"
+#include "dvdcc/constants.h"
+#include "dvdcc/progress.h"
+#include "dvdcc/devices.h"
+#include "dvdcc/layout.h"
+#include "dvdcc/backup.h"
+
+// Functions for backing up one image from several drives holding
+// identical copies of a disc, each drive reading part of the sectors.
+namespace shard {
+
+// reads per block before a drive hands the block to another drive
+const unsigned int RETRIES = 5;
+
+// consecutive failed blocks before a drive is given no more work
+const unsigned int MAX_FAILURES = 3;
+
+// Class for sharing the cache blocks of a sector range between drives.
+// Each drive starts with a contiguous range so reads stay sequential.
+// A drive that runs out of work takes the second half of the largest
+// range still being read, so slow drives hand work to fast ones, and
+// blocks a drive cannot read are handed back for the other drives.
+class ShardQueue {
+
+ public:
+  ShardQueue(unsigned int first, unsigned int end, std::vector<std::string> labels);
+
+  bool Next(unsigned int drive, unsigned int *cache_start);  // take the next block (false = no work left)
+  void Done(unsigned int drive, unsigned int sectors);       // report a block written
+  void Fail(unsigned int drive, unsigned int cache_start);   // hand back a block the drive cannot read
+  void Abort(void);                                          // stop every drive
+  bool Stuck(void);                                          // true when no drive can read a pending block
+
+  // cache blocks from next up to the sector before end
+  struct Range {
+    unsigned int next;
+    unsigned int end;
+    unsigned long long failed;  // drives that could not read the range
+  };
+
+  std::deque<Range> pending;               // ranges waiting for a drive
+  std::vector<Range> running;              // range of each drive (next >= end = idle)
+  std::vector<bool> busy;                  // drive is reading a block
+  std::vector<bool> retired;               // drive gets no more work
+  std::vector<unsigned int> failures;      // consecutive failed blocks per drive
+  std::vector<unsigned int> sectors;       // sectors written per drive
+  std::vector<std::string> labels;         // drive names for messages
+
+  unsigned int done;                       // sectors written by all drives
+  unsigned int total;                      // sectors in the range
+  bool aborted;                            // set when the backup cannot finish
+
+  Progress progress;
+  std::mutex mutex;
+  std::condition_variable cond;
+
+}; // END class ShardQueue()
+
+ShardQueue::ShardQueue(unsigned int first, unsigned int end, std::vector<std::string> labels)
+    : running(labels.size(), Range{0, 0, 0}), busy(labels.size(), false), retired(labels.size(), false),
+      failures(labels.size(), 0), sectors(labels.size(), 0), labels(labels), done(0),
+      total(end - first), aborted(false), progress("Progress") {
+  // Constructor that splits the range into one contiguous part per drive.
+  //
+  // Args:
+  //     first (unsigned int): first sector to back up
+  //     end (unsigned int): sector after the last to back up
+  //     labels (std::vector<std::string>): drive names, one per drive
+
+  unsigned int start = first / constants::SECTORS_PER_CACHE * constants::SECTORS_PER_CACHE;
+  unsigned int blocks = (end - start + constants::SECTORS_PER_CACHE - 1) / constants::SECTORS_PER_CACHE;
+
+  for (unsigned int i = 0; i < labels.size(); i++) {
+    unsigned int a = start + blocks * i / labels.size() * constants::SECTORS_PER_CACHE;
+    unsigned int b = start + blocks * (i + 1) / labels.size() * constants::SECTORS_PER_CACHE;
+    if (b > end) b = end;
+    if (a < b) pending.push_back(Range{a, b, 0});
+  }
+
+  progress.Start();
+
+}; // END ShardQueue::ShardQueue()
+
+bool ShardQueue::Stuck(void) {
+  // Check whether a pending range was failed by every drive still
+  // working. The caller holds the mutex.
+  //
+  // Returns:
+  //     (bool): true when the backup cannot finish
+
+  unsigned long long working = 0;
+  for (unsigned int i = 0; i < retired.size(); i++)
+    if (!retired[i]) working |= 1ULL << i;
+
+  for (unsigned int i = 0; i < pending.size(); i++)
+    if ((pending[i].failed & working) == working) return true;
+
+  return false;
+
+}; // END ShardQueue::Stuck()
+
+bool ShardQueue::Next(unsigned int drive, unsigned int *cache_start) {
+  // Take the next cache block for a drive, continuing its own range,
+  // then a pending range, then half of another drive's range. Waits
+  // while other drives may still hand back blocks.
+  //
+  // Args:
+  //     drive (unsigned int): drive index
+  //     cache_start (unsigned int *): returns the first sector of the block
+  //
+  // Returns:
+  //     (bool): true when a block was assigned, false when the drive is done
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  const unsigned int block = constants::SECTORS_PER_CACHE;
+
+  while (true) {
+
+    if (aborted || retired[drive]) return false;
+
+    Range &own = running[drive];
+    if (own.next < own.end) {
+      *cache_start = own.next;
+      own.next += block;
+      busy[drive] = true;
+      return true;
+    }
+
+    // ranges handed back by other drives come first
+    bool taken = false;
+    for (unsigned int i = 0; i < pending.size() && !taken; i++) {
+      if (pending[i].failed & (1ULL << drive)) continue;
+      own = pending[i];
+      pending.erase(pending.begin() + i);
+      taken = true;
+    }
+    if (taken) continue;
+
+    // split the largest range still being read
+    unsigned int victim = drive, most = 1;
+    for (unsigned int i = 0; i < running.size(); i++) {
+      unsigned int left = running[i].next < running[i].end ?
+                          (running[i].end - running[i].next + block - 1) / block : 0;
+      if (i != drive && left > most) {
+        victim = i;
+        most = left;
+      }
+    }
+    if (victim != drive) {
+      unsigned int mid = running[victim].next + (most + 1) / 2 * block;
+      own = Range{mid, running[victim].end, running[victim].failed};
+      running[victim].end = mid;
+      continue;
+    }
+
+    // finished once nothing is pending or being read
+    bool reading = false;
+    for (unsigned int i = 0; i < busy.size(); i++) reading = reading || busy[i];
+    if (pending.empty() && !reading) return false;
+
+    if (Stuck()) {
+      aborted = true;
+      cond.notify_all();
+      return false;
+    }
+
+    cond.wait(lock);
+
+  } // END while (true)
+
+}; // END ShardQueue::Next()
+
+void ShardQueue::Done(unsigned int drive, unsigned int count) {
+  // Report a block written by a drive.
+  //
+  // Args:
+  //     drive (unsigned int): drive index
+  //     count (unsigned int): sectors written
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  busy[drive] = false;
+  failures[drive] = 0;
+  sectors[drive] += count;
+  done += count;
+
+  progress.Update(done - 1, total);
+  cond.notify_all();
+
+}; // END ShardQueue::Done()
+
+void ShardQueue::Fail(unsigned int drive, unsigned int cache_start) {
+  // Hand back a block a drive could not read. The drive keeps the rest
+  // of its range unless it keeps failing, in which case its range is
+  // handed back too and the drive gets no more work.
+  //
+  // Args:
+  //     drive (unsigned int): drive index
+  //     cache_start (unsigned int): first sector of the block
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  Range &own = running[drive];
+  unsigned int end = cache_start + constants::SECTORS_PER_CACHE;
+  if (own.next == end && own.end < end) end = own.end;
+
+  busy[drive] = false;
+  pending.push_front(Range{cache_start, end, own.failed | (1ULL << drive)});
+
+  printf("\r\x1b[K%s: Cannot read block at sector %u, handing it to another drive\n",
+         labels[drive].c_str(), cache_start);
+
+  if (++failures[drive] == MAX_FAILURES) {
+    printf("\r\x1b[K%s: %u blocks failed in a row, giving its sectors to the other drives\n",
+           labels[drive].c_str(), MAX_FAILURES);
+    if (own.next < own.end) pending.push_back(Range{own.next, own.end, own.failed});
+    own.next = own.end;
+    retired[drive] = true;
+  }
+
+  if (Stuck()) aborted = true;
+
+  cond.notify_all();
+
+}; // END ShardQueue::Fail()
+
+void ShardQueue::Abort(void) {
+  // Stop every drive after a fatal error.
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  aborted = true;
+  cond.notify_all();
+
+}; // END ShardQueue::Abort()
+
+std::string Signature(Dvd &dvd, bool verbose) {
+  // Identify the disc in a drive by its type, size, keys and the user
+  // data of its first block. Drives with the same signature hold copies
+  // of the same disc and can share one backup.
+  //
+  // Args:
+  //     dvd (Dvd &): drive prepared with backup::Prepare()
+  //     verbose (bool): set to true to print more details to stdout
+  //
+  // Returns:
+  //     (std::string): disc signature (empty = cannot read the first block)
+
+  std::vector<unsigned char> buffer(constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE);
+  std::vector<unsigned char> iso(constants::SECTOR_SIZE * constants::SECTORS_PER_BLOCK);
+
+  int status = layout::Select(dvd.dvd_rom, [&](auto disc) {
+    using Layout = decltype(disc);
+    if (dvd.ReadCacheBlock<Layout>(0, buffer.data(), 20, verbose) != 0) return -1;
+    layout::Extract<Layout>(buffer.data(), constants::SECTORS_PER_BLOCK, iso.data());
+    return 0;
+  });
+  if (status != 0) return "";
+
+  std::string signature = dvd.disc_type + "/" + std::to_string(dvd.sector_number) + "/";
+  for (unsigned int i = 0; i < dvd.cypher_number; i++)
+    signature += std::to_string(dvd.cyphers[i]->seed) + ",";
+
+  signature.append((char *)iso.data(), iso.size());
+
+  return signature;
+
+}; // END shard::Signature()
+
+int Drive(Dvd *dvd, ShardQueue *queue, unsigned int drive, int iso_fd, int raw_fd,
+          unsigned int first, unsigned int end, bool verbose) {
+  // Read the blocks assigned to a drive and write them into the shared
+  // outputs at their disc offsets. Runs on its own thread.
+  //
+  // Args:
+  //     dvd (Dvd *): drive prepared with backup::Prepare()
+  //     queue (ShardQueue *): blocks shared by all drives
+  //     drive (unsigned int): drive index
+  //     iso_fd (int): ISO output (-1 = none)
+  //     raw_fd (int): RAW output (-1 = none)
+  //     first (unsigned int): first sector to back up
+  //     end (unsigned int): sector after the last to back up
+  //     verbose (bool): set to true to print more details to stdout
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = failed writing)
+
+  std::vector<unsigned char> buffer(constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE);
+  std::vector<unsigned char> iso(constants::SECTOR_SIZE * constants::SECTORS_PER_CACHE);
+  unsigned int cache_start;
+
+  return layout::Select(dvd->dvd_rom, [&](auto disc) {
+    using Layout = decltype(disc);
+
+    while (queue->Next(drive, &cache_start)) {
+
+      // other drives retry the block when this one cannot read it
+      if (dvd->ReadCacheBlock<Layout>(cache_start, buffer.data(), RETRIES, verbose) != 0) {
+        queue->Fail(drive, cache_start);
+        continue;
+      }
+
+      // the first and last blocks can extend past the range
+      unsigned int lo = cache_start < first ? first : cache_start;
+      unsigned int hi = cache_start + constants::SECTORS_PER_CACHE < end ? cache_start + constants::SECTORS_PER_CACHE : end;
+      unsigned int count = hi - lo;
+      unsigned char *raw = buffer.data() + (lo - cache_start) * constants::RAW_SECTOR_SIZE;
+
+      bool ok = true;
+
+      if (iso_fd >= 0) {
+        layout::Extract<Layout>(raw, count, iso.data());
+        ok = pwrite(iso_fd, iso.data(), (size_t)count * constants::SECTOR_SIZE,
+                    (off_t)lo * constants::SECTOR_SIZE) == (ssize_t)count * constants::SECTOR_SIZE;
+      }
+
+      if (ok && raw_fd >= 0)
+        ok = pwrite(raw_fd, raw, (size_t)count * constants::RAW_SECTOR_SIZE,
+                    (off_t)lo * constants::RAW_SECTOR_SIZE) == (ssize_t)count * constants::RAW_SECTOR_SIZE;
+
+      if (!ok) {
+        printf("\r\x1b[Kdvdcc:shard:Drive() Failed writing sectors %u to %u\n", lo, hi - 1);
+        queue->Abort();
+        return 1;
+      }
+
+      dvd->counters->Read(lo, count, (unsigned long long)count * ((iso_fd >= 0 ? constants::SECTOR_SIZE : 0) +
+                                                                  (raw_fd >= 0 ? constants::RAW_SECTOR_SIZE : 0)));
+      queue->Done(drive, count);
+
+    } // END while (queue->Next(...))
+
+    return 0;
+
+  });
+
+}; // END shard::Drive()
+
+int CreateOutput(const char *path, unsigned int sector_number, unsigned int sector_size,
+                 unsigned int first, unsigned int end) {
+  // Create an output sized for the whole disc with the blocks of the
+  // range reserved up front, so positional writes from several drives
+  // never extend the file.
+  //
+  // Args:
+  //     path (const char *): output path
+  //     sector_number (unsigned int): number of disc sectors
+  //     sector_size (unsigned int): size of the output sectors in bytes
+  //     first (unsigned int): first sector to back up
+  //     end (unsigned int): sector after the last to back up
+  //
+  // Returns:
+  //     (int): file descriptor (-1 = fail)
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    printf("dvdcc:shard:CreateOutput() Cannot create %s. Delete it if it already exists.\n", path);
+    return -1;
+  }
+
+  if (ftruncate(fd, (off_t)sector_number * sector_size) != 0) {
+    printf("dvdcc:shard:CreateOutput() Cannot size %s\n", path);
+    close(fd);
+    return -1;
+  }
+
+  // file systems without preallocation still work with the sized file
+  posix_fallocate(fd, (off_t)first * sector_size, (off_t)(end - first) * sector_size);
+
+  return fd;
+
+}; // END shard::CreateOutput()
+
+int Run(Options &options) {
+  // Back up one disc from several drives holding identical copies. Every
+  // drive is prepared in parallel and compared with the first, then the
+  // sectors are shared between the matching drives and written into one
+  // preallocated image with positional writes.
+  //
+  // Args:
+  //     options (Options &): parsed command line options with several devices
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = fail)
+
+  if (!options.iso && !options.raw) {
+    printf("dvdcc:shard:Run() Use --iso and/or --raw with --shard.\n");
+    return 1;
+  }
+
+  if ((options.iso && strcmp(options.iso, "-") == 0) || (options.raw && strcmp(options.raw, "-") == 0)) {
+    printf("dvdcc:shard:Run() Cannot stream a sharded backup to stdout.\n");
+    return 1;
+  }
+
+  if (options.resume || options.compress || options.hash || options.block_index ||
+      options.elide_junk || options.raw_sidecar || options.selective || options.dedup)
+    printf("Sharded backups are written out of order as plain images. Ignoring --resume, --compress,\n"
+           "--hash, --block-index, --elide-junk, --raw-sidecar, --selective and --dedup.\n\n");
+
+  unsigned int drives = options.devices.size();
+  if (drives > 64) {
+    printf("dvdcc:shard:Run() Cannot shard across more than 64 drives.\n");
+    return 1;
+  }
+
+  std::vector<Dvd *> dvds;
+  std::vector<std::string> labels;
+  std::vector<std::future<int>> prepared;
+
+  printf("Preparing %u drives...\n\n", drives);
+
+  for (unsigned int i = 0; i < drives; i++) {
+    std::string label(options.devices[i]);
+    labels.push_back(label.substr(label.find_last_of('/') + 1));
+    dvds.push_back(new Dvd(options.devices[i], options.timeout, options.verbose));
+    prepared.push_back(std::async(std::launch::async, backup::Prepare, std::ref(options),
+                                  std::ref(*dvds[i]), options.devices[i]));
+  }
+
+  // keep the drives holding the same disc as the first usable drive
+  std::string reference;
+  std::vector<Dvd *> matched;
+  std::vector<std::string> matched_labels;
+
+  for (unsigned int i = 0; i < drives; i++) {
+
+    std::string signature = prepared[i].get() == 0 ? Signature(*dvds[i], options.verbose) : "";
+
+    if (signature.empty()) {
+      printf(" * %s (%s): cannot read the disc, skipped\n", labels[i].c_str(), dvds[i]->model);
+    } else if (reference.empty() || signature == reference) {
+      printf(" * %s (%s): %s\n", labels[i].c_str(), dvds[i]->model, reference.empty() ? "reference" : "identical");
+      reference = signature;
+      matched.push_back(dvds[i]);
+      matched_labels.push_back(labels[i]);
+    } else {
+      printf(" * %s (%s): different disc, skipped\n", labels[i].c_str(), dvds[i]->model);
+    }
+
+  } // END for (i)
+
+  printf("\n");
+
+  int status = 0;
+  int iso_fd = -1, raw_fd = -1;
+
+  if (matched.empty()) {
+    printf("dvdcc:shard:Run() No drive can read the disc.\n");
+    status = 1;
+  }
+
+  unsigned int first = options.start_sector, end = 0;
+
+  if (status == 0) {
+    matched[0]->DisplayMetaData();
+
+    end = matched[0]->sector_number;
+    if (options.end_sector != 0 && options.end_sector < end) end = options.end_sector;
+    if (first >= end) {
+      printf("dvdcc:shard:Run() --start-sector is beyond the last sector %u.\n", end - 1);
+      status = 1;
+    }
+  }
+
+  if (status == 0 && options.iso) {
+    printf(" ISO path: %s\n", options.iso);
+    iso_fd = CreateOutput(options.iso, matched[0]->sector_number, constants::SECTOR_SIZE, first, end);
+    if (iso_fd < 0) status = 1;
+  }
+
+  if (status == 0 && options.raw) {
+    printf(" RAW path: %s\n", options.raw);
+    raw_fd = CreateOutput(options.raw, matched[0]->sector_number, constants::RAW_SECTOR_SIZE, first, end);
+    if (raw_fd < 0) status = 1;
+  }
+
+  if (status == 0) {
+
+    printf("\nBacking up sectors %u to %u on %zu drives...\n\n", first, end - 1, matched.size());
+
+    ShardQueue queue(first, end, matched_labels);
+    std::vector<std::future<int>> results;
+
+    for (unsigned int i = 0; i < matched.size(); i++)
+      results.push_back(std::async(std::launch::async, Drive, matched[i], &queue, i, iso_fd, raw_fd,
+                                   first, end, (bool)options.verbose));
+
+    for (unsigned int i = 0; i < results.size(); i++)
+      if (results[i].get() != 0) status = 1;
+
+    queue.progress.Finish();
+
+    if (queue.aborted || queue.done != queue.total) {
+      printf("\ndvdcc:shard:Run() Backup incomplete, %u of %u sectors written.\n", queue.done, queue.total);
+      status = 1;
+    }
+
+    printf("\n");
+    for (unsigned int i = 0; i < matched.size(); i++)
+      printf(" * %s read %u sectors (%.1f%%)\n", matched_labels[i].c_str(), queue.sectors[i],
+             100.0 * queue.sectors[i] / queue.total);
+
+  } // END if (status == 0)
+
+  if (iso_fd >= 0 && close(iso_fd) != 0) status = 1;
+  if (raw_fd >= 0 && close(raw_fd) != 0) status = 1;
+
+  for (unsigned int i = 0; i < dvds.size(); i++) delete dvds[i];
+
+  return status;
+
+}; // END shard::Run()
+
+} // namespace shard
+
+#endif // DVDCC_SHARD_H_
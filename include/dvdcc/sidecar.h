@@ -0,0 +1,258 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_SIDECAR_H_
+#define DVDCC_SIDECAR_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/cypher.h"
+#include "dvdcc/keys.h"
+#include "dvdcc/layout.h"
+#include "dvdcc/sinks.h"
+#include "dvdcc/chunks.h"
+
+namespace sidecar {
+
+// RAW sidecar format
+//
+//   header   128 bytes
+//             0  8 bytes  magic "DVDCCS01"
+//             8  4 bytes  number of disc sectors
+//            12  4 bytes  offset of the 2048 byte payload in a raw sector
+//            16  4 bytes  number of cypher seeds
+//            20  4 bytes  reserved
+//            24 80 bytes  cypher seeds (4 bytes each, up to 20)
+//           104 24 bytes  reserved
+//   entries  16 bytes per sector holding the raw sector bytes before
+//            the payload followed by the bytes after it (ID, IED,
+//            CPR_MAI, trailing bytes and EDC)
+//
+// All integers are little endian. Together with the ISO this holds
+// everything in a RAW backup, so the RAW file can be rebuilt on demand.
+// The header is a whole number of entries so a sidecar can be resumed
+// with OpenAndResume() like the other outputs.
+const char MAGIC[8] = {'D', 'V', 'D', 'C', 'C', 'S', '0', '1'};
+const unsigned int HEADER_SIZE = 128;
+const unsigned int ENTRY_SIZE = 16;
+const unsigned int MAX_SEEDS = 20;
+
+} // namespace sidecar
+
+// Class for writing the non-payload bytes of raw sectors to a sidecar
+// next to an ISO backup, in place of a full RAW backup.
+class SidecarSink : public FileSink {
+
+ public:
+  SidecarSink(FILE *fp, bool resume, unsigned int sector_number, unsigned int payload_offset,
+              unsigned int cypher_number, Cypher **cyphers);
+
+  int Write(unsigned int sector, unsigned char *data);
+
+  unsigned int payload_offset;  // offset of the payload in a raw sector
+  unsigned char entry[sidecar::ENTRY_SIZE];
+
+}; // END class SidecarSink()
+
+SidecarSink::SidecarSink(FILE *fp, bool resume, unsigned int sector_number, unsigned int payload_offset,
+                         unsigned int cypher_number, Cypher **cyphers)
+    : FileSink(fp, sidecar::ENTRY_SIZE), payload_offset(payload_offset) {
+  // Constructor that writes the header of a new sidecar.
+  //
+  // Args:
+  //     fp (FILE *): sidecar opened by OpenAndResume() with ENTRY_SIZE sectors
+  //     resume (bool): true when continuing an existing sidecar
+  //     sector_number (unsigned int): number of disc sectors
+  //     payload_offset (unsigned int): offset of the payload in a raw sector
+  //     cypher_number (unsigned int): number of cyphers found by Dvd::FindKeys()
+  //     cyphers (Cypher **): cyphers found by Dvd::FindKeys()
+
+  if (resume) return;
+
+  unsigned char header[sidecar::HEADER_SIZE];
+  memset(header, 0, sidecar::HEADER_SIZE);
+  memcpy(header, sidecar::MAGIC, 8);
+  chunks::Put32(header + 8, sector_number);
+  chunks::Put32(header + 12, payload_offset);
+  chunks::Put32(header + 16, cypher_number);
+  for (unsigned int i = 0; i < cypher_number && i < sidecar::MAX_SEEDS; i++)
+    chunks::Put32(header + 24 + 4 * i, cyphers[i]->seed);
+
+  if (fwrite(header, 1, sidecar::HEADER_SIZE, fp) != sidecar::HEADER_SIZE) {
+    printf("dvdcc:sidecar:SidecarSink() Failed writing sidecar header\n");
+    printf("dvdcc:sidecar:SidecarSink() Exiting...\n");
+    exit(0);
+  }
+
+}; // END SidecarSink::SidecarSink()
+
+int SidecarSink::Write(unsigned int sector, unsigned char *data) {
+  // Append the non-payload bytes of a decoded raw sector.
+  //
+  // Args:
+  //     sector (unsigned int): sector number (sectors arrive in order)
+  //     data (unsigned char *): decoded raw sector bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned int tail = payload_offset + constants::SECTOR_SIZE;
+
+  memcpy(entry, data, payload_offset);
+  memcpy(entry + payload_offset, data + tail, constants::RAW_SECTOR_SIZE - tail);
+
+  return fwrite(entry, 1, sidecar::ENTRY_SIZE, fp) == sidecar::ENTRY_SIZE ? 0 : -1;
+
+}; // END SidecarSink::Write()
+
+namespace sidecar {
+
+int Build(const char *iso_path, const char *sidecar_path, const char *raw_path, bool scramble) {
+  // Rebuild a RAW backup from an ISO backup and its sidecar. Every
+  // rebuilt sector is checked against its EDC. Sectors that were skipped
+  // in the sidecar are left as holes, as they are in a RAW backup.
+  //
+  // Args:
+  //     iso_path (const char *): path to the ISO (plain or compressed)
+  //     sidecar_path (const char *): path to the sidecar
+  //     raw_path (const char *): path of the new RAW file
+  //     scramble (bool): when true re-apply the disc scrambling so the
+  //                      sectors match the bytes read from the drive cache
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  unsigned char header[HEADER_SIZE], entry[ENTRY_SIZE], zeros[ENTRY_SIZE];
+  unsigned char raw_sector[constants::RAW_SECTOR_SIZE];
+
+  FILE *fp = fopen(sidecar_path, "rb");
+  if (fp == NULL || fread(header, 1, HEADER_SIZE, fp) != HEADER_SIZE || memcmp(header, MAGIC, 8) != 0) {
+    printf("dvdcc:sidecar:Build() Cannot read sidecar %s\n", sidecar_path);
+    if (fp) fclose(fp);
+    return -1;
+  }
+
+  unsigned int sector_number = chunks::Get32(header + 8);
+  unsigned int payload_offset = chunks::Get32(header + 12);
+  unsigned int cypher_number = chunks::Get32(header + 16);
+  unsigned int tail = payload_offset + constants::SECTOR_SIZE;
+
+  if (payload_offset > ENTRY_SIZE || cypher_number < 2 || cypher_number > MAX_SEEDS) {
+    printf("dvdcc:sidecar:Build() Invalid sidecar header in %s\n", sidecar_path);
+    fclose(fp);
+    return -1;
+  }
+
+  std::vector<Cypher *> cyphers;
+  for (unsigned int i = 0; i < cypher_number; i++)
+    cyphers.push_back(new Cypher(chunks::Get32(header + 24 + 4 * i), constants::SECTOR_SIZE));
+
+  // compressed ISO backups are read through their chunk index
+  ChunkReader reader;
+  FILE *iso = NULL;
+  bool compressed = reader.Open(iso_path) == 0;
+  if (!compressed) iso = fopen(iso_path, "rb");
+
+  if (!compressed && iso == NULL) {
+    printf("dvdcc:sidecar:Build() Cannot open ISO %s\n", iso_path);
+    for (unsigned int i = 0; i < cypher_number; i++) delete cyphers[i];
+    fclose(fp);
+    return -1;
+  }
+
+  // never overwrite an existing RAW file
+  FILE *out = access(raw_path, F_OK) == 0 ? NULL : fopen(raw_path, "wb");
+  if (out == NULL) {
+    printf("dvdcc:sidecar:Build() Cannot create %s. Delete it if it already exists.\n", raw_path);
+    if (iso) fclose(iso);
+    for (unsigned int i = 0; i < cypher_number; i++) delete cyphers[i];
+    fclose(fp);
+    return -1;
+  }
+
+  FileSink raw(out, constants::RAW_SECTOR_SIZE);
+
+  memset(zeros, 0, ENTRY_SIZE);
+
+  int status = 0;
+  unsigned int holes = 0, failures = 0, sector;
+
+  for (sector = 0; sector < sector_number && status == 0; sector++) {
+
+    // sidecars end early when the backup was interrupted
+    if (fread(entry, 1, ENTRY_SIZE, fp) != ENTRY_SIZE) break;
+
+    // skipped sectors have no ID or EDC and stay holes
+    if (memcmp(entry, zeros, ENTRY_SIZE) == 0) {
+      if (raw.Skip(sector, 1) != 0) status = -1;
+      if (iso && fseeko(iso, constants::SECTOR_SIZE, SEEK_CUR) != 0) status = -1;
+      holes++;
+      continue;
+    }
+
+    memcpy(raw_sector, entry, payload_offset);
+    memcpy(raw_sector + tail, entry + payload_offset, constants::RAW_SECTOR_SIZE - tail);
+
+    if (compressed) {
+      if (reader.Read(sector, raw_sector + payload_offset) != 0) status = -1;
+    } else {
+      if (fread(raw_sector + payload_offset, 1, constants::SECTOR_SIZE, iso) != constants::SECTOR_SIZE) status = -1;
+    }
+
+    if (status != 0) {
+      printf("dvdcc:sidecar:Build() ISO ends before sector %u\n", sector);
+      break;
+    }
+
+    // holes left in the ISO, such as elided junk, fail here
+    if (!layout::Verify<layout::Sector>(raw_sector)) {
+      if (failures++ < 10)
+        printf("dvdcc:sidecar:Build() EDC mismatch at sector %u\n", sector);
+    }
+
+    if (scramble)
+      layout::Descramble<layout::Sector>(cyphers[keys::CypherIndex(sector / constants::SECTORS_PER_BLOCK, cypher_number)],
+                                         raw_sector);
+
+    if (raw.Write(sector, raw_sector) != 0) status = -1;
+
+  } // END for (sector)
+
+  if (raw.Close() != 0) status = -1;
+  if (iso) fclose(iso);
+  fclose(fp);
+  for (unsigned int i = 0; i < cypher_number; i++) delete cyphers[i];
+
+  if (status != 0) {
+    printf("dvdcc:sidecar:Build() Failed writing %s\n", raw_path);
+    return -1;
+  }
+
+  printf("Rebuilt %u of %u sectors (%u holes, %u EDC mismatches).\n", sector, sector_number, holes, failures);
+
+  return failures ? -1 : 0;
+
+}; // END sidecar::Build()
+
+} // namespace sidecar
+
+#endif // DVDCC_SIDECAR_H_
@@ -0,0 +1,292 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_SINKS_H_
+#define DVDCC_SINKS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// Base class for backup outputs that receive verified sectors.
+class Sink {
+
+ public:
+  Sink(unsigned int sector_size) : sector_size(sector_size) {};
+  virtual ~Sink() {};
+
+  virtual int Write(unsigned int sector, unsigned char *data) = 0; // write one sector
+  virtual int Skip(unsigned int sector, unsigned int count);       // leave sectors unwritten
+  virtual int Close(void) = 0;                                     // flush and close the output
+
+  unsigned int sector_size; // size of the output sectors in bytes
+
+}; // END class Sink()
+
+int Sink::Skip(unsigned int sector, unsigned int count) {
+  // Leave a range of sectors unwritten. Outputs that cannot hold holes
+  // receive zero filled sectors instead.
+  //
+  // Args:
+  //     sector (unsigned int): first sector to skip
+  //     count (unsigned int): number of sectors
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  std::vector<unsigned char> zeros(sector_size, 0);
+
+  for (unsigned int i = 0; i < count; i++)
+    if (Write(sector + i, zeros.data()) != 0)
+      return -1;
+
+  return 0;
+
+}; // END Sink::Skip()
+
+// Class for writing sectors sequentially to a regular file.
+// Skipped sectors are left as sparse holes.
+class FileSink : public Sink {
+
+ public:
+  FileSink(FILE *fp, unsigned int sector_size) : Sink(sector_size), fp(fp) {};
+
+  int Write(unsigned int sector, unsigned char *data);
+  int Skip(unsigned int sector, unsigned int count);
+  int Close(void);
+
+  FILE *fp; // file opened by OpenAndResume()
+
+}; // END class FileSink()
+
+int FileSink::Write(unsigned int sector, unsigned char *data) {
+  // Append a sector to the file.
+  //
+  // Args:
+  //     sector (unsigned int): sector number (sectors arrive in order)
+  //     data (unsigned char *): sector bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  return fwrite(data, 1, sector_size, fp) == sector_size ? 0 : -1;
+
+}; // END FileSink::Write()
+
+int FileSink::Skip(unsigned int sector, unsigned int count) {
+  // Seek past sectors so they are left as a hole in the file.
+  //
+  // Args:
+  //     sector (unsigned int): first sector to skip
+  //     count (unsigned int): number of sectors
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  return fseeko(fp, (off_t)count * sector_size, SEEK_CUR) == 0 ? 0 : -1;
+
+}; // END FileSink::Skip()
+
+int FileSink::Close(void) {
+  // Close the file, extending it over any trailing hole.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  int status = 0;
+  struct stat st;
+
+  off_t end = ftello(fp);
+  if (fflush(fp) != 0) status = -1;
+  if (fstat(fileno(fp), &st) == 0 && st.st_size < end && ftruncate(fileno(fp), end) != 0) status = -1;
+  if (fclose(fp) != 0) status = -1;
+
+  return status;
+
+}; // END FileSink::Close()
+
+// Class for streaming sectors in order to stdout or a named pipe.
+//
+// Sectors may arrive out of order and are held in a bounded reorder
+// buffer until the next expected sector is available. A writer thread
+// drains the buffer so the backup loop never waits on the consumer,
+// unless the buffer is full, in which case Write() blocks until the
+// consumer catches up.
+class StreamSink : public Sink {
+
+ public:
+  StreamSink(int fd, unsigned int sector_size, unsigned int capacity);
+  ~StreamSink() { free(slots); };
+
+  int Write(unsigned int sector, unsigned char *data);
+  int Close(void);
+  void Run(void);                                         // writer thread loop
+  int WriteAll(unsigned char *data, size_t nbyte);        // write handling partial writes
+
+  int fd;                           // output file descriptor
+  unsigned int capacity;            // reorder buffer size in sectors
+  unsigned int next;                // next sector to stream
+  unsigned char *slots;             // reorder buffer with capacity sectors
+  std::vector<bool> filled;         // true when a slot holds a sector
+  bool closing;                     // set when no more sectors will arrive
+  bool failed;                      // set when the consumer stops accepting data
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread writer;
+
+}; // END class StreamSink()
+
+StreamSink::StreamSink(int fd, unsigned int sector_size, unsigned int capacity)
+    : Sink(sector_size), fd(fd), capacity(capacity), next(0),
+      filled(capacity, false), closing(false), failed(false) {
+  // Constructor that starts the writer thread.
+  //
+  // Args:
+  //     fd (int): output file descriptor (stdout or an open named pipe)
+  //     sector_size (unsigned int): size of the output sectors in bytes
+  //     capacity (unsigned int): reorder buffer size in sectors
+
+  // report a closed pipe as a write error instead of terminating
+  signal(SIGPIPE, SIG_IGN);
+
+  slots = (unsigned char *)malloc((size_t)capacity * sector_size);
+
+  writer = std::thread(&StreamSink::Run, this);
+
+}; // END StreamSink::StreamSink()
+
+int StreamSink::Write(unsigned int sector, unsigned char *data) {
+  // Queue a sector for streaming, blocking while it lies beyond the
+  // reorder buffer window.
+  //
+  // Args:
+  //     sector (unsigned int): sector number
+  //     data (unsigned char *): sector bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  cond.wait(lock, [&] { return sector < next + capacity || failed; });
+
+  if (failed) return -1;
+
+  // sectors already streamed are ignored
+  if (sector < next) return 0;
+
+  memcpy(slots + (size_t)(sector % capacity) * sector_size, data, sector_size);
+  filled[sector % capacity] = true;
+
+  cond.notify_all();
+
+  return 0;
+
+}; // END StreamSink::Write()
+
+void StreamSink::Run(void) {
+  // Writer thread that streams contiguous runs of buffered sectors.
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+
+    cond.wait(lock, [&] { return filled[next % capacity] || closing; });
+
+    // stop once closing with no further in-order sectors
+    if (!filled[next % capacity]) break;
+
+    // gather the run of filled slots up to the end of the ring
+    unsigned int first = next % capacity, n = 0;
+    while (first + n < capacity && filled[first + n]) n++;
+
+    lock.unlock();
+    int status = WriteAll(slots + (size_t)first * sector_size, (size_t)n * sector_size);
+    lock.lock();
+
+    for (unsigned int i = 0; i < n; i++) filled[first + i] = false;
+    next += n;
+
+    if (status != 0) failed = true;
+
+    cond.notify_all();
+
+    if (failed) break;
+
+  } // END while (true)
+
+}; // END StreamSink::Run()
+
+int StreamSink::WriteAll(unsigned char *data, size_t nbyte) {
+  // Write all bytes to the output, retrying partial writes.
+  //
+  // Args:
+  //     data (unsigned char *): bytes to write
+  //     nbyte (size_t): number of bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  while (nbyte > 0) {
+    ssize_t n = write(fd, data, nbyte);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      fprintf(stderr, "dvdcc:sinks:StreamSink:WriteAll() Stream closed (%s)\n", strerror(errno));
+      return -1;
+    }
+    data += n;
+    nbyte -= n;
+  }
+
+  return 0;
+
+}; // END StreamSink::WriteAll()
+
+int StreamSink::Close(void) {
+  // Stream the remaining sectors and close the output.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+  }
+  cond.notify_all();
+  writer.join();
+
+  // sectors left behind a gap were never streamed
+  bool complete = true;
+  for (unsigned int i = 0; i < capacity; i++)
+    if (filled[i]) complete = false;
+
+  if (fd != STDOUT_FILENO) close(fd);
+
+  return (failed || !complete) ? -1 : 0;
+
+}; // END StreamSink::Close()
+
+#endif // DVDCC_SINKS_H_
@@ -0,0 +1,154 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_SPEED_H_
+#define DVDCC_SPEED_H_
+
+#include <stdio.h>
+
+#include <vector>
+#include <utility>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/devices.h"
+
+// Class for adapting the drive read speed to the disc condition.
+// The speed is halved whenever EDC failures cluster within a small
+// window of sectors and doubled again after a long run of clean reads.
+class SpeedController {
+
+ public:
+  SpeedController(Dvd *dvd, unsigned int max_speed, bool adaptive, bool verbose);
+
+  void Failure(unsigned int sector);                    // report a sector that failed EDC
+  void Success(unsigned int sector);                    // report a sector that passed EDC
+  int Change(unsigned int speed, unsigned int sector);  // change speed and log the sector
+
+  Dvd *dvd;                      // drive to control
+  bool adaptive;                 // adapt speed to failures when true
+  bool verbose;                  // print command details when true
+  unsigned int max_speed;        // fastest allowed speed in kB/s (constants::MAX_SPEED = maximum)
+  unsigned int min_speed;        // slowest allowed speed in kB/s
+  unsigned int failures;         // failures within the current window
+  unsigned int window_start;     // first sector of the current failure window
+  unsigned int clean;            // consecutive sectors read without failure
+
+  unsigned int window;           // failure window length in sectors
+  unsigned int threshold;        // failures within window that trigger a slow down
+  unsigned int recovery;         // clean sectors needed before speeding back up
+
+  std::vector<std::pair<unsigned int, unsigned int>> history; // (sector, speed) for each change
+
+}; // END class SpeedController()
+
+SpeedController::SpeedController(Dvd *dvd, unsigned int max_speed = constants::MAX_SPEED,
+                                 bool adaptive = false, bool verbose = false)
+    : dvd(dvd), adaptive(adaptive), verbose(verbose), max_speed(max_speed),
+      min_speed(constants::DVD_SPEED_1X), failures(0), window_start(0), clean(0),
+      window(2 * constants::SECTORS_PER_CACHE), threshold(2),
+      recovery(20 * constants::SECTORS_PER_CACHE) {
+  // Constructor for the speed controller.
+  //
+  // Args:
+  //     dvd (Dvd *): drive to control
+  //     max_speed (unsigned int): fastest allowed speed in kB/s (default: constants::MAX_SPEED)
+  //     adaptive (bool): adapt speed to failures when true (default: false)
+  //     verbose (bool): when true print command details (default: false)
+
+}; // END SpeedController::SpeedController()
+
+int SpeedController::Change(unsigned int speed, unsigned int sector) {
+  // Change the drive speed and log the change against the current sector.
+  //
+  // Args:
+  //     speed (unsigned int): new speed in kB/s (constants::MAX_SPEED = maximum)
+  //     sector (unsigned int): sector where the change occurs
+  //
+  // Returns:
+  //     (int): command status (0 = success, -1 = fail)
+
+  int status = dvd->SetSpeed(speed, verbose);
+
+  if (status != 0) {
+    printf("\r\x1b[Kdvdcc:speed:SpeedController:Change() Drive rejected speed %u kB/s at sector %u\n",
+           speed, sector);
+    return status;
+  }
+
+  history.push_back(std::make_pair(sector, speed));
+
+  if (speed == constants::MAX_SPEED)
+    printf("\r\x1b[KSpeed set to maximum at sector %u\n", sector);
+  else
+    printf("\r\x1b[KSpeed set to %.1fx (%u kB/s) at sector %u\n",
+           float(speed) / constants::DVD_SPEED_1X, speed, sector);
+
+  return 0;
+
+}; // END SpeedController::Change()
+
+void SpeedController::Failure(unsigned int sector) {
+  // Count a failed sector and slow the drive when failures cluster.
+  //
+  // Args:
+  //     sector (unsigned int): sector that failed EDC
+
+  clean = 0;
+
+  if (!adaptive) return;
+
+  // restart the window when this failure is far from the previous ones
+  if (failures == 0 || sector < window_start || sector - window_start >= window) {
+    window_start = sector;
+    failures = 0;
+  }
+
+  if (++failures < threshold) return;
+
+  failures = 0;
+
+  // the drive does not report its current maximum speed, so the first
+  // step down from maximum goes to half of a 16x drive
+  unsigned int current = dvd->speed == constants::MAX_SPEED ? 16 * constants::DVD_SPEED_1X : dvd->speed;
+  unsigned int slower = current / 2 < min_speed ? min_speed : current / 2;
+
+  if (slower < current)
+    Change(slower, sector);
+
+}; // END SpeedController::Failure()
+
+void SpeedController::Success(unsigned int sector) {
+  // Count a clean sector and speed the drive back up after a long clean run.
+  //
+  // Args:
+  //     sector (unsigned int): sector that passed EDC
+
+  clean++;
+
+  if (!adaptive || clean < recovery) return;
+  if (dvd->speed == max_speed || dvd->speed == constants::MAX_SPEED) return;
+
+  clean = 0;
+
+  unsigned int faster = 2 * dvd->speed;
+  if (max_speed != constants::MAX_SPEED && faster > max_speed) faster = max_speed;
+  if (max_speed == constants::MAX_SPEED && faster >= 16 * constants::DVD_SPEED_1X) faster = max_speed;
+
+  Change(faster, sector);
+
+}; // END SpeedController::Success()
+
+#endif // DVDCC_SPEED_H_
@@ -0,0 +1,127 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_THREADS_H_
+#define DVDCC_THREADS_H_
+
+#include <queue>
+#include <vector>
+#include <memory>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// Class for running CPU work such as compression and EDC checks on a
+// fixed set of worker threads. Tasks are queued with Submit() and their
+// results are returned through futures.
+class ThreadPool {
+
+ public:
+  ThreadPool(unsigned int threads);
+  ~ThreadPool();
+
+  template <class F>
+  std::future<typename std::invoke_result<F>::type> Submit(F task); // queue a task
+
+  void Run(void);                                                    // worker thread loop
+
+  unsigned int size;                        // number of worker threads
+  bool stopping;                            // set when the pool is destroyed
+
+  std::queue<std::function<void()>> tasks;  // queued tasks
+  std::vector<std::thread> workers;         // worker threads
+  std::mutex mutex;
+  std::condition_variable cond;
+
+}; // END class ThreadPool()
+
+ThreadPool::ThreadPool(unsigned int threads = 0) : stopping(false) {
+  // Constructor that starts the worker threads.
+  //
+  // Args:
+  //     threads (unsigned int): number of worker threads (default: 0 = one per core)
+
+  size = threads ? threads : std::thread::hardware_concurrency();
+  if (size == 0) size = 1;
+
+  for (unsigned int i = 0; i < size; i++)
+    workers.push_back(std::thread(&ThreadPool::Run, this));
+
+}; // END ThreadPool::ThreadPool()
+
+ThreadPool::~ThreadPool() {
+  // Destructor that finishes queued tasks and joins the worker threads.
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cond.notify_all();
+
+  for (unsigned int i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+}; // END ThreadPool::~ThreadPool()
+
+template <class F>
+std::future<typename std::invoke_result<F>::type> ThreadPool::Submit(F task) {
+  // Queue a task for the worker threads.
+  //
+  // Args:
+  //     task (F): callable taking no arguments
+  //
+  // Returns:
+  //     (std::future): future holding the task result
+
+  typedef typename std::invoke_result<F>::type result_type;
+
+  auto packaged = std::make_shared<std::packaged_task<result_type()>>(std::move(task));
+  std::future<result_type> result = packaged->get_future();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push([packaged]() { (*packaged)(); });
+  }
+  cond.notify_one();
+
+  return result;
+
+}; // END ThreadPool::Submit()
+
+void ThreadPool::Run(void) {
+  // Worker thread loop that runs tasks until the pool is stopping.
+
+  while (true) {
+
+    std::function<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] { return stopping || !tasks.empty(); });
+      if (tasks.empty()) return;
+      task = std::move(tasks.front());
+      tasks.pop();
+    }
+
+    task();
+
+  } // END while (true)
+
+}; // END ThreadPool::Run()
+
+#endif // DVDCC_THREADS_H_
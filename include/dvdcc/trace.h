@@ -0,0 +1,387 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_TRACE_H_
+#define DVDCC_TRACE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <linux/cdrom.h>
+
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Functions for recording every SCSI command sent to a drive into a binary
+// trace and for replaying a trace in place of the drive, so a session can
+// be reproduced without the drive or the disc.
+//
+// A trace is a gzip stream of little endian fields: an 8 byte magic and a
+// 32 bit version and flags, followed by records. Command records hold the
+// 12 command bytes, direction, status, sense data, start time and duration
+// in ns, the buffer length, the CRC32 of the buffer and the stored buffer
+// bytes. Value records hold host values that commands depend on.
+namespace trace {
+
+const char MAGIC[8] = {'D', 'V', 'D', 'C', 'C', 'T', 'R', 'C'};
+const unsigned int VERSION = 1;
+
+const unsigned int FLAG_COMPACT = 1;         // large buffers stored as a CRC32 and a sample
+const unsigned int FULL_BUFFER = 4096;       // compact traces store buffers up to this size in full
+const unsigned int SAMPLE_SIZE = 64;         // bytes stored from larger buffers of compact traces
+
+const unsigned char RECORD_COMMAND = 1;
+const unsigned char RECORD_VALUE = 2;
+const unsigned char RECORD_SENSE = 1;        // command record flag: sense data follows
+
+enum Mode { OFF, RECORD, REPLAY };
+
+Mode mode = OFF;
+gzFile file = NULL;
+unsigned int flags = 0;
+bool timing = false;                         // replay sleeps for the recorded command durations
+unsigned long long records = 0;              // records written or replayed
+std::chrono::steady_clock::time_point origin;
+std::recursive_mutex mutex;                  // recursive so exit() from a failed replay can still close the trace
+
+// command record without the buffer bytes
+struct Command {
+  unsigned char cmd[12];
+  unsigned char direction;
+  unsigned char flags;
+  int status;
+  unsigned long long start;                  // ns since the trace started
+  unsigned long long duration;               // ns spent in the drive
+  unsigned int buflen;
+  unsigned int crc;                          // CRC32 of the whole buffer
+  unsigned int stored;                       // buffer bytes that follow
+};
+
+void Put(std::vector<unsigned char> &out, unsigned long long value, unsigned int bytes) {
+  // Append a little endian integer.
+  //
+  // Args:
+  //     out (std::vector<unsigned char> &): record being built
+  //     value (unsigned long long): value
+  //     bytes (unsigned int): width of the field
+
+  for (unsigned int i = 0; i < bytes; i++) out.push_back((value >> (8 * i)) & 0xFF);
+
+}; // END trace::Put()
+
+int Get(unsigned long long *value, unsigned int bytes) {
+  // Read a little endian integer from the trace being replayed.
+  //
+  // Args:
+  //     value (unsigned long long *): returned value
+  //     bytes (unsigned int): width of the field
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = end of trace)
+
+  unsigned char field[8];
+  if (gzread(file, field, bytes) != (int)bytes) return -1;
+
+  *value = 0;
+  for (unsigned int i = 0; i < bytes; i++) *value |= (unsigned long long)field[i] << (8 * i);
+
+  return 0;
+
+}; // END trace::Get()
+
+void Close(void) {
+  // Finish the trace. Registered with atexit() so traces of sessions that
+  // end on an error are still complete.
+
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if (file == NULL) return;
+
+  gzclose(file);
+  file = NULL;
+
+  fprintf(stderr, "dvdcc:trace:Close() %s %llu records.\n", mode == RECORD ? "Recorded" : "Replayed", records);
+
+  mode = OFF;
+
+}; // END trace::Close()
+
+int Record(const char *path, bool compact) {
+  // Start recording every command sent to a drive.
+  //
+  // Args:
+  //     path (const char *): path to the trace
+  //     compact (bool): store large buffers as a CRC32 and a sample instead of in full
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  // fast compression keeps the recorder out of the way of the reads
+  file = gzopen(path, "wb1");
+  if (file == NULL) {
+    printf("dvdcc:trace:Record() Cannot create %s\n", path);
+    return -1;
+  }
+
+  flags = compact ? FLAG_COMPACT : 0;
+
+  std::vector<unsigned char> header(MAGIC, MAGIC + 8);
+  Put(header, VERSION, 4);
+  Put(header, flags, 4);
+  gzwrite(file, header.data(), header.size());
+
+  mode = RECORD;
+  records = 0;
+  origin = std::chrono::steady_clock::now();
+  atexit(Close);
+
+  return 0;
+
+}; // END trace::Record()
+
+int Replay(const char *path, bool original_timing) {
+  // Start answering commands from a recorded trace instead of a drive.
+  //
+  // Args:
+  //     path (const char *): path to the trace
+  //     original_timing (bool): take as long as the drive did for each command
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  file = gzopen(path, "rb");
+  if (file == NULL) {
+    printf("dvdcc:trace:Replay() Cannot open %s\n", path);
+    return -1;
+  }
+
+  char magic[8];
+  unsigned long long version, value;
+  if (gzread(file, magic, 8) != 8 || memcmp(magic, MAGIC, 8) != 0 || Get(&version, 4) != 0 || Get(&value, 4) != 0) {
+    printf("dvdcc:trace:Replay() %s is not a dvdcc trace.\n", path);
+    gzclose(file);
+    file = NULL;
+    return -1;
+  }
+
+  if (version != VERSION) {
+    printf("dvdcc:trace:Replay() %s has unsupported version %llu.\n", path, version);
+    gzclose(file);
+    file = NULL;
+    return -1;
+  }
+
+  // compact traces lack the sectors read, so key searches fail EDC and diverge at once
+  if (value & FLAG_COMPACT) {
+    printf("dvdcc:trace:Replay() %s is compact and cannot reproduce sector data.\n", path);
+    printf("dvdcc:trace:Replay() Record the session again without --trace-compact.\n");
+    gzclose(file);
+    file = NULL;
+    return -1;
+  }
+
+  flags = value;
+
+  mode = REPLAY;
+  records = 0;
+  timing = original_timing;
+  atexit(Close);
+
+  return 0;
+
+}; // END trace::Replay()
+
+void Diverged(const char *reason) {
+  // Stop a replay that no longer follows the trace.
+  //
+  // Args:
+  //     reason (const char *): what differs from the trace
+
+  printf("\ndvdcc:trace:Diverged() Record %llu: %s\n", records, reason);
+  printf("dvdcc:trace:Diverged() Exiting...\n");
+  exit(0);
+
+}; // END trace::Diverged()
+
+void RecordCommand(unsigned char *cmd, unsigned char *buffer, int buflen, int direction, int status,
+                   request_sense *sense, std::chrono::steady_clock::time_point start,
+                   std::chrono::steady_clock::time_point end) {
+  // Append a command and its result to the trace being recorded.
+  //
+  // Args:
+  //     cmd (unsigned char *): the 12 command bytes
+  //     buffer (unsigned char *): bytes returned by or sent to the drive
+  //     buflen (int): length of the buffer
+  //     direction (int): CGC_DATA_READ, CGC_DATA_WRITE or CGC_DATA_NONE
+  //     status (int): command status
+  //     sense (request_sense *): SCSI sense data of the command
+  //     start (time_point): when the command was sent
+  //     end (time_point): when the command returned
+
+  unsigned int length = buffer && buflen > 0 ? buflen : 0;
+  unsigned int stored = length;
+  if ((flags & FLAG_COMPACT) && length > FULL_BUFFER) stored = SAMPLE_SIZE;
+
+  bool has_sense = status != 0 || sense->sense_key != 0;
+
+  std::vector<unsigned char> record;
+  record.reserve(64 + sizeof(request_sense));
+  record.push_back(RECORD_COMMAND);
+  record.insert(record.end(), cmd, cmd + 12);
+  record.push_back(direction);
+  record.push_back(has_sense ? RECORD_SENSE : 0);
+  Put(record, (unsigned int)status, 4);
+  Put(record, std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count(), 8);
+  Put(record, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), 8);
+  Put(record, length, 4);
+  Put(record, length ? crc32(0, buffer, length) : 0, 4);
+  Put(record, stored, 4);
+  if (has_sense)
+    record.insert(record.end(), (unsigned char *)sense, (unsigned char *)sense + sizeof(request_sense));
+
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if (mode != RECORD) return;
+
+  gzwrite(file, record.data(), record.size());
+  if (stored) gzwrite(file, buffer, stored);
+  records++;
+
+}; // END trace::RecordCommand()
+
+int ReplayCommand(unsigned char *cmd, unsigned char *buffer, int buflen, int direction, request_sense *sense) {
+  // Answer a command with the next record of the trace being replayed.
+  // Replays stop when the command differs from the recorded one.
+  //
+  // Args:
+  //     cmd (unsigned char *): the 12 command bytes
+  //     buffer (unsigned char *): filled with the recorded bytes for reads
+  //     buflen (int): length of the buffer
+  //     direction (int): CGC_DATA_READ, CGC_DATA_WRITE or CGC_DATA_NONE
+  //     sense (request_sense *): filled with the recorded sense data
+  //
+  // Returns:
+  //     (int): recorded command status
+
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  Command command;
+  unsigned long long kind, value;
+
+  if (mode != REPLAY || Get(&kind, 1) != 0) Diverged("the trace ended before this command.");
+  if (kind != RECORD_COMMAND) Diverged("expected a host value, not a command.");
+
+  if (gzread(file, command.cmd, 12) != 12) Diverged("truncated record.");
+  Get(&value, 1); command.direction = value;
+  Get(&value, 1); command.flags = value;
+  Get(&value, 4); command.status = (int)(unsigned int)value;
+  Get(&command.start, 8);
+  Get(&command.duration, 8);
+  Get(&value, 4); command.buflen = value;
+  Get(&value, 4); command.crc = value;
+  if (Get(&value, 4) != 0) Diverged("truncated record.");
+  command.stored = value;
+
+  if (memcmp(command.cmd, cmd, 12) != 0) {
+    char reason[160];
+    int n = sprintf(reason, "command");
+    for (int i = 0; i < 12; i++) n += sprintf(reason + n, " %02x", cmd[i]);
+    n += sprintf(reason + n, " was recorded as");
+    for (int i = 0; i < 12; i++) n += sprintf(reason + n, " %02x", command.cmd[i]);
+    Diverged(reason);
+  }
+
+  unsigned int length = buffer && buflen > 0 ? buflen : 0;
+  if (command.buflen != length || command.direction != direction)
+    Diverged("buffer length or direction differs from the trace.");
+
+  memset(sense, 0, sizeof(request_sense));
+  if ((command.flags & RECORD_SENSE) && gzread(file, sense, sizeof(request_sense)) != (int)sizeof(request_sense))
+    Diverged("truncated sense data.");
+
+  if (command.stored > length) Diverged("stored buffer is larger than the command buffer.");
+
+  if (direction == CGC_DATA_WRITE) {
+    // bytes sent to the drive are only compared
+    std::vector<unsigned char> sent(command.stored);
+    if (command.stored && gzread(file, sent.data(), command.stored) != (int)command.stored)
+      Diverged("truncated buffer.");
+    if (length && crc32(0, buffer, length) != command.crc)
+      Diverged("bytes sent to the drive differ from the trace.");
+  } else if (length) {
+    // bytes missing from the trace are zeroed rather than left stale
+    if (command.stored < length) memset(buffer + command.stored, 0, length - command.stored);
+    if (command.stored && gzread(file, buffer, command.stored) != (int)command.stored)
+      Diverged("truncated buffer.");
+  }
+
+  records++;
+
+  if (timing)
+    std::this_thread::sleep_for(std::chrono::nanoseconds(command.duration));
+
+  return command.status;
+
+}; // END trace::ReplayCommand()
+
+unsigned long long Value(unsigned long long value) {
+  // Pass a host value that later commands depend on (e.g. the transfer
+  // size of the block device) through the trace. Recording stores the
+  // value, while replaying returns the recorded one in its place.
+  //
+  // Args:
+  //     value (unsigned long long): value found on this host
+  //
+  // Returns:
+  //     (unsigned long long): value to use
+
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if (mode == RECORD) {
+    std::vector<unsigned char> record(1, RECORD_VALUE);
+    Put(record, value, 8);
+    gzwrite(file, record.data(), record.size());
+    records++;
+  } else if (mode == REPLAY) {
+    unsigned long long kind;
+    if (Get(&kind, 1) != 0 || kind != RECORD_VALUE || Get(&value, 8) != 0)
+      Diverged("expected a host value.");
+    records++;
+  }
+
+  return value;
+
+}; // END trace::Value()
+
+void Sleep(unsigned int seconds) {
+  // Wait for the drive, unless a trace is replayed at full speed.
+  //
+  // Args:
+  //     seconds (unsigned int): seconds to wait
+
+  if (mode == REPLAY && !timing) return;
+
+  sleep(seconds);
+
+}; // END trace::Sleep()
+
+} // namespace trace
+
+#endif // DVDCC_TRACE_H_
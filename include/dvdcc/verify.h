@@ -0,0 +1,385 @@
+// Copyright (C) 2025     Josh Wood
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef DVDCC_VERIFY_H_
+#define DVDCC_VERIFY_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <string>
+#include <vector>
+
+#include "dvdcc/constants.h"
+#include "dvdcc/devices.h"
+#include "dvdcc/layout.h"
+#include "dvdcc/progress.h"
+#include "dvdcc/sinks.h"
+#include "dvdcc/chunks.h"
+#include "dvdcc/hashes.h"
+#include "dvdcc/junk.h"
+
+namespace verify {
+
+// Block index sidecar format
+//
+//   header   16 bytes
+//             0  8 bytes  magic "DVDCCB01"
+//             8  4 bytes  sectors per block
+//            12  4 bytes  number of disc sectors
+//   entries  20 byte SHA-1 of the ISO bytes of each block, in order
+//
+// All integers are little endian. Blocks match the cache blocks read
+// from the drive, so a disc can be checked one cache read at a time.
+const char MAGIC[8] = {'D', 'V', 'D', 'C', 'C', 'B', '0', '1'};
+const unsigned int HEADER_SIZE = 16;
+const unsigned int ENTRY_SIZE = 20;
+
+void HashBlock(const unsigned char *data, size_t size, unsigned char *digest) {
+  // Compute the index entry of a block.
+  //
+  // Args:
+  //     data (const unsigned char *): ISO bytes of the block
+  //     size (size_t): number of bytes
+  //     digest (unsigned char *): buffer for ENTRY_SIZE bytes
+
+  Sha1 sha1;
+  sha1.Update(data, size);
+  sha1.Final(digest);
+
+}; // END verify::HashBlock()
+
+} // namespace verify
+
+// Class for writing the block index of an ISO backup as it is written.
+// Sectors are passed through to the wrapped output.
+class BlockIndexSink : public Sink {
+
+ public:
+  BlockIndexSink(Sink *sink, const char *path, bool resume, unsigned int start_sector, unsigned int sector_number);
+  ~BlockIndexSink() { delete sink; };
+
+  int Write(unsigned int sector, unsigned char *data);
+  int Skip(unsigned int sector, unsigned int count);
+  int Close(void);
+  int Flush(void);                          // write the entry of the buffered block
+
+  Sink *sink;                               // wrapped ISO output
+  FILE *index;                              // block index sidecar
+  unsigned int sectors_per_block;           // sectors in a block
+  std::vector<unsigned char> block;         // buffered block
+
+}; // END class BlockIndexSink()
+
+BlockIndexSink::BlockIndexSink(Sink *sink, const char *path, bool resume, unsigned int start_sector,
+                               unsigned int sector_number)
+    : Sink(sink->sector_size), sink(sink), sectors_per_block(constants::SECTORS_PER_CACHE) {
+  // Constructor that creates the block index, or continues it from the
+  // last whole block when resuming.
+  //
+  // Args:
+  //     sink (Sink *): ISO output to wrap (deleted with the BlockIndexSink)
+  //     path (const char *): path of the ISO output
+  //     resume (bool): true when continuing an existing ISO
+  //     start_sector (unsigned int): first sector the backup loop will write
+  //     sector_number (unsigned int): number of disc sectors
+
+  std::string index_path = std::string(path) + ".blocks";
+  unsigned int first_block = start_sector / sectors_per_block;
+
+  index = fopen(index_path.c_str(), resume ? "r+b" : "wb");
+  if (index == NULL) {
+    printf("dvdcc:verify:BlockIndexSink() Cannot open block index %s\n", index_path.c_str());
+    printf("dvdcc:verify:BlockIndexSink() Exiting...\n");
+    exit(0);
+  }
+
+  if (!resume) {
+    unsigned char header[verify::HEADER_SIZE];
+    memcpy(header, verify::MAGIC, 8);
+    chunks::Put32(header + 8, sectors_per_block);
+    chunks::Put32(header + 12, sector_number);
+    fwrite(header, 1, verify::HEADER_SIZE, index);
+    return;
+  }
+
+  // drop entries beyond the last whole block of the ISO
+  off_t end = verify::HEADER_SIZE + (off_t)first_block * verify::ENTRY_SIZE;
+  fseeko(index, 0, SEEK_END);
+  if (ftello(index) < end) {
+    printf("dvdcc:verify:BlockIndexSink() Block index %s is behind the ISO. Cannot resume.\n", index_path.c_str());
+    printf("dvdcc:verify:BlockIndexSink() Exiting...\n");
+    exit(0);
+  }
+  if (ftruncate(fileno(index), end) != 0 || fseeko(index, end, SEEK_SET) != 0) {
+    printf("dvdcc:verify:BlockIndexSink() Cannot resume block index %s\n", index_path.c_str());
+    printf("dvdcc:verify:BlockIndexSink() Exiting...\n");
+    exit(0);
+  }
+
+  // read back the part of the block written before the interruption
+  size_t size = (size_t)(start_sector - first_block * sectors_per_block) * sector_size;
+  block.resize(size);
+  if (size && junk::Read(path, (unsigned long long)first_block * sectors_per_block * sector_size,
+                         block.data(), size) != 0) {
+    printf("dvdcc:verify:BlockIndexSink() Cannot read %s to resume the block index\n", path);
+    printf("dvdcc:verify:BlockIndexSink() Exiting...\n");
+    exit(0);
+  }
+
+}; // END BlockIndexSink::BlockIndexSink()
+
+int BlockIndexSink::Flush(void) {
+  // Write the index entry of the buffered block.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (block.empty()) return 0;
+
+  unsigned char digest[verify::ENTRY_SIZE];
+  verify::HashBlock(block.data(), block.size(), digest);
+  block.clear();
+
+  return fwrite(digest, 1, verify::ENTRY_SIZE, index) == verify::ENTRY_SIZE ? 0 : -1;
+
+}; // END BlockIndexSink::Flush()
+
+int BlockIndexSink::Write(unsigned int sector, unsigned char *data) {
+  // Write a sector to the wrapped output and add it to its block.
+  //
+  // Args:
+  //     sector (unsigned int): sector number (sectors arrive in order)
+  //     data (unsigned char *): sector bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (sink->Write(sector, data) != 0) return -1;
+
+  block.insert(block.end(), data, data + sector_size);
+  if ((sector + 1) % sectors_per_block == 0) return Flush();
+
+  return 0;
+
+}; // END BlockIndexSink::Write()
+
+int BlockIndexSink::Skip(unsigned int sector, unsigned int count) {
+  // Skip sectors in the wrapped output and index them as zeros.
+  //
+  // Args:
+  //     sector (unsigned int): first sector to skip
+  //     count (unsigned int): number of sectors
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  if (sink->Skip(sector, count) != 0) return -1;
+
+  for (unsigned int i = 0; i < count; i++) {
+    block.insert(block.end(), sector_size, 0);
+    if ((sector + i + 1) % sectors_per_block == 0 && Flush() != 0) return -1;
+  }
+
+  return 0;
+
+}; // END BlockIndexSink::Skip()
+
+int BlockIndexSink::Close(void) {
+  // Index the final partial block and close both outputs.
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  int status = Flush();
+  if (fclose(index) != 0) status = -1;
+  if (sink->Close() != 0) status = -1;
+
+  return status;
+
+}; // END BlockIndexSink::Close()
+
+namespace verify {
+
+int Disc(Dvd &dvd, const char *image_path, bool keep_going, bool verbose) {
+  // Compare a disc against an archived ISO one cache block at a time.
+  // The block index at image_path + ".blocks" is used when it exists,
+  // so only the small index has to be available, otherwise the blocks
+  // are compared with the image itself (plain or compressed). Keys must
+  // be found with Dvd::FindKeys() first.
+  //
+  // Args:
+  //     dvd (Dvd &): drive with keys found
+  //     image_path (const char *): path to the archived ISO
+  //     keep_going (bool): when true log every divergence instead of
+  //                        stopping at the first one
+  //     verbose (bool): when true print command details
+  //
+  // Returns:
+  //     (int): status (0 = identical, 1 = divergent or unreadable)
+
+  std::string index_path = std::string(image_path) + ".blocks";
+  std::vector<unsigned char> entries;
+  ChunkReader reader;
+  bool compressed = false, indexed = false, elided = false;
+  int fd = -1;
+
+  // junk map of an image backed up with --elide-junk
+  unsigned char disc_id[4], disc_number;
+  std::vector<unsigned int> regions;
+
+  unsigned char header[HEADER_SIZE];
+  FILE *fp = fopen(index_path.c_str(), "rb");
+
+  if (fp) {
+
+    indexed = true;
+    bool ok = fread(header, 1, HEADER_SIZE, fp) == HEADER_SIZE && memcmp(header, MAGIC, 8) == 0 &&
+              chunks::Get32(header + 8) == constants::SECTORS_PER_CACHE;
+    unsigned int sector_number = ok ? chunks::Get32(header + 12) : 0;
+
+    entries.resize((size_t)(sector_number + constants::SECTORS_PER_CACHE - 1) / constants::SECTORS_PER_CACHE * ENTRY_SIZE);
+    entries.resize(fread(entries.data(), 1, entries.size(), fp) / ENTRY_SIZE * ENTRY_SIZE);
+    fclose(fp);
+
+    if (!ok) {
+      printf("dvdcc:verify:Disc() Invalid block index %s\n", index_path.c_str());
+      return 1;
+    }
+
+    printf("Verifying against block index %s\n\n", index_path.c_str());
+
+    if (sector_number != dvd.sector_number)
+      printf(" Archived image has %u sectors, disc has %u\n\n", sector_number, dvd.sector_number);
+
+  } else if (reader.Open(image_path) == 0) {
+
+    compressed = true;
+    printf("Verifying against compressed image %s\n\n", image_path);
+
+  } else {
+
+    fd = open(image_path, O_RDONLY);
+    if (fd < 0) {
+      printf("dvdcc:verify:Disc() Cannot open %s or %s\n", image_path, index_path.c_str());
+      return 1;
+    }
+    printf("Verifying against image %s\n\n", image_path);
+
+    // images backed up with --elide-junk read back through their junk map, see junk::Read()
+    std::string map_path = std::string(image_path) + ".junk";
+    elided = junk::ReadMap(map_path.c_str(), disc_id, &disc_number, &regions) == 0;
+    if (elided) printf(" Regenerating junk listed in %s\n\n", map_path.c_str());
+
+  } // END if/else (fp)
+
+  const unsigned int buflen = constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE;
+  std::vector<unsigned char> buffer(buflen), disc(constants::SECTORS_PER_CACHE * constants::SECTOR_SIZE);
+  std::vector<unsigned char> image(constants::SECTORS_PER_CACHE * constants::SECTOR_SIZE);
+  unsigned char digest[ENTRY_SIZE];
+  unsigned int divergent = 0;
+
+  Progress progress("Progress");
+  progress.Start();
+
+  // the layout of the disc is selected once for the whole loop
+  layout::Select(dvd.dvd_rom, [&](auto disc_layout) {
+    using Layout = decltype(disc_layout);
+
+    for (unsigned int cache_start = 0; cache_start < dvd.sector_number; cache_start += constants::SECTORS_PER_CACHE) {
+
+      unsigned int count = dvd.sector_number - cache_start < constants::SECTORS_PER_CACHE ?
+                           dvd.sector_number - cache_start : constants::SECTORS_PER_CACHE;
+      size_t size = (size_t)count * constants::SECTOR_SIZE;
+
+      if (dvd.ReadCacheBlock<Layout>(cache_start, buffer.data(), 20, verbose) != 0) {
+        printf("\r\x1b[K Cannot read block at sector %u\n", cache_start);
+        divergent++;
+        if (!keep_going) break;
+        continue;
+      }
+
+      layout::Extract<Layout>(buffer.data(), count, disc.data());
+
+      bool match;
+      unsigned int first_sector = cache_start;
+
+      if (indexed) {
+
+        size_t entry = (size_t)cache_start / constants::SECTORS_PER_CACHE * ENTRY_SIZE;
+        HashBlock(disc.data(), size, digest);
+        match = entry < entries.size() && memcmp(digest, entries.data() + entry, ENTRY_SIZE) == 0;
+
+      } else {
+
+        bool read = true;
+        if (compressed) {
+          for (unsigned int n = 0; n < count && read; n++)
+            read = reader.Read(cache_start + n, image.data() + n * constants::SECTOR_SIZE) == 0;
+        } else {
+          read = pread(fd, image.data(), size, (off_t)cache_start * constants::SECTOR_SIZE) == (ssize_t)size;
+          if (read && elided)
+            junk::Regenerate(disc_id, disc_number, regions, (unsigned long long)cache_start * constants::SECTOR_SIZE,
+                             image.data(), size);
+        }
+
+        match = read && memcmp(disc.data(), image.data(), size) == 0;
+
+        // images are compared directly, so the first differing sector is known
+        if (read && !match) {
+          unsigned int n = 0;
+          while (memcmp(disc.data() + n * constants::SECTOR_SIZE, image.data() + n * constants::SECTOR_SIZE,
+                        constants::SECTOR_SIZE) == 0) n++;
+          first_sector = cache_start + n;
+        }
+
+      } // END if/else (indexed)
+
+      if (!match) {
+        printf("\r\x1b[K Block at sector %u differs", cache_start);
+        if (first_sector != cache_start) printf(" from sector %u", first_sector);
+        printf("\n");
+        divergent++;
+        if (!keep_going) break;
+      }
+
+      progress.Update(cache_start + count - 1, dvd.sector_number);
+
+    } // END for (cache_start)
+
+  });
+
+  progress.Finish();
+
+  if (fd >= 0) close(fd);
+
+  if (divergent) {
+    printf("\nDisc differs from %s (%u divergent block%s%s).\n", image_path, divergent,
+           divergent == 1 ? "" : "s", keep_going ? "" : ", stopped at the first");
+    return 1;
+  }
+
+  printf("\nDisc matches %s.\n", image_path);
+
+  return 0;
+
+}; // END verify::Disc()
+
+} // namespace verify
+
+#endif // DVDCC_VERIFY_H_
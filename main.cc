@@ -21,6 +21,8 @@
 
 #include <time.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <future>
 #include "dvdcc/options.h"
 #include "dvdcc/constants.h"
 #include "dvdcc/cypher.h"
@@ -28,66 +30,380 @@
 #include "dvdcc/devices.h"
 #include "dvdcc/ecma_267.h"
 #include "dvdcc/commands.h"
+#include "dvdcc/speed.h"
+#include "dvdcc/sinks.h"
+#include "dvdcc/chunks.h"
+#include "dvdcc/threads.h"
+#include "dvdcc/junk.h"
+#include "dvdcc/extents.h"
+#include "dvdcc/sidecar.h"
+#include "dvdcc/convert.h"
+#include "dvdcc/hashes.h"
+#include "dvdcc/verify.h"
+#include "dvdcc/repair.h"
+#include "dvdcc/backup.h"
+#include "dvdcc/batch.h"
+#include "dvdcc/shard.h"
+#include "dvdcc/nbd.h"
+#include "dvdcc/trace.h"
+#include "dvdcc/metrics.h"
+#include "dvdcc/scan.h"
+#include "dvdcc/dedup.h"
+#include "dvdcc/catalog.h"
+#include <sys/stat.h>
 #include <iostream>
 
-FILE *OpenAndResume(char *path, int resume,
-                    unsigned int *start_sector, unsigned int sector_size) {
-  // Method to open and resume from an existing file or create new file.
+int ReadFallbackSector(Dvd &dvd, unsigned int sector, unsigned char *data,
+                       SpeedController &speed, bool verbose) {
+  // Method to recover a single user data sector after a failed multi-sector
+  // READ(12). The sector is retried directly before falling back to the raw
+  // cache path, which decodes and verifies the sector with the disc keys.
   //
   // Args:
-  //     path (char *): path to the file
-  //     resume (int): set to 1 when resuming, otherwise 0
-  //     start_sector (unsigned int *): pointer to the starting sector used
-  //                                    in the backup loop.
-  //     sector_size (unsigned int): size of the file sectors in bytes
+  //     dvd (Dvd &): drive to read from
+  //     sector (unsigned int): sector to recover
+  //     data (unsigned char *): buffer for the 2048 user data bytes
+  //     speed (SpeedController &): speed controller notified of failures
+  //     verbose (bool): set to true to print more details to stdout
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  // retry the sector on its own with force unit access, counting the
+  // failing sector once however many attempts it needs
+  for (int retry = 0; retry < 3; retry++) {
+    if (commands::ReadSectors(dvd.fd, data, sector, 1, false, dvd.timeout, verbose, NULL) == 0)
+      return 0;
+    if (retry == 0) speed.Failure(sector);
+  }
 
-  // resume from last file sector
-  if (resume) {
+  printf("\r\x1b[KFalling back to raw read for sector %u\n", sector);
 
-    FILE *fp = fopen(path, "a+b");
+  // keys are only found once the first sector needs them
+  if (dvd.cypher_number == 0 && dvd.FindKeys(20, verbose) != 0)
+    return -1;
 
-    // get file size
-    fseek(fp, 0, SEEK_END);
-    unsigned int fsize = ftell(fp);
+  const int buflen = constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE;
+  unsigned char *buffer = (unsigned char *)malloc(buflen);
+  unsigned int cache_start = sector / constants::SECTORS_PER_CACHE * constants::SECTORS_PER_CACHE;
+  unsigned char *raw_sector = buffer + sector % constants::SECTORS_PER_CACHE * constants::RAW_SECTOR_SIZE;
 
-    // ensure it is a multiple of sector size
-    if (fsize % sector_size != 0) {
-      printf("dvdcc:main() Cannot resume from incomplete sector. Trim file to nearest %lu bytes before resuming.\n", sector_size);
-      printf("dvdcc:main() Exiting...\n");
-      exit(0);
+  for (int retry = 0; retry < 20; retry++) {
+
+    dvd.ReadRawSectorCache(cache_start, buffer, verbose);
+
+    // only standard DVDs take the fast path, so the sector layout is known
+    if (dvd.DecodeSectors<layout::DvdRom>(sector, 1, raw_sector) == 0) {
+      memcpy(data, layout::Payload<layout::DvdRom>(raw_sector), constants::SECTOR_SIZE);
+      free(buffer);
+      return 0;
+    }
+
+    printf("\r\x1b[KRetrying sector %u (attempt %d)\n", sector, retry+1);
+    dvd.counters->edc_failures.fetch_add(1, std::memory_order_relaxed);
+
+    dvd.ClearSectorCache(cache_start, verbose);
+    trace::Sleep(1);
+
+  } // END for (retry)
+
+  free(buffer);
+
+  return -1;
+
+}; // END ReadFallbackSector()
+
+int WriteSectors(Sink *sink, unsigned int sector, unsigned int count, unsigned char *data) {
+  // Method to write consecutive sectors to an output.
+  //
+  // Args:
+  //     sink (Sink *): output for the sectors
+  //     sector (unsigned int): first sector number
+  //     count (unsigned int): number of sectors
+  //     data (unsigned char *): sector bytes
+  //
+  // Returns:
+  //     (int): status (0 = success, -1 = fail)
+
+  for (unsigned int n = 0; n < count; n++)
+    if (sink->Write(sector + n, data + n * sink->sector_size) != 0)
+      return -1;
+
+  return 0;
+
+}; // END WriteSectors()
+
+int FastIsoBackup(Dvd &dvd, Sink *iso_sink, unsigned int start_sector, unsigned int end_sector,
+                  SpeedController &speed, Progress &progress, bool verbose) {
+  // Method to back up a standard DVD as ISO using large multi-sector READ(12)
+  // transfers. Two buffers are used so the next transfer from the drive
+  // overlaps with writing the previous one to disk.
+  //
+  // Args:
+  //     dvd (Dvd &): drive to read from
+  //     iso_sink (Sink *): ISO output opened by OpenSink()
+  //     start_sector (unsigned int): first sector to read
+  //     end_sector (unsigned int): sector after the last to read
+  //     speed (SpeedController &): speed controller notified of reads
+  //     progress (Progress &): progress tracker
+  //     verbose (bool): set to true to print more details to stdout
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = fail)
+
+  unsigned int chunk = dvd.MaxTransferSectors();
+  unsigned char *buffers[2];
+  buffers[0] = (unsigned char *)malloc(chunk * constants::SECTOR_SIZE);
+  buffers[1] = (unsigned char *)malloc(chunk * constants::SECTOR_SIZE);
+
+  if (verbose)
+    printf("dvdcc:main:FastIsoBackup() Reading %u sectors per transfer\n", chunk);
+
+  std::future<int> pending; // write of the previous transfer
+  int status = 0, current = 0;
+
+  for (unsigned int sector = start_sector; sector < end_sector; ) {
+
+    unsigned int count = end_sector - sector < chunk ? end_sector - sector : chunk;
+    unsigned char *buffer = buffers[current];
+
+    if (commands::ReadSectors(dvd.fd, buffer, sector, count, true, dvd.timeout, verbose, NULL) == 0) {
+      for (unsigned int n = 0; n < count; n++) speed.Success(sector + n);
+    } else {
+      for (unsigned int n = 0; n < count && status == 0; n++) {
+        if (ReadFallbackSector(dvd, sector + n, buffer + n * constants::SECTOR_SIZE, speed, verbose) != 0) {
+          printf("dvdcc:main() Cannot read sector %u\n", sector + n);
+          status = 1;
+        }
+      }
+    } // END if/else (commands::ReadSectors)
+
+    // wait for the previous write before queuing this one
+    if (pending.valid() && pending.get() != 0) {
+      printf("dvdcc:main() Failed writing ISO output\n");
+      status = 1;
     }
 
-    *start_sector = fsize / sector_size;
+    if (status != 0) break;
 
-    return fp;
-  } // END if (resume)
+    pending = std::async(std::launch::async, WriteSectors, iso_sink, sector, count, buffer);
+    current = 1 - current;
+    dvd.counters->Read(sector, count, (unsigned long long)count * constants::SECTOR_SIZE);
+
+    sector += count;
+    progress.Update(sector - 1 - start_sector, end_sector - start_sector);
+
+  } // END for (sector)
 
-  // otherwise ensure we don't overwrite
-  if (access(path, F_OK) == 0) {
-    printf("dvdcc:main() File already exists. Delete or use --resume.\n");
+  if (pending.valid() && pending.get() != 0) {
+    printf("dvdcc:main() Failed writing ISO output\n");
+    status = 1;
+  }
+
+  if (status != 0)
     printf("dvdcc:main() Exiting...\n");
-    exit(0);
-  } // END if (access...)
 
-  // new file starting from 0
-  FILE *fp = fopen(path, "wb");
-  *start_sector = 0;
+  free(buffers[0]);
+  free(buffers[1]);
+
+  return status;
+
+}; // END FastIsoBackup()
 
-  return fp;
+template <class Layout>
+int RawBackup(Dvd &dvd, Outputs &outputs, ExtentMap *used, SpeedController &speed, Progress &progress,
+              bool verbose) {
+  // Method to back up a disc one sector at a time from the raw sector
+  // cache, descrambling and verifying each sector with the sector layout
+  // of the disc and retrying it until it passes its EDC.
+  //
+  // Args:
+  //     dvd (Dvd &): drive with keys found
+  //     outputs (Outputs &): open ISO, RAW and sidecar outputs
+  //     used (ExtentMap *): sectors holding data, others are left as holes (NULL = all)
+  //     speed (SpeedController &): speed controller notified of successes and failures
+  //     progress (Progress &): started progress tracker
+  //     verbose (bool): set to true to print more details to stdout
+  //
+  // Returns:
+  //     (int): status (0 = success, 1 = fail)
+
+  const int buflen = constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE;
+  unsigned char buffer[buflen];
+  unsigned char *raw_sector;
+  int status = 0;
+  unsigned int start_sector = outputs.start_sector, end_sector = outputs.end_sector, cache_start = 0;
+  unsigned int sector_bytes = outputs.SectorBytes();
+  Sink *iso_sink = outputs.iso, *raw_sink = outputs.raw, *sidecar_sink = outputs.sidecar;
+
+  // loop through dvd sectors
+  for (unsigned int sector = start_sector; sector < end_sector; sector++) {
+
+    // leave unused cache blocks as holes in selective mode
+    if (used && sector % constants::SECTORS_PER_CACHE == 0 && !used->Contains(sector)) {
+      unsigned int count = end_sector - sector < constants::SECTORS_PER_CACHE ?
+                           end_sector - sector : constants::SECTORS_PER_CACHE;
+      if ((iso_sink && iso_sink->Skip(sector, count) != 0) ||
+          (raw_sink && raw_sink->Skip(sector, count) != 0) ||
+          (sidecar_sink && sidecar_sink->Skip(sector, count) != 0)) {
+        printf("\r\x1b[Kdvdcc:RawBackup() Failed skipping sector %u\n", sector);
+        printf("dvdcc:RawBackup() Exiting...\n");
+        return 1;
+      }
+      sector += count - 1;
+      progress.Update(sector - start_sector, end_sector - start_sector);
+      continue;
+    }
+
+    // perform cache read if this is the start of a cache block or of the backup
+    if ((sector % constants::SECTORS_PER_CACHE == 0) || sector == start_sector) {
+      cache_start = (sector / constants::SECTORS_PER_CACHE) * constants::SECTORS_PER_CACHE;
+      dvd.ReadRawSectorCache(cache_start, buffer, verbose);
+    }
+
+    // point to the raw sector data
+    raw_sector = buffer + sector % constants::SECTORS_PER_CACHE * constants::RAW_SECTOR_SIZE;
+
+    // try decoding the raw sector data
+    for (int retry = 0; retry < 20; retry++) {
+
+      if (dvd.DecodeSectors<Layout>(sector, 1, raw_sector) == 0) {
+        speed.Success(sector);
+        if (iso_sink && iso_sink->Write(sector, layout::Payload<Layout>(raw_sector)) != 0) status = 1;
+        if (raw_sink && raw_sink->Write(sector, raw_sector) != 0) status = 1;
+        if (sidecar_sink && sidecar_sink->Write(sector, raw_sector) != 0) status = 1;
+        break;
+      }
+
+      printf("\r\x1b[KRetrying sector %lu (attempt %d)\n", sector, retry+1);
+
+      // slow the drive down when failing sectors cluster, counting each sector once
+      if (retry == 0) speed.Failure(sector);
+      dvd.counters->edc_failures.fetch_add(1, std::memory_order_relaxed);
+
+      if (retry == 19) {
+        printf("dvdcc:RawBackup() Cannot read sector %lu\n", sector);
+        printf("dvdcc:RawBackup() Exiting...\n");
+        return 1;
+      }
+
+      // decode failed so retry after clearing cache
+      dvd.ClearSectorCache(cache_start, verbose);
+      trace::Sleep(1);
+      dvd.ReadRawSectorCache(cache_start, buffer, verbose);
+
+    } // END for (retry)
+
+    // stop when an output no longer accepts data
+    if (status != 0) {
+      printf("\r\x1b[Kdvdcc:RawBackup() Failed writing sector %u\n", sector);
+      printf("dvdcc:RawBackup() Exiting...\n");
+      return 1;
+    }
 
-}; // END OpenAndResume()
+    dvd.counters->Read(sector, 1, sector_bytes);
+    progress.Update(sector - start_sector, end_sector - start_sector);
+
+  } // END for (sector)
+
+  return 0;
+
+}; // END RawBackup()
 
 int main(int argc, char **argv) {
 
+  // parse command line options
+  Options options;
+  options.Parse(argc, argv);
+
+  // when streaming a backup to stdout keep the original stdout for
+  // the backup bytes and send all messages to stderr instead
+  int stream_fd = STDOUT_FILENO;
+  if ((options.iso && strcmp(options.iso, "-") == 0) || (options.raw && strcmp(options.raw, "-") == 0)) {
+    if (options.iso && options.raw && strcmp(options.iso, options.raw) == 0) {
+      printf("dvdcc:main() Cannot stream ISO and RAW backups to stdout together.\n");
+      printf("dvdcc:main() Exiting...\n");
+      return 0;
+    }
+    stream_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+  }
+
   // welcome message
   printf("dvdcc version 0.2.0, Copyright (C) 2025 Josh Wood\n"
          "dvdcc comes with ABSOLUTELY NO WARRANTY; for details see LICENSE.\n"
          "This is free software, and you are welcome to redistribute it\n"
          "under certain conditions; see LICENSE for details.\n\n");
 
-  // parse command line options
-  Options options;
-  options.Parse(argc, argv);
+  // rebuild junk in an existing image without a drive
+  if (options.fill_junk) {
+    std::string map_path = std::string(options.fill_junk) + ".junk";
+    return junk::Fill(options.fill_junk, map_path.c_str()) == 0 ? 0 : 1;
+  }
+
+  // rebuild a RAW backup from an ISO and its sidecar without a drive
+  if (options.build_raw) {
+    if (options.raw == NULL) {
+      printf("dvdcc:main() Use --raw to choose the path of the rebuilt RAW backup.\n");
+      printf("dvdcc:main() Exiting...\n");
+      return 1;
+    }
+    std::string sidecar_path = std::string(options.build_raw) + ".sidecar";
+    return sidecar::Build(options.build_raw, sidecar_path.c_str(), options.raw, options.scramble) == 0 ? 0 : 1;
+  }
+
+  // convert and verify a RAW image without a drive
+  if (options.from_raw) {
+    if (options.iso && strcmp(options.iso, "-") == 0) {
+      printf("dvdcc:main() Cannot stream an ISO converted from a RAW image.\n");
+      printf("dvdcc:main() Exiting...\n");
+      return 1;
+    }
+    return convert::FromRaw(options.from_raw, options.iso, options.verbose) == 0 ? 0 : 1;
+  }
+
+  // rebuild an ISO from its manifest and a store without a drive
+  if (options.from_manifest) {
+    if (options.iso == NULL || options.dedup == NULL || strcmp(options.iso, "-") == 0) {
+      printf("dvdcc:main() Use --iso to choose the rebuilt ISO file and --dedup for the store.\n");
+      printf("dvdcc:main() Exiting...\n");
+      return 1;
+    }
+    return dedup::Restore(options.from_manifest, options.dedup, options.iso) == 0 ? 0 : 1;
+  }
+
+  // index a library of images without a drive
+  if (options.catalog)
+    return catalog::Run(options.catalog, options.catalog_index, options.verbose) == 0 ? 0 : 1;
+
+  // record the commands sent to the drives or replay them from a trace
+  if (options.trace && options.replay) {
+    printf("dvdcc:main() Cannot record a trace while replaying one.\n");
+    printf("dvdcc:main() Exiting...\n");
+    return 1;
+  }
+  if (options.replay && (options.devices.size() > 1 || options.daemon_dir)) {
+    printf("dvdcc:main() Traces are replayed for a single drive only.\n");
+    printf("dvdcc:main() Exiting...\n");
+    return 1;
+  }
+  if (options.trace && trace::Record(options.trace, options.trace_compact) != 0) return 1;
+  if (options.replay && trace::Replay(options.replay, options.replay_timing) != 0) return 1;
+
+  // export per drive counters for monitoring
+  if (options.metrics && metrics::Start(options.metrics) != 0) return 1;
+
+  // back up every disc inserted until interrupted
+  if (options.daemon_dir)
+    return batch::Run(options);
+
+  // back up one disc shared between several drives holding copies
+  if (options.devices.size() > 1 && options.shard)
+    return shard::Run(options);
+
+  // back up several drives at once
+  if (options.devices.size() > 1)
+    return backup::MultiDrive(options);
 
   // open the drive
   Dvd dvd(options.device_path, options.timeout, options.verbose);
@@ -114,48 +430,42 @@ int main(int argc, char **argv) {
   // make sure we wait for drive activity to stop before continuing,
   // otherwise background commands might overwrite the drive cache
   // as we try to read it
-  int retry = 0, good = 0;
-  while (true) {
-
-    bool ready = (dvd.PollReady(options.verbose) == 0);
-    bool active = (dvd.PollPowerState(options.verbose) == (int)constants::PowerStates::kActive);
-
-    good += (ready && !active);
-    retry++;
-
-    // only break after verifying the drive is ready 3 consecutive times
-    // to avoid triggering on the transition between unready and active states
-    if (good == 3) break;
-
-    if (retry != good) progress.Update();
-
-    if (retry == 1000) {
-      progress.Finish();
-      printf("\n\ndvdcc:main() Drive activity did not stop after 1000 seconds.");
-      printf("\ndvdcc:main() Exiting...\n");
-      exit(0);
-    }
-    sleep(1);
-
-  } // END while (dvd.PollPower...)
+  int retry = WaitForStandby(dvd, &progress, options.verbose);
+  if (retry < 0) {
+    progress.Finish();
+    printf("\n\ndvdcc:main() Drive activity did not stop after 1000 seconds.");
+    printf("\ndvdcc:main() Exiting...\n");
+    exit(0);
+  }
 
   // add back white space that was over-written by progress
-  if (retry > good) printf("\n\n");
+  if (retry > 0) printf("\n\n");
 
   // start spinning the disc and determine disc type
   dvd.Start(options.verbose);
   dvd.FindDiscType(options.verbose);
 
+  // set the requested read speed before any bulk reads
+  unsigned int max_speed = options.speed > 0 ? options.speed * constants::DVD_SPEED_1X : constants::MAX_SPEED;
+  SpeedController speed(&dvd, max_speed, options.adaptive_speed, options.verbose);
+  if (options.speed > 0 && dvd.SetSpeed(max_speed, options.verbose) != 0)
+    printf("dvdcc:main() Drive did not accept read speed %dx. Using drive default.\n\n", options.speed);
+
+  // standard DVDs backed up as ISO only are read with large READ(12)
+  // transfers and only need keys when a sector falls back to the raw path
+  bool fast_path = options.iso && !options.raw && !options.raw_sidecar && !options.verify && !options.repair && !options.nbd && !options.scan &&
+                   dvd.disc_type == "DVD";
+
   // find the keys needed to decode disc data
   retry = 0;
-  while (true) {
+  while (!fast_path) {
     // stop when we find all keys
     if (dvd.FindKeys(20, options.verbose) == 0)
       break;
 
     // try flushing cache to point beyond key finding and retrying
     dvd.ClearSectorCache(32, options.verbose);
-    sleep(1);
+    trace::Sleep(1);
 
     if (retry++ == 5) {
       printf("dvdcc:main() Reached maximum retry for FindKeys().\n");
@@ -163,109 +473,96 @@ int main(int argc, char **argv) {
       return 0;
     } // END if (retry)
 
-  } // END while (true)
+  } // END while (!fast_path)
 
   // display full disc info
   dvd.DisplayMetaData();
 
+  // compare the disc with an archived image instead of backing it up
+  if (options.verify)
+    return verify::Disc(dvd, options.verify, options.keep_going, options.verbose);
+
+  // patch the bad sectors of an existing backup instead of backing it up
+  if (options.repair)
+    return repair::Raw(dvd, options.repair, options.iso, options.verbose);
+
+  // scan the disc surface instead of backing it up
+  if (options.scan)
+    return scan::Disc(dvd, options.scan, options.scan_stride, options.verbose);
+
+  // serve the disc as a block device instead of backing it up
+  if (options.nbd)
+    return nbd::Serve(dvd, options.nbd, options.nbd_store, options.verbose);
+
   // break here if no backup is requested
   if (!options.iso && !options.raw)
     return 0;
 
+  // find the sectors holding data when only those are backed up
+  ExtentMap used;
+  if (options.selective) {
+    if (!dvd.disc_id.empty() && extents::FindUsed(dvd, &used, options.verbose) == 0) {
+      printf("Used data..........: %u of %u sectors (%.1f%%)\n\n", used.UsedSectors(), dvd.sector_number,
+             100.0 * used.UsedSectors() / dvd.sector_number);
+    } else {
+      printf("dvdcc:main() Cannot find used extents. Backing up all sectors.\n\n");
+      options.selective = 0;
+    }
+  } // END if (options.selective)
+
   printf("Backing up content...\n\n");
 
-  // open file for iso backup
-  FILE *fiso;
-  unsigned int iso_start_sector;
-  if (options.iso) {
-    printf(" ISO path: %s\n", options.iso);
-    fiso = OpenAndResume(options.iso, options.resume, &iso_start_sector, constants::SECTOR_SIZE);
-  } // END if (options.iso)
-
-  // open file for raw backup
-  FILE *fraw;
-  unsigned int raw_start_sector;
-  if (options.raw) {
-    printf(" RAW path: %s\n", options.raw);
-    fraw = OpenAndResume(options.raw, options.resume, &raw_start_sector, constants::RAW_SECTOR_SIZE);
-    // confirm start sectors match when using ISO+RAW
-    if (options.iso && raw_start_sector != iso_start_sector) {
-      printf("dvdcc:main() Cannot resume. RAW start sector %lu differs from ISO start sector %lu.\n",
-             raw_start_sector, iso_start_sector);
-      printf("dvdcc:main() Exiting...\n");
-      return 0;
-    }
-  } // END if (options.raw)
+  // workers shared by compressed outputs
+  ThreadPool *pool = options.compress ? new ThreadPool() : NULL;
+
+  // open the ISO, RAW and sidecar outputs
+  Outputs outputs;
+  if (outputs.Open(options, dvd, options.iso, options.raw, stream_fd, pool) != 0 ||
+      outputs.Limit(options.start_sector, options.end_sector) != 0) {
+    printf("dvdcc:main() Exiting...\n");
+    return 0;
+  }
   printf("\n");
 
-  // backup loop variables
-  const int buflen = constants::RAW_SECTOR_SIZE * constants::SECTORS_PER_CACHE;
-  unsigned char buffer[buflen];
-  unsigned char *raw_sector;
-  unsigned int i, raw_edc, edc_length = constants::RAW_SECTOR_SIZE - 4;
-  unsigned int start_sector = options.iso ? iso_start_sector : raw_start_sector, cache_start;
+  int status = 0;
+  unsigned int start_sector = outputs.start_sector, end_sector = outputs.end_sector;
 
   if (options.resume)
     printf("Resuming from sector %lu...\n\n", start_sector);
+  else if (start_sector > 0)
+    printf("Starting from sector %u...\n\n", start_sector);
+  if (end_sector < dvd.sector_number)
+    printf("Stopping before sector %u...\n\n", end_sector);
 
   // prepare progress tracker
   strcpy(progress.description, "Progress");
   progress.only_elapsed = false;
   progress.Start();
 
-  // loop through dvd sectors
-  for (unsigned int sector = start_sector; sector < dvd.sector_number; sector++) {
-
-    // perform cache read if this is the start of a cache block or a resume
-    if ((sector % constants::SECTORS_PER_CACHE == 0) || options.resume) {
-      cache_start = (sector / constants::SECTORS_PER_CACHE) * constants::SECTORS_PER_CACHE;
-      dvd.ReadRawSectorCache(cache_start, buffer, options.verbose);
-      options.resume = 0;
-    }
-
-    // get the cypher index for decoding this sector
-    i = dvd.CypherIndex(sector / constants::SECTORS_PER_BLOCK);
-
-    // point to the raw sector data
-    raw_sector = buffer + sector % constants::SECTORS_PER_CACHE * constants::RAW_SECTOR_SIZE;
-
-    // try decoding the raw sector data
-    for (retry = 0; retry < 20; retry++) {
-      
-      dvd.cyphers[i]->Decode64(raw_sector, 12);
-
-      raw_edc = dvd.RawSectorEdc(raw_sector);
-
-      if (raw_edc == ecma_267::calculate(raw_sector, edc_length)) {
-        if (options.iso) fwrite(raw_sector + 6, 1, constants::SECTOR_SIZE, fiso);
-        if (options.raw) fwrite(raw_sector, 1, constants::RAW_SECTOR_SIZE, fraw);
-        break;
-      }
-
-      printf("\r\x1b[KRetrying sector %lu (attempt %d)\n", sector, retry+1);
-
-      if (retry == 19) {
-        printf("dvdcc:main() Cannot read sector %lu\n", sector);
-        printf("dvdcc:main() Exiting...\n");
-        return 1;
-      }
-
-      // decode failed so retry after clearing cache
-      dvd.ClearSectorCache(cache_start, options.verbose);
-      sleep(1);
-      dvd.ReadRawSectorCache(cache_start, buffer, options.verbose);
-
-    } // END for (retry)
+  if (fast_path) {
+    status = FastIsoBackup(dvd, outputs.iso, start_sector, end_sector, speed, progress, options.verbose);
+    progress.Finish();
+    if (outputs.Close() != 0) status = 1;
+    delete pool;
+    return status;
+  }
 
-    progress.Update(sector - start_sector, dvd.sector_number - start_sector);
+  // the sector layout of the disc is selected once for the whole loop
+  status = layout::Select(dvd.dvd_rom, [&](auto disc) {
+    return RawBackup<decltype(disc)>(dvd, outputs, options.selective ? &used : NULL, speed, progress,
+                                     options.verbose);
+  });
+  if (status != 0) return 1;
 
-  } // END for (sector)
   progress.Finish();
 
-  // close files
-  if (options.iso) fclose(fiso);
-  if (options.raw) fclose(fraw);
+  // close outputs
+  if (outputs.Close() != 0) status = 1;
+  delete pool;
 
-  return 0;
+  if (status != 0)
+    printf("dvdcc:main() Failed closing backup output\n");
+
+  return status;
 
 }; // END main()
@@ -1,3 +1,9 @@
-g++ -o dvdcc main.cc -Iinclude
+# ./makeit.sh builds dvdcc, ./makeit.sh bench builds the dvdcc-bench microbenchmarks
+if [ "$1" = "bench" ]; then
+  g++ -O2 -o dvdcc-bench bench.cc -Iinclude -pthread -lz
+  exit
+fi
+
+g++ -o dvdcc main.cc -Iinclude -pthread -lz
 chown root:root dvdcc
 chmod u+s dvdcc